@@ -0,0 +1,257 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "auth/AES128.h"
+
+/*
+ * FIPS-197 AES-128, encryption only.  The portable version is the usual
+ * 32-bit table construction (one 1K table, rotated per row); the sbox
+ * is spelled out, the table is built from it at startup.
+ */
+static const unsigned char aes_sbox[256] = {
+  0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+  0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+  0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+  0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+  0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+  0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+  0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+  0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+  0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+  0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+  0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+  0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+  0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+  0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+  0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+  0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static const unsigned char aes_rcon[10] = {
+  0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36
+};
+
+static uint32_t aes_te0[256];
+static unsigned char aes_inv_sbox[256];
+
+static struct aes_tables_init {
+  aes_tables_init() {
+    for (int i = 0; i < 256; i++) {
+      uint32_t s = aes_sbox[i];
+      uint32_t s2 = ((s << 1) ^ (s & 0x80 ? 0x1b : 0)) & 0xff;
+      aes_te0[i] = (s2 << 24) | (s << 16) | (s << 8) | (s2 ^ s);
+      aes_inv_sbox[s] = i;
+    }
+  }
+} aes_tables_init_instance;
+
+static inline uint32_t ror8(uint32_t x) { return (x >> 8) | (x << 24); }
+static inline uint32_t ror16(uint32_t x) { return (x >> 16) | (x << 16); }
+static inline uint32_t ror24(uint32_t x) { return (x >> 24) | (x << 8); }
+
+static inline uint32_t get_be32(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+    ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void put_be32(unsigned char *p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static inline uint32_t sub_word(uint32_t w)
+{
+  return ((uint32_t)aes_sbox[w >> 24] << 24) |
+    ((uint32_t)aes_sbox[(w >> 16) & 0xff] << 16) |
+    ((uint32_t)aes_sbox[(w >> 8) & 0xff] << 8) |
+    aes_sbox[w & 0xff];
+}
+
+void AES128Key::set(const unsigned char *key)
+{
+  for (int i = 0; i < 4; i++)
+    ek[i] = get_be32(key + 4 * i);
+  for (int i = 4; i < 44; i++) {
+    uint32_t t = ek[i - 1];
+    if (i % 4 == 0)
+      t = sub_word((t << 8) | (t >> 24)) ^ ((uint32_t)aes_rcon[i / 4 - 1] << 24);
+    ek[i] = ek[i - 4] ^ t;
+  }
+  for (int i = 0; i < 44; i++)
+    put_be32(rk + 4 * i, ek[i]);
+}
+
+void ceph_aes128_portable(const AES128Key *k, const unsigned char *in,
+			  unsigned char *out)
+{
+  const uint32_t *ek = k->ek;
+  uint32_t s0 = get_be32(in) ^ ek[0];
+  uint32_t s1 = get_be32(in + 4) ^ ek[1];
+  uint32_t s2 = get_be32(in + 8) ^ ek[2];
+  uint32_t s3 = get_be32(in + 12) ^ ek[3];
+
+  for (int r = 1; r < 10; r++) {
+    ek += 4;
+    uint32_t t0 = aes_te0[s0 >> 24] ^ ror8(aes_te0[(s1 >> 16) & 0xff]) ^
+      ror16(aes_te0[(s2 >> 8) & 0xff]) ^ ror24(aes_te0[s3 & 0xff]) ^ ek[0];
+    uint32_t t1 = aes_te0[s1 >> 24] ^ ror8(aes_te0[(s2 >> 16) & 0xff]) ^
+      ror16(aes_te0[(s3 >> 8) & 0xff]) ^ ror24(aes_te0[s0 & 0xff]) ^ ek[1];
+    uint32_t t2 = aes_te0[s2 >> 24] ^ ror8(aes_te0[(s3 >> 16) & 0xff]) ^
+      ror16(aes_te0[(s0 >> 8) & 0xff]) ^ ror24(aes_te0[s1 & 0xff]) ^ ek[2];
+    uint32_t t3 = aes_te0[s3 >> 24] ^ ror8(aes_te0[(s0 >> 16) & 0xff]) ^
+      ror16(aes_te0[(s1 >> 8) & 0xff]) ^ ror24(aes_te0[s2 & 0xff]) ^ ek[3];
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+
+  // last round: no MixColumns
+  ek += 4;
+#define AES_FINAL(a, b, c, d)						\
+  (((uint32_t)aes_sbox[(a) >> 24] << 24) |				\
+   ((uint32_t)aes_sbox[((b) >> 16) & 0xff] << 16) |			\
+   ((uint32_t)aes_sbox[((c) >> 8) & 0xff] << 8) |			\
+   aes_sbox[(d) & 0xff])
+  put_be32(out, AES_FINAL(s0, s1, s2, s3) ^ ek[0]);
+  put_be32(out + 4, AES_FINAL(s1, s2, s3, s0) ^ ek[1]);
+  put_be32(out + 8, AES_FINAL(s2, s3, s0, s1) ^ ek[2]);
+  put_be32(out + 12, AES_FINAL(s3, s0, s1, s2) ^ ek[3]);
+#undef AES_FINAL
+}
+
+/*
+ * The inverse cipher is only used to decrypt tickets and the like, so it
+ * is the plain byte-at-a-time version of FIPS-197 5.3.
+ */
+static inline unsigned char xtime(unsigned char x)
+{
+  return (x << 1) ^ (x & 0x80 ? 0x1b : 0);
+}
+
+static inline unsigned char gmul(unsigned char x, unsigned char y)
+{
+  unsigned char r = 0;
+  for (; y; y >>= 1, x = xtime(x))
+    if (y & 1)
+      r ^= x;
+  return r;
+}
+
+void AES128Key::decrypt_block(const unsigned char *in, unsigned char *out) const
+{
+  unsigned char s[16], t[16];
+  for (int i = 0; i < 16; i++)
+    s[i] = in[i] ^ rk[160 + i];
+
+  for (int r = 9; r >= 0; r--) {
+    // InvShiftRows and InvSubBytes; byte i is row i%4 of column i/4
+    for (int i = 0; i < 16; i++) {
+      int row = i % 4, col = i / 4;
+      t[i] = aes_inv_sbox[s[row + 4 * ((col + 4 - row) % 4)]];
+    }
+    for (int i = 0; i < 16; i++)
+      s[i] = t[i] ^ rk[16 * r + i];
+    if (!r)
+      break;
+    // InvMixColumns
+    for (int c = 0; c < 16; c += 4) {
+      unsigned char a0 = s[c], a1 = s[c + 1], a2 = s[c + 2], a3 = s[c + 3];
+      s[c] = gmul(a0, 14) ^ gmul(a1, 11) ^ gmul(a2, 13) ^ gmul(a3, 9);
+      s[c + 1] = gmul(a0, 9) ^ gmul(a1, 14) ^ gmul(a2, 11) ^ gmul(a3, 13);
+      s[c + 2] = gmul(a0, 13) ^ gmul(a1, 9) ^ gmul(a2, 14) ^ gmul(a3, 11);
+      s[c + 3] = gmul(a0, 11) ^ gmul(a1, 13) ^ gmul(a2, 9) ^ gmul(a3, 14);
+    }
+  }
+  for (int i = 0; i < 16; i++)
+    out[i] = s[i];
+}
+
+void ceph_aes128_cbc_encrypt(const AES128Key *k, const unsigned char *iv,
+			     unsigned char *buf, unsigned len)
+{
+  const unsigned char *chain = iv;
+  for (unsigned off = 0; off < len; off += 16) {
+    for (int i = 0; i < 16; i++)
+      buf[off + i] ^= chain[i];
+    k->encrypt_block(buf + off, buf + off);
+    chain = buf + off;
+  }
+}
+
+void ceph_aes128_cbc_decrypt(const AES128Key *k, const unsigned char *iv,
+			     unsigned char *buf, unsigned len)
+{
+  unsigned char chain[16], next[16];
+  for (int i = 0; i < 16; i++)
+    chain[i] = iv[i];
+  for (unsigned off = 0; off < len; off += 16) {
+    for (int i = 0; i < 16; i++)
+      next[i] = buf[off + i];
+    k->decrypt_block(buf + off, buf + off);
+    for (int i = 0; i < 16; i++) {
+      buf[off + i] ^= chain[i];
+      chain[i] = next[i];
+    }
+  }
+}
+
+/*
+ * x86_64 only, like the crc32c kernels; the round keys are loaded
+ * unaligned since AES128Key may live anywhere.
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
+
+#include <cpuid.h>
+#include <wmmintrin.h>
+
+#define TARGET_AES __attribute__((target("sse2,aes")))
+
+TARGET_AES
+void ceph_aes128_intel(const AES128Key *k, const unsigned char *in,
+		       unsigned char *out)
+{
+  const __m128i *rk = (const __m128i *)k->rk;
+  __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in),
+			    _mm_loadu_si128(rk));
+  for (int r = 1; r < 10; r++)
+    b = _mm_aesenc_si128(b, _mm_loadu_si128(rk + r));
+  b = _mm_aesenclast_si128(b, _mm_loadu_si128(rk + 10));
+  _mm_storeu_si128((__m128i *)out, b);
+}
+
+int ceph_have_aes_intel(void)
+{
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return 0;
+  return (ecx & bit_AES) != 0;
+}
+
+#else /* __x86_64__ */
+
+void ceph_aes128_intel(const AES128Key *k, const unsigned char *in,
+		       unsigned char *out)
+{
+  ceph_aes128_portable(k, in, out);  /* this shouldn't get called! */
+}
+
+int ceph_have_aes_intel(void)
+{
+  return 0;
+}
+
+#endif
+
+static ceph_aes128_func_t ceph_choose_aes128(void)
+{
+  if (ceph_have_aes_intel())
+    return ceph_aes128_intel;
+  return ceph_aes128_portable;
+}
+
+ceph_aes128_func_t ceph_aes128_func = ceph_choose_aes128();
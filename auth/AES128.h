@@ -0,0 +1,63 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_AUTH_AES128_H
+#define CEPH_AUTH_AES128_H
+
+#include "include/int_types.h"
+
+/*
+ * Single-block AES-128 encryption with a key schedule that is expanded
+ * once and kept by the caller.  This is all cephx message signing needs
+ * (see CephxSessionHandler), and it is cheap enough to do per message
+ * without touching a bufferlist.  CryptoAES uses the CBC helpers below
+ * for tickets and the rest of encode_encrypt.
+ */
+struct AES128Key {
+  unsigned char rk[176];	// 11 round keys, in the byte order AES-NI wants
+  uint32_t ek[44];		// the same round keys as big-endian words
+
+  AES128Key() {}
+  explicit AES128Key(const unsigned char *key) { set(key); }
+
+  void set(const unsigned char *key);
+  inline void encrypt_block(const unsigned char *in, unsigned char *out) const;
+  void decrypt_block(const unsigned char *in, unsigned char *out) const;
+};
+
+typedef void (*ceph_aes128_func_t)(const AES128Key *k, const unsigned char *in,
+				    unsigned char *out);
+
+/* table-driven, works everywhere */
+extern void ceph_aes128_portable(const AES128Key *k, const unsigned char *in,
+				 unsigned char *out);
+
+/* aes-ni; only call it if ceph_have_aes_intel() */
+extern void ceph_aes128_intel(const AES128Key *k, const unsigned char *in,
+			      unsigned char *out);
+extern int ceph_have_aes_intel(void);
+
+/* the best of the above for this cpu, chosen at startup */
+extern ceph_aes128_func_t ceph_aes128_func;
+
+/* AES-128-CBC in place; len must be a multiple of the 16 byte block */
+extern void ceph_aes128_cbc_encrypt(const AES128Key *k, const unsigned char *iv,
+				    unsigned char *buf, unsigned len);
+extern void ceph_aes128_cbc_decrypt(const AES128Key *k, const unsigned char *iv,
+				    unsigned char *buf, unsigned len);
+
+void AES128Key::encrypt_block(const unsigned char *in, unsigned char *out) const
+{
+  ceph_aes128_func(this, in, out);
+}
+
+#endif
@@ -13,6 +13,7 @@
 
 #include <sstream>
 #include "Crypto.h"
+#include "AES128.h"
 /*by ketor 
 #ifdef USE_CRYPTOPP
 # include <cryptopp/modes.h>
@@ -217,97 +218,84 @@ static void nss_aes_operation(CK_ATTRIBUTE_TYPE op, const bufferptr& secret,
 # error "No supported crypto implementation found."
 #endif*/
 
+/*
+ * the crypto++ and nss backends are not built for windows; CryptoAES
+ * is AES-128-CBC with pkcs7 padding over auth/AES128, which gives the
+ * same bytes on the wire.
+ */
+#define AES_KEY_LEN	16
+
 int CryptoAES::create(bufferptr& secret)
 {
-//by ketor   bufferlist bl;
-//  int r = get_random_bytes(AES_KEY_LEN, bl);
-//  if (r < 0)
-//    return r;
-//  secret = buffer::ptr(bl.c_str(), bl.length());
+  bufferlist bl;
+  int r = get_random_bytes(AES_KEY_LEN, bl);
+  if (r < 0)
+    return r;
+  secret = buffer::ptr(bl.c_str(), bl.length());
   return 0;
 }
 
 int CryptoAES::validate_secret(bufferptr& secret)
 {
-//by ketor   if (secret.length() < (size_t)AES_KEY_LEN) {
-//    return -EINVAL;
-//  }
-//
+  if (secret.length() < (size_t)AES_KEY_LEN) {
+    return -EINVAL;
+  }
+
   return 0;
 }
 
 void CryptoAES::encrypt(const bufferptr& secret, const bufferlist& in, bufferlist& out,
 			std::string &error) const
 {
-//by ketor   if (secret.length() < AES_KEY_LEN) {
-//    error = "key is too short";
-//    return;
-//  }
-//#ifdef USE_CRYPTOPP
-//  {
-//    const unsigned char *key = (const unsigned char *)secret.c_str();
-//
-//    string ciphertext;
-//    CryptoPP::AES::Encryption aesEncryption(key, CryptoPP::AES::DEFAULT_KEYLENGTH);
-//    CryptoPP::CBC_Mode_ExternalCipher::Encryption cbcEncryption( aesEncryption, (const byte*)CEPH_AES_IV );
-//    CryptoPP::StringSink *sink = new CryptoPP::StringSink(ciphertext);
-//    CryptoPP::StreamTransformationFilter stfEncryptor(cbcEncryption, sink);
-//
-//    for (std::list<bufferptr>::const_iterator it = in.buffers().begin();
-//	 it != in.buffers().end(); ++it) {
-//      const unsigned char *in_buf = (const unsigned char *)it->c_str();
-//      stfEncryptor.Put(in_buf, it->length());
-//    }
-//    try {
-//      stfEncryptor.MessageEnd();
-//    } catch (CryptoPP::Exception& e) {
-//      ostringstream oss;
-//      oss << "encryptor.MessageEnd::Exception: " << e.GetWhat();
-//      error = oss.str();
-//      return;
-//    }
-//    out.append((const char *)ciphertext.c_str(), ciphertext.length());
-//  }
-//#elif USE_NSS
-//  nss_aes_operation(CKA_ENCRYPT, secret, in, out, error);
-//#else
-//# error "No supported crypto implementation found."
-//#endif
+  if (secret.length() < AES_KEY_LEN) {
+    error = "key is too short";
+    return;
+  }
+  AES128Key k((const unsigned char *)secret.c_str());
+
+  // pkcs7: always pad, by a whole block if we are already aligned
+  unsigned len = in.length();
+  unsigned pad = 16 - len % 16;
+  bufferptr buf(len + pad);
+  in.copy(0, len, buf.c_str());
+  memset(buf.c_str() + len, pad, pad);
+
+  ceph_aes128_cbc_encrypt(&k, (const unsigned char *)CEPH_AES_IV,
+			  (unsigned char *)buf.c_str(), buf.length());
+  out.append(buf);
 }
 
 void CryptoAES::decrypt(const bufferptr& secret, const bufferlist& in, 
 			bufferlist& out, std::string &error) const
 {
-//by ketor #ifdef USE_CRYPTOPP
-//  const unsigned char *key = (const unsigned char *)secret.c_str();
-//
-//  CryptoPP::AES::Decryption aesDecryption(key, CryptoPP::AES::DEFAULT_KEYLENGTH);
-//  CryptoPP::CBC_Mode_ExternalCipher::Decryption cbcDecryption( aesDecryption, (const byte*)CEPH_AES_IV );
-//
-//  string decryptedtext;
-//  CryptoPP::StringSink *sink = new CryptoPP::StringSink(decryptedtext);
-//  CryptoPP::StreamTransformationFilter stfDecryptor(cbcDecryption, sink);
-//  for (std::list<bufferptr>::const_iterator it = in.buffers().begin(); 
-//       it != in.buffers().end(); ++it) {
-//      const unsigned char *in_buf = (const unsigned char *)it->c_str();
-//      stfDecryptor.Put(in_buf, it->length());
-//  }
-//
-//  try {
-//    stfDecryptor.MessageEnd();
-//  } catch (CryptoPP::Exception& e) {
-//    ostringstream oss;
-//    oss << "decryptor.MessageEnd::Exception: " << e.GetWhat();
-//    error = oss.str();
-//    return;
-//  }
-//
-//  out.append((const char *)decryptedtext.c_str(), decryptedtext.length());
-//#elif USE_NSS
-//  nss_aes_operation(CKA_DECRYPT, secret, in, out, error);
-//#else
-//# error "No supported crypto implementation found."
-//#endif
+  if (secret.length() < AES_KEY_LEN) {
+    error = "key is too short";
+    return;
+  }
+  unsigned len = in.length();
+  if (len == 0 || len % 16) {
+    ostringstream oss;
+    oss << "decrypt: input length " << len << " is not a whole number of blocks";
+    error = oss.str();
+    return;
+  }
+  AES128Key k((const unsigned char *)secret.c_str());
+
+  bufferptr buf(len);
+  in.copy(0, len, buf.c_str());
+  unsigned char *p = (unsigned char *)buf.c_str();
+  ceph_aes128_cbc_decrypt(&k, (const unsigned char *)CEPH_AES_IV, p, len);
+
+  unsigned pad = p[len - 1];
+  bool pad_ok = pad >= 1 && pad <= 16;
+  for (unsigned i = 1; pad_ok && i <= pad; i++)
+    pad_ok = p[len - i] == pad;
+  if (!pad_ok) {
+    error = "decrypt: bad padding";
+    return;
+  }
+  buf.set_length(len - pad);
+  out.append(buf);
 }
 
 
@@ -24,37 +24,89 @@
 
 #define dout_subsys ceph_subsys_auth
 
-int CephxSessionHandler::sign_message(Message *m)
+/*
+ * The signature is the first 8 bytes of encode_encrypt() of the four
+ * crcs, i.e. of the AES-CBC encryption of
+ *
+ *   u8 struct_v, u64 AUTH_ENC_MAGIC, u32 16, header.crc, front_crc, ...
+ *
+ * and the first CBC block only covers everything up to the low 3 bytes
+ * of header.crc.  So one block encryption with the cached key schedule
+ * gives the same signature, without building or encrypting bufferlists.
+ */
+uint64_t CephxSessionHandler::calc_signature(const AES128Key& k, uint32_t header_crc)
 {
-  // If runtime signing option is off, just return success without signing.
-  if (!cct->_conf->cephx_sign_messages) {
+  unsigned char block[16], out[16];
+  const uint64_t magic = AUTH_ENC_MAGIC;
+
+  block[0] = 1;  // struct_v
+  for (int i = 0; i < 8; i++)
+    block[1 + i] = magic >> (8 * i);
+  block[9] = 16;  // bufferlist length
+  block[10] = block[11] = block[12] = 0;
+  block[13] = header_crc;
+  block[14] = header_crc >> 8;
+  block[15] = header_crc >> 16;
+  for (int i = 0; i < 16; i++)
+    block[i] ^= CEPH_AES_IV[i];
+
+  k.encrypt_block(block, out);
+
+  uint64_t sig = 0;
+  for (int i = 7; i >= 0; i--)
+    sig = (sig << 8) | out[i];
+  return sig;
+}
+
+int CephxSessionHandler::_calc_signature(Message *m, uint64_t *psig)
+{
+  ceph_msg_header& header = m->get_header();
+  ceph_msg_footer& footer = m->get_footer();
+
+  if (sign_fast) {
+    *psig = calc_signature(sign_key, header.crc);
     return 0;
   }
+
   bufferlist bl_plaintext, bl_encrypted;
-  ceph_msg_header header = m->get_header();
   std::string error;
 
-  ceph_msg_footer& en_footer = m->get_footer();
-
   ::encode(header.crc, bl_plaintext);
-  ::encode(en_footer.front_crc, bl_plaintext);
-  ::encode(en_footer.middle_crc, bl_plaintext);
-  ::encode(en_footer.data_crc, bl_plaintext);
-
-  ldout(cct, 10) <<  "sign_message: seq # " << header.seq << " CRCs are: header " << header.crc
-		 << " front " << en_footer.front_crc << " middle " << en_footer.middle_crc
-		 << " data " << en_footer.data_crc << dendl;
+  ::encode(footer.front_crc, bl_plaintext);
+  ::encode(footer.middle_crc, bl_plaintext);
+  ::encode(footer.data_crc, bl_plaintext);
 
   if (encode_encrypt(cct, bl_plaintext, key, bl_encrypted, error)) {
     ldout(cct, 0) << "error encrypting message signature: " << error << dendl;
-    ldout(cct, 0) << "no signature put on message" << dendl;
     return SESSION_SIGNATURE_FAILURE;
-  } 
+  }
 
   bufferlist::iterator ci = bl_encrypted.begin();
   // Skip the magic number up front. PLR
   ci.advance(4);
-  ::decode(en_footer.sig, ci);
+  ::decode(*psig, ci);
+  return 0;
+}
+
+int CephxSessionHandler::sign_message(Message *m)
+{
+  // If runtime signing option is off, just return success without signing.
+  if (!cct->_conf->cephx_sign_messages) {
+    return 0;
+  }
+  ceph_msg_header& header = m->get_header();
+  ceph_msg_footer& en_footer = m->get_footer();
+
+  ldout(cct, 10) <<  "sign_message: seq # " << header.seq << " CRCs are: header " << header.crc
+		 << " front " << en_footer.front_crc << " middle " << en_footer.middle_crc
+		 << " data " << en_footer.data_crc << dendl;
+
+  uint64_t sig;
+  if (_calc_signature(m, &sig) < 0) {
+    ldout(cct, 0) << "no signature put on message" << dendl;
+    return SESSION_SIGNATURE_FAILURE;
+  }
+  en_footer.sig = sig;
 
   // There's potentially an issue with whether the encoding and decoding done here will work
   // properly when a big endian and little endian machine are talking.  We think it's OK,
@@ -75,8 +127,6 @@ int CephxSessionHandler::check_message_signature(Message *m)
     return 0;
   }
 
-  bufferlist bl_plaintext, bl_ciphertext;
-  std::string sig_error;
   ceph_msg_header& header = m->get_header();
   ceph_msg_footer& footer = m->get_footer();
 
@@ -89,22 +139,9 @@ int CephxSessionHandler::check_message_signature(Message *m)
 
   ldout(cct, 10) << "check_message_signature: seq # = " << m->get_seq() << " front_crc_ = " << footer.front_crc
 		 << " middle_crc = " << footer.middle_crc << " data_crc = " << footer.data_crc << dendl;
-  ::encode(header.crc, bl_plaintext);
-  ::encode(footer.front_crc, bl_plaintext);
-  ::encode(footer.middle_crc, bl_plaintext);
-  ::encode(footer.data_crc, bl_plaintext);
-
-  // Encrypt the buffer containing the checksums to calculate the signature. PLR
-  if (encode_encrypt(cct, bl_plaintext, key, bl_ciphertext, sig_error)) {
-    ldout(cct, 0) << "error in encryption for checking message signature: " << sig_error << dendl;
-    return (SESSION_SIGNATURE_FAILURE);
-  } 
-
-  bufferlist::iterator ci = bl_ciphertext.begin();
-  // Skip the magic number at the front. PLR
-  ci.advance(4);
   uint64_t sig_check;
-  ::decode(sig_check, ci);
+  if (_calc_signature(m, &sig_check) < 0)
+    return (SESSION_SIGNATURE_FAILURE);
 
   // There's potentially an issue with whether the encoding and decoding done here will work
   // properly when a big endian and little endian machine are talking.  We think it's OK,
@@ -15,17 +15,31 @@
 
 #include "../AuthSessionHandler.h"
 #include "../Auth.h"
+#include "../AES128.h"
 
 class CephContext;
 
 class CephxSessionHandler  : public AuthSessionHandler {
   uint64_t features;
 
+  // the session key, expanded once; only used if sign_fast
+  bool sign_fast;
+  AES128Key sign_key;
+
+  int _calc_signature(Message *m, uint64_t *psig);
+
 public:
   CephxSessionHandler(CephContext *cct_, CryptoKey session_key, uint64_t features)
     : AuthSessionHandler(cct_, CEPH_AUTH_CEPHX, session_key),
-      features(features) {}
+      features(features), sign_fast(false) {
+    if (key.get_type() == CEPH_CRYPTO_AES && key.get_secret().length() >= 16) {
+      sign_key.set((const unsigned char *)key.get_secret().c_str());
+      sign_fast = true;
+    }
+  }
   ~CephxSessionHandler() {}
+
+  static uint64_t calc_signature(const AES128Key& k, uint32_t header_crc);
   
   bool no_security() {
     return false;
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "include/atomic.h"
+#include "include/buffer.h"
+#include "include/encoding.h"
+
+/*
+ * bufferlist micro-benchmarks.  nearly every bufferlist operation copies
+ * or drops a bufferptr, so these mostly measure the cost of
+ * buffer::raw::nref (ceph::atomic_t).
+ *
+ *   bufferlist-bench.exe [iterations]
+ */
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void report(const char *name, double start, unsigned ops)
+{
+  double elapsed = now() - start;
+  printf("%-28s %10u ops %10.1f ns/op\n", name, ops,
+	 ops ? elapsed * 1000000000.0 / ops : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned iters = argc > 1 ? atoi(argv[1]) : 1000000;
+  double start;
+
+  // the counters themselves
+  {
+    ceph::atomic_t a;
+    start = now();
+    for (unsigned i = 0; i < iters; i++) {
+      a.inc();
+      a.dec();
+    }
+    report("atomic_t inc+dec", start, iters);
+
+    ceph::atomic_spinlock_t<unsigned> s;
+    start = now();
+    for (unsigned i = 0; i < iters; i++) {
+      s.inc();
+      s.dec();
+    }
+    report("atomic_spinlock_t inc+dec", start, iters);
+  }
+
+  // bufferptr copy: one nref inc and one dec
+  {
+    bufferptr bp(4096);
+    start = now();
+    for (unsigned i = 0; i < iters; i++) {
+      bufferptr copy(bp);
+    }
+    report("bufferptr copy", start, iters);
+  }
+
+  // small appends, as message encoding does
+  {
+    char chunk[64];
+    memset(chunk, 0x5a, sizeof(chunk));
+    unsigned rounds = iters / 64;
+    start = now();
+    for (unsigned r = 0; r < rounds; r++) {
+      bufferlist bl;
+      for (unsigned i = 0; i < 64; i++)
+	bl.append(chunk, sizeof(chunk));
+    }
+    report("append 64B", start, rounds * 64);
+  }
+
+  // encode a handful of fields per "message"
+  {
+    std::string name("client.admin");
+    unsigned rounds = iters / 8;
+    start = now();
+    for (unsigned r = 0; r < rounds; r++) {
+      bufferlist bl;
+      for (unsigned i = 0; i < 8; i++) {
+	::encode((uint64_t)r, bl);
+	::encode((uint32_t)i, bl);
+	::encode(name, bl);
+      }
+    }
+    report("encode u64+u32+string", start, rounds * 8);
+  }
+
+  // claim_append of a multi-segment list
+  {
+    bufferlist src;
+    for (unsigned i = 0; i < 16; i++)
+      src.append(bufferptr(4096));
+    start = now();
+    for (unsigned i = 0; i < iters; i++) {
+      bufferlist a(src);
+      bufferlist b;
+      b.claim_append(a);
+    }
+    report("copy+claim_append 16 segs", start, iters);
+  }
+
+  // substr_of across segment boundaries
+  {
+    bufferlist src;
+    for (unsigned i = 0; i < 16; i++)
+      src.append(bufferptr(4096));
+    srand(0);
+    start = now();
+    for (unsigned i = 0; i < iters; i++) {
+      unsigned off = rand() % (src.length() - 8192);
+      bufferlist sub;
+      sub.substr_of(src, off, 8192);
+    }
+    report("substr_of 8K", start, iters);
+  }
+
+  return 0;
+}
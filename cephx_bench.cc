@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "include/buffer.h"
+#include "include/encoding.h"
+#include "common/ceph_argparse.h"
+#include "common/ceph_context.h"
+#include "common/common_init.h"
+#include "auth/AES128.h"
+#include "auth/Crypto.h"
+#include "auth/cephx/CephxProtocol.h"
+#include "auth/cephx/CephxSessionHandler.h"
+
+/*
+ * cephx message signing micro-benchmark: the per-message cost of the
+ * encode_encrypt path against one block encryption with a cached key
+ * schedule, on each AES kernel.  test-internals.exe checks that they
+ * give the same signature.
+ *
+ *   cephx-bench.exe [iterations]
+ */
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned iters = argc > 1 ? atoi(argv[1]) : 1000000;
+  int have_aes = ceph_have_aes_intel();
+  CephInitParameters iparams(CEPH_ENTITY_TYPE_CLIENT);
+  CephContext *cct = common_preinit(iparams, CODE_ENVIRONMENT_UTILITY, 0);
+
+  printf("aes-ni %s, selected %s\n", have_aes ? "yes" : "no",
+	 ceph_aes128_func == ceph_aes128_intel ? "intel" : "portable");
+
+  bufferptr secret(16);
+  for (int j = 0; j < 16; j++)
+    secret.c_str()[j] = rand();
+  CryptoKey key(CEPH_CRYPTO_AES, utime_t(), secret);
+  AES128Key k((const unsigned char *)secret.c_str());
+  double start;
+
+  printf("%-28s %10s\n", "signing", "ns/msg");
+
+  start = now();
+  for (unsigned i = 0; i < iters / 10; i++) {
+    bufferlist bl_plaintext, bl_encrypted;
+    std::string error;
+    for (int j = 0; j < 4; j++)
+      ::encode((uint32_t)i, bl_plaintext);
+    encode_encrypt(cct, bl_plaintext, key, bl_encrypted, error);
+  }
+  printf("%-28s %10.1f\n", "encode_encrypt", (now() - start) * 1000000000.0 / (iters / 10));
+
+  start = now();
+  for (unsigned i = 0; i < iters; i++)
+    k.set((const unsigned char *)secret.c_str());
+  printf("%-28s %10.1f\n", "key expansion alone", (now() - start) * 1000000000.0 / iters);
+
+  ceph_aes128_func_t saved = ceph_aes128_func;
+  ceph_aes128_func = ceph_aes128_portable;
+  start = now();
+  for (unsigned i = 0; i < iters; i++)
+    CephxSessionHandler::calc_signature(k, i);
+  printf("%-28s %10.1f\n", "cached key, portable", (now() - start) * 1000000000.0 / iters);
+
+  if (have_aes) {
+    ceph_aes128_func = ceph_aes128_intel;
+    start = now();
+    for (unsigned i = 0; i < iters; i++)
+      CephxSessionHandler::calc_signature(k, i);
+    printf("%-28s %10.1f\n", "cached key, aes-ni", (now() - start) * 1000000000.0 / iters);
+  }
+  ceph_aes128_func = saved;
+
+  cct->put();
+  return 0;
+}
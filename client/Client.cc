@@ -75,6 +75,7 @@ using namespace std;
 #define dout_subsys ceph_subsys_client
 
 #include "include/lru.h"
+#include "include/ceph_hash.h"
 
 #include "include/compat.h"
 
@@ -200,7 +201,8 @@ bool Client::CommandHook::call(std::string command, cmdmap_t& cmdmap,
 dir_result_t::dir_result_t(Inode *in)
   : inode(in), offset(0), this_offset(2), next_offset(2),
     release_count(0), ordered_count(0), start_shared_gen(0),
-    buffer(0) {
+    buffer(0), prefetch_offset(0), prefetch_req(0), prefetch_result(0),
+    prefetch_pending(false) {
   inode->get();
 }
 
@@ -224,6 +226,8 @@ Client::Client(Messenger *m, MonClient *mc)
     interrupt_finisher(m->cct),
     remount_finisher(m->cct),
     objecter_finisher(m->cct),
+    readdir_prefetcher(m->cct),
+    aio_finisher(m->cct),
     tick_event(NULL),
     monclient(mc), messenger(m), whoami(m->get_myname().num()),
     cap_epoch_barrier(0),
@@ -231,6 +235,7 @@ Client::Client(Messenger *m, MonClient *mc)
     mounted(false), unmounting(false),
     local_osd(-1), local_osd_epoch(0),
     unsafe_sync_write(0),
+    aio_inflight(0),
     client_lock("Client::client_lock")
 {
   monclient->set_messenger(m);
@@ -250,6 +255,11 @@ Client::Client(Messenger *m, MonClient *mc)
 
   lru.lru_set_max(cct->_conf->client_cache_size);
   lru.lru_set_midpoint(cct->_conf->client_cache_mid);
+  if (cct->_conf->client_cache_policy == "2q")
+    lru.lru_set_policy(LRU_POLICY_2Q);
+  else if (cct->_conf->client_cache_policy != "lru")
+    lderr(cct) << "unknown client_cache_policy '" << cct->_conf->client_cache_policy
+	       << "', using lru" << dendl;
 
   // file handles
   free_fd_set.insert(10, 1<<30);
@@ -275,6 +285,8 @@ Client::Client(Messenger *m, MonClient *mc)
 				  true);
   objecter_finisher.start();
   filer = new Filer(objecter, &objecter_finisher);
+  readdir_prefetcher.start();
+  aio_finisher.start();
 }
 
 
@@ -344,7 +356,8 @@ inodeno_t Client::get_root_ino()
 
 Inode *Client::get_root()
 {
-  root->ll_get();
+  Mutex::Locker lock(client_lock);
+  _ll_get(root);
   return root;
 }
 
@@ -436,6 +449,7 @@ void Client::dump_status(Formatter *f)
 
     f->dump_int("dentry_count", lru.lru_get_size());
     f->dump_int("dentry_pinned_count", lru.lru_get_num_pinned());
+    f->dump_int("dentry_ghost_count", lru.lru_get_ghosts());
     f->dump_int("inode_count", inode_map.size());
     f->dump_int("mds_epoch", mdsmap->get_epoch());
     f->dump_int("osd_epoch", osd_epoch);
@@ -481,6 +495,15 @@ int Client::init()
   plb.add_time_avg(l_c_wrlat, "wrlat");
   plb.add_time_avg(l_c_owrlat, "owrlat");
   plb.add_time_avg(l_c_ordlat, "ordlat");
+  plb.add_u64_counter(l_c_ra_hit, "readahead_hit");
+  plb.add_u64_counter(l_c_ra_miss, "readahead_miss");
+  plb.add_u64_counter(l_c_ra_bytes, "readahead_bytes");
+  plb.add_u64_counter(l_c_ra_waste, "readahead_waste");
+  plb.add_u64_counter(l_c_sync_writes, "sync_writes");
+  plb.add_u64_counter(l_c_sync_write_ops, "sync_write_ops");
+  plb.add_u64_counter(l_c_dn_hit, "dentry_hit");
+  plb.add_u64_counter(l_c_dn_miss, "dentry_miss");
+  plb.add_u64_counter(l_c_dn_ghost_hit, "dentry_ghost_hit");
   logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 
@@ -571,6 +594,12 @@ void Client::shutdown()
     remount_finisher.stop();
   }
 
+  readdir_prefetcher.wait_for_empty();
+  readdir_prefetcher.stop();
+
+  aio_finisher.wait_for_empty();
+  aio_finisher.stop();
+
   objectcacher->stop();  // outside of client_lock! this does a join.
 
   client_lock.Lock();
@@ -638,9 +667,12 @@ void Client::trim_cache_for_reconnect(MetaSession *s)
   int trimmed = 0;
   list<Dentry*> skipped;
   while (lru.lru_get_size() > 0) {
-    Dentry *dn = static_cast<Dentry*>(lru.lru_expire());
+    // not lru_expire(): the skipped ones go back in, and must not come
+    // back as ghost hits
+    Dentry *dn = static_cast<Dentry*>(lru.lru_get_next_expire());
     if (!dn)
       break;
+    lru.lru_remove(dn);
 
     if ((dn->inode && dn->inode->caps.count(mds)) ||
 	dn->dir->parent_inode->caps.count(mds)) {
@@ -2600,7 +2632,10 @@ Dentry* Client::link(Dir *dir, const string& name, Inode *in, Dentry *dn)
     dn->dir = dir;
     dir->dentries[dn->name] = dn;
     dir->dentry_list.push_back(&dn->item_dentry_list);
-    lru.lru_insert_mid(dn);    // mid or top?
+    dn->lru_set_key(dir->parent_inode->ino.val * 0x9e3779b97f4a7c15ull +
+		    ceph_str_hash_rjenkins(name.c_str(), name.length()));
+    if (lru.lru_insert_mid(dn))    // mid or top?
+      logger->inc(l_c_dn_ghost_hit);
 
     ldout(cct, 15) << "link dir " << dir->parent_inode << " '" << name << "' to inode " << in
 		   << " dn " << dn << " (new dn)" << dendl;
@@ -2740,9 +2775,10 @@ void Client::put_cap_ref(Inode *in, int cap)
   }
 }
 
-int Client::get_caps(Inode *in, int need, int want, int *phave, loff_t endoff)
+int Client::get_caps(Inode *in, int need, int want, int *phave, loff_t endoff,
+		     bool nonblock)
 {
-  int r = check_pool_perm(in, need);
+  int r = check_pool_perm(in, need, nonblock);
   if (r < 0)
     return r;
 
@@ -2785,6 +2821,9 @@ int Client::get_caps(Inode *in, int need, int want, int *phave, loff_t endoff)
     if ((need & CEPH_CAP_FILE_WR) && in->auth_cap &&
 	in->auth_cap->session->readonly)
       return -EROFS;
+
+    if (nonblock)
+      return -EAGAIN;
     
     wait_on_list(in->waitfor_caps);
   }
@@ -4776,6 +4815,11 @@ void Client::unmount()
     mount_cond.Wait(client_lock);
   }
 
+  while (aio_inflight > 0) {
+    ldout(cct, 10) << "waiting on " << aio_inflight << " aio requests" << dendl;
+    mount_cond.Wait(client_lock);
+  }
+
   if (tick_event)
     timer.cancel_event(tick_event);
   tick_event = 0;
@@ -4794,6 +4838,15 @@ void Client::unmount()
 
   _ll_drop_pins();
 
+  // send any gathered sync writes now rather than on their timers; the
+  // timer goes away with us and would drop them unrun
+  for (ceph::unordered_map<vinodeno_t, Inode*>::iterator p = inode_map.begin();
+       p != inode_map.end();
+       ++p) {
+    if (p->second && p->second->write_gather)
+      _sync_write_dispatch(p->second);
+  }
+
   while (unsafe_sync_write > 0) {
     ldout(cct, 0) << unsafe_sync_write << " unsafe_sync_writes, waiting"  << dendl;
     mount_cond.Wait(client_lock);
@@ -4997,6 +5050,40 @@ int Client::_do_lookup(Inode *dir, const string& name, Inode **target)
   return r;
 }
 
+/*
+ * can dn, a dentry in dir, be used without asking the mds?  only if it
+ * is covered by its own lease or by dir's FILE_SHARED cap.
+ */
+bool Client::_dentry_valid(Inode *dir, Dentry *dn)
+{
+  if (dn->inode && !dn->inode->is_any_caps()) {
+    ldout(cct, 20) << " no cap on " << dn->inode->vino() << dendl;
+    return false;
+  }
+
+  // is dn lease valid?
+  utime_t now = ceph_clock_now(cct);
+  if (dn->lease_mds >= 0 &&
+      dn->lease_ttl > now &&
+      mds_sessions.count(dn->lease_mds)) {
+    MetaSession *s = mds_sessions[dn->lease_mds];
+    if (s->cap_ttl > now &&
+	s->cap_gen == dn->lease_gen) {
+      // touch this mds's dir cap too, even though we don't _explicitly_ use it here, to
+      // make trim_caps() behave.
+      dir->try_touch_cap(dn->lease_mds);
+      return true;
+    }
+    ldout(cct, 20) << " bad lease, cap_ttl " << s->cap_ttl << ", cap_gen " << s->cap_gen
+		   << " vs lease_gen " << dn->lease_gen << dendl;
+  }
+  // dir lease?
+  if (dir->caps_issued_mask(CEPH_CAP_FILE_SHARED) &&
+      dn->cap_shared_gen == dir->shared_gen)
+    return true;
+  return false;
+}
+
 int Client::_lookup(Inode *dir, const string& dname, Inode **target)
 {
   int r = 0;
@@ -5039,31 +5126,8 @@ int Client::_lookup(Inode *dir, const string& dname, Inode **target)
 	     << " seq " << dn->lease_seq
 	     << dendl;
 
-    if (!dn->inode || dn->inode->is_any_caps()) {
-      // is dn lease valid?
-      utime_t now = ceph_clock_now(cct);
-      if (dn->lease_mds >= 0 &&
-	  dn->lease_ttl > now &&
-	  mds_sessions.count(dn->lease_mds)) {
-	MetaSession *s = mds_sessions[dn->lease_mds];
-	if (s->cap_ttl > now &&
-	    s->cap_gen == dn->lease_gen) {
-	  // touch this mds's dir cap too, even though we don't _explicitly_ use it here, to
-	  // make trim_caps() behave.
-	  dir->try_touch_cap(dn->lease_mds);
-	  goto hit_dn;
-	}
-	ldout(cct, 20) << " bad lease, cap_ttl " << s->cap_ttl << ", cap_gen " << s->cap_gen
-		       << " vs lease_gen " << dn->lease_gen << dendl;
-      }
-      // dir lease?
-      if (dir->caps_issued_mask(CEPH_CAP_FILE_SHARED) &&
-	  dn->cap_shared_gen == dir->shared_gen) {
-	goto hit_dn;
-      }
-    } else {
-      ldout(cct, 20) << " no cap on " << dn->inode->vino() << dendl;
-    }
+    if (_dentry_valid(dir, dn))
+      goto hit_dn;
   } else {
     // can we conclude ENOENT locally?
     if (dir->caps_issued_mask(CEPH_CAP_FILE_SHARED) &&
@@ -5073,10 +5137,12 @@ int Client::_lookup(Inode *dir, const string& dname, Inode **target)
     }
   }
 
+  logger->inc(l_c_dn_miss);
   r = _do_lookup(dir, dname, target);
   goto done;
 
  hit_dn:
+  logger->inc(l_c_dn_hit);
   if (dn->inode) {
     *target = dn->inode;
   } else {
@@ -5456,6 +5522,9 @@ int Client::_setattr(Inode *in, struct stat *attr, int mask, int uid, int gid,
       is_quota_bytes_exceeded(in, (unsigned long)attr->st_size - in->size)) {
     return -EDQUOT;
   }
+  // gathered sync writes go out before the size changes under them
+  if ((mask & CEPH_SETATTR_SIZE) && in->write_gather)
+    _sync_write_dispatch(in);
   // make the change locally?
 
   if (!mask) {
@@ -5639,6 +5708,116 @@ int Client::lstat(const char *relpath, struct stat *stbuf,
   return r;
 }
 
+/*
+ * stat a path without talking to the mds: every component must be a
+ * dentry we may trust on our own (see _dentry_valid) and the inode must
+ * have the caps covering its attributes.  -EAGAIN if either is not so,
+ * or if the walk would need '..', the snapdir or a symlink; the caller
+ * then falls back to stat().  so a path another client renamed or
+ * replaced stops resolving here as soon as the mds revokes the lease.
+ */
+int Client::stat_cached(const char *relpath, struct stat *stbuf, int mask)
+{
+  Mutex::Locker lock(client_lock);
+  filepath path(relpath);
+  Inode *cur = path.absolute() ? root : cwd;
+  if (!cur)
+    return -EAGAIN;
+
+  for (unsigned i = 0; i < path.depth(); i++) {
+    const string &dname = path[i];
+    if (dname == ".")
+      continue;
+    if (!cur->is_dir())
+      return -ENOTDIR;
+    if (dname == ".." || (dname == cct->_conf->client_snapdir &&
+			  cur->snapid == CEPH_NOSNAP))
+      return -EAGAIN;
+
+    Dentry *dn = NULL;
+    if (cur->dir) {
+      ceph::unordered_map<string, Dentry*>::iterator p = cur->dir->dentries.find(dname);
+      if (p != cur->dir->dentries.end())
+	dn = p->second;
+    }
+    if (!dn) {
+      if (cur->caps_issued_mask(CEPH_CAP_FILE_SHARED) && (cur->flags & I_COMPLETE))
+	return -ENOENT;
+      return -EAGAIN;
+    }
+    if (!_dentry_valid(cur, dn))
+      return -EAGAIN;
+    if (!dn->inode)
+      return -ENOENT;
+    touch_dn(dn);
+    cur = dn->inode;
+    if (cur->is_symlink())
+      return -EAGAIN;
+  }
+
+  if (!cur->caps_issued_mask(mask)) {
+    ldout(cct, 10) << "stat_cached " << relpath << " missing caps "
+		   << ccap_string(mask & ~cur->caps_issued()) << dendl;
+    return -EAGAIN;
+  }
+  fill_stat(cur, stbuf);
+  return 0;
+}
+
+/*
+ * stat() plus the inode's xattr_version, which the MDS bumps on every
+ * xattr change (POSIX ACLs included).  with Xs held it is served from
+ * cache like the rest; without, _getattr fetches it.  lets a caller
+ * cache something derived from the xattrs and check it without a clock.
+ */
+int Client::stat_xattr_version(const char *relpath, struct stat *stbuf,
+			       version_t *xattr_version)
+{
+  ldout(cct, 3) << "stat_xattr_version enter (relpath " << relpath << ")" << dendl;
+  Mutex::Locker lock(client_lock);
+  tout(cct) << "stat_xattr_version" << std::endl;
+  tout(cct) << relpath << std::endl;
+  filepath path(relpath);
+  Inode *in;
+  int r = path_walk(path, &in);
+  if (r < 0)
+    return r;
+  r = _getattr(in, CEPH_STAT_CAP_INODE_ALL | CEPH_STAT_CAP_XATTR);
+  if (r < 0) {
+    ldout(cct, 3) << "stat_xattr_version exit on error!" << dendl;
+    return r;
+  }
+  fill_stat(in, stbuf);
+  *xattr_version = in->xattr_version;
+  ldout(cct, 3) << "stat_xattr_version exit (relpath " << relpath << ") xattr_version "
+		<< *xattr_version << dendl;
+  return r;
+}
+
+/*
+ * stat an inode we already have in cache, without walking a path or
+ * talking to the MDS.  the attributes are only handed out while we hold
+ * the caps that cover them; otherwise the caller must fall back to stat().
+ */
+int Client::stat_cached(inodeno_t ino, struct stat *stbuf, int mask)
+{
+  Mutex::Locker lock(client_lock);
+  ceph::unordered_map<vinodeno_t, Inode*>::iterator p =
+    inode_map.find(vinodeno_t(ino, CEPH_NOSNAP));
+  if (p == inode_map.end()) {
+    ldout(cct, 10) << "stat_cached " << ino << " not in cache" << dendl;
+    return -ESTALE;
+  }
+  Inode *in = p->second;
+  if (!in->caps_issued_mask(mask)) {
+    ldout(cct, 10) << "stat_cached " << ino << " missing caps "
+		   << ccap_string(mask & ~in->caps_issued()) << dendl;
+    return -EAGAIN;
+  }
+  fill_stat(in, stbuf);
+  return 0;
+}
+
 int Client::fill_stat(Inode *in, struct stat *st, frag_info_t *dirstat, nest_info_t *rstat)
 {
   ldout(cct, 10) << "fill_stat on " << in->ino << " snap/dev" << in->snapid
@@ -5890,6 +6069,7 @@ int Client::closedir(dir_result_t *dir)
 void Client::_closedir(dir_result_t *dirp)
 {
   ldout(cct, 10) << "_closedir(" << dirp << ")" << dendl;
+  _readdir_drop_prefetch(dirp);
   if (dirp->inode) {
     ldout(cct, 10) << "_closedir detaching inode " << dirp->inode << dendl;
     put_inode(dirp->inode);
@@ -6001,6 +6181,28 @@ void Client::_readdir_drop_dirp_buffer(dir_result_t *dirp)
   }
 }
 
+MetaRequest *Client::_readdir_make_request(Inode *diri, frag_t fg, const string& start,
+					    uint64_t offset)
+{
+  int op = CEPH_MDS_OP_READDIR;
+  if (diri->snapid == CEPH_SNAPDIR)
+    op = CEPH_MDS_OP_LSSNAP;
+
+  MetaRequest *req = new MetaRequest(op);
+  filepath path;
+  diri->make_nosnap_relative_path(path);
+  req->set_filepath(path); 
+  req->set_inode(diri);
+  req->head.args.readdir.frag = fg;
+  if (start.length()) {
+    req->path2.set_path(start.c_str());
+    req->readdir_start = start;
+  }
+  req->readdir_offset = offset;
+  req->readdir_frag = fg;
+  return req;
+}
+
 int Client::_readdir_get_frag(dir_result_t *dirp)
 {
   assert(dirp);
@@ -6013,31 +6215,38 @@ int Client::_readdir_get_frag(dir_result_t *dirp)
 	   << " next_offset " << dirp->next_offset
 	   << dendl;
 
-  int op = CEPH_MDS_OP_READDIR;
-  if (dirp->inode && dirp->inode->snapid == CEPH_SNAPDIR)
-    op = CEPH_MDS_OP_LSSNAP;
-
   Inode *diri = dirp->inode;
 
-  MetaRequest *req = new MetaRequest(op);
-  filepath path;
-  diri->make_nosnap_relative_path(path);
-  req->set_filepath(path); 
-  req->set_inode(diri);
-  req->head.args.readdir.frag = fg;
-  if (dirp->last_name.length()) {
-    req->path2.set_path(dirp->last_name.c_str());
-    req->readdir_start = dirp->last_name;
+  MetaRequest *req = NULL;
+  int res;
+  if ((dirp->prefetch_pending || dirp->prefetch_req) &&
+      dirp->prefetch_frag == fg &&
+      dirp->prefetch_start == dirp->last_name &&
+      dirp->prefetch_offset == dirp->next_offset) {
+    while (dirp->prefetch_pending)
+      readdir_prefetch_cond.Wait(client_lock);
+    res = dirp->prefetch_result;
+    if (res == 0) {
+      req = dirp->prefetch_req;
+      dirp->prefetch_req = NULL;
+      ldout(cct, 10) << "_readdir_get_frag using prefetched " << req << dendl;
+    } else {
+      _readdir_drop_prefetch(dirp);  // retry it ourselves
+    }
+  } else {
+    _readdir_drop_prefetch(dirp);
+  }
+
+  if (!req) {
+    req = _readdir_make_request(diri, fg, dirp->last_name, dirp->next_offset);
+    req->get();  // keep the results around until we have taken them
+    bufferlist dirbl;
+    res = make_request(req, -1, -1, NULL, NULL, -1, &dirbl);
   }
-  req->readdir_offset = dirp->next_offset;
-  req->readdir_frag = fg;
-  
-  
-  bufferlist dirbl;
-  int res = make_request(req, -1, -1, NULL, NULL, -1, &dirbl);
   
   if (res == -EAGAIN) {
     ldout(cct, 10) << "_readdir_get_frag got EAGAIN, retrying" << dendl;
+    put_request(req);
     _readdir_rechoose_frag(dirp);
     return _readdir_get_frag(dirp);
   }
@@ -6080,10 +6289,76 @@ int Client::_readdir_get_frag(dir_result_t *dirp)
     dirp->set_end();
   }
 
+  put_request(req);
   return res;
 }
 
-int Client::_readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p)
+/*
+ * start fetching the chunk that will follow dirp's current buffer, so that
+ * the MDS round trip overlaps with the caller consuming what we have.
+ * _readdir_get_frag picks the result up if it asks for the same chunk.
+ */
+void Client::_readdir_prefetch(dir_result_t *dirp)
+{
+  if (dirp->at_end() || !dirp->buffer ||
+      dirp->prefetch_pending || dirp->prefetch_req)
+    return;
+
+  frag_t fg = dirp->buffer_frag;
+  if (dirp->last_name.length()) {
+    dirp->prefetch_frag = fg;
+    dirp->prefetch_start = dirp->last_name;
+  } else if (!fg.is_rightmost()) {
+    dirp->prefetch_frag = dirp->inode->dirfragtree[fg.next().value()];
+    dirp->prefetch_start.clear();
+  } else {
+    return;  // this is the last chunk
+  }
+  dirp->prefetch_offset = dirp->next_offset;
+  dirp->prefetch_pending = true;
+
+  ldout(cct, 10) << "_readdir_prefetch " << dirp << " fg " << dirp->prefetch_frag
+		 << " start '" << dirp->prefetch_start << "' offset "
+		 << dirp->prefetch_offset << dendl;
+  readdir_prefetcher.queue(new C_ReaddirPrefetch(this, dirp));
+}
+
+void Client::_readdir_prefetch_finish(dir_result_t *dirp)
+{
+  Mutex::Locker lock(client_lock);
+
+  assert(dirp->prefetch_pending);
+  MetaRequest *req = _readdir_make_request(dirp->inode, dirp->prefetch_frag,
+					   dirp->prefetch_start,
+					   dirp->prefetch_offset);
+  req->get();
+  bufferlist dirbl;
+  int r = make_request(req, -1, -1, NULL, NULL, -1, &dirbl);
+  ldout(cct, 10) << "_readdir_prefetch_finish " << dirp << " = " << r << dendl;
+
+  dirp->prefetch_req = req;
+  dirp->prefetch_result = r;
+  dirp->prefetch_pending = false;
+  readdir_prefetch_cond.Signal();
+}
+
+void Client::_readdir_drop_prefetch(dir_result_t *dirp)
+{
+  while (dirp->prefetch_pending)
+    readdir_prefetch_cond.Wait(client_lock);
+  MetaRequest *req = dirp->prefetch_req;
+  if (req) {
+    ldout(cct, 10) << "_readdir_drop_prefetch " << dirp << " " << req << dendl;
+    for (unsigned i = 0; i < req->readdir_result.size(); i++)
+      put_inode(req->readdir_result[i].second);
+    req->readdir_result.clear();
+    put_request(req);
+    dirp->prefetch_req = NULL;
+  }
+}
+
+int Client::_readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p,
+			      bool cb_locked)
 {
   assert(client_lock.is_locked());
   ldout(cct, 10) << "_readdir_cache_cb " << dirp << " on " << dirp->inode->ino
@@ -6131,9 +6406,11 @@ int Client::_readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p)
     if (pd.end())
       next_off = dir_result_t::END;
 
-    client_lock.Unlock();
+    if (!cb_locked)
+      client_lock.Unlock();
     int r = cb(p, &de, &st, stmask, next_off);  // _next_ offset
-    client_lock.Lock();
+    if (!cb_locked)
+      client_lock.Lock();
     ldout(cct, 15) << " de " << de.d_name << " off " << hex << dn->offset << dec
 	     << " = " << r
 	     << dendl;
@@ -6154,7 +6431,8 @@ int Client::_readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p)
   return 0;
 }
 
-int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p)
+int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p,
+			 bool cb_locked)
 {
   Mutex::Locker lock(client_lock);
 
@@ -6187,9 +6465,11 @@ int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p)
 
     fill_stat(diri, &st);
 
-    client_lock.Unlock();
+    if (!cb_locked)
+      client_lock.Unlock();
     int r = cb(p, &de, &st, -1, next_off);
-    client_lock.Lock();
+    if (!cb_locked)
+      client_lock.Lock();
     if (r < 0)
       return r;
 
@@ -6211,9 +6491,11 @@ int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p)
     }
 
 
-    client_lock.Unlock();
+    if (!cb_locked)
+      client_lock.Unlock();
     int r = cb(p, &de, &st, -1, 2);
-    client_lock.Lock();
+    if (!cb_locked)
+      client_lock.Lock();
     if (r < 0)
       return r;
 
@@ -6233,7 +6515,7 @@ int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p)
       dirp->inode->snapid != CEPH_SNAPDIR &&
       dirp->inode->is_complete_and_ordered() &&
       dirp->inode->caps_issued_mask(CEPH_CAP_FILE_SHARED)) {
-    int err = _readdir_cache_cb(dirp, cb, p);
+    int err = _readdir_cache_cb(dirp, cb, p, cb_locked);
     if (err != -EAGAIN)
       return err;
   }
@@ -6267,9 +6549,11 @@ int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p)
       int stmask = fill_stat(ent.second, &st);  
       fill_dirent(&de, ent.first.c_str(), st.st_mode, st.st_ino, dirp->offset + 1);
       
-      client_lock.Unlock();
+      if (!cb_locked)
+	client_lock.Unlock();
       int r = cb(p, &de, &st, stmask, dirp->offset + 1);  // _next_ offset
-      client_lock.Lock();
+      if (!cb_locked)
+	client_lock.Lock();
       ldout(cct, 15) << " de " << de.d_name << " off " << hex << dirp->offset << dec
 	       << " = " << r
 	       << dendl;
@@ -6398,6 +6682,60 @@ int Client::readdirplus_r(dir_result_t *d, struct dirent *de, struct stat *st, i
   return 0;
 }
 
+/*
+ * readdirplus_batch
+ */
+
+struct batch_readdir {
+  struct dirent *de;
+  struct stat *st;
+  int *stmask;
+  int max;
+  int num;
+};
+
+static int _readdir_batch_cb(void *p, struct dirent *de, struct stat *st,
+			     int stmask, off_t off)
+{
+  batch_readdir *c = static_cast<batch_readdir *>(p);
+
+  if (c->num == c->max)
+    return -1;  // full; leave this one for the next call
+
+  c->de[c->num] = *de;
+  if (c->st)
+    c->st[c->num] = *st;
+  if (c->stmask)
+    c->stmask[c->num] = stmask;
+  c->num++;
+  return c->num == c->max ? 1 : 0;
+}
+
+int Client::readdirplus_batch(dir_result_t *d, struct dirent *de, struct stat *st,
+			      int *stmask, int max, bool prefetch)
+{
+  if (max <= 0)
+    return -EINVAL;
+
+  batch_readdir br;
+  br.de = de;
+  br.st = st;
+  br.stmask = stmask;
+  br.max = max;
+  br.num = 0;
+
+  // the callback only copies, so run it under client_lock instead of
+  // dropping and retaking the lock for every entry.
+  int r = readdir_r_cb(d, _readdir_batch_cb, (void *)&br, true);
+  if (r < -1)
+    return r;
+
+  if (prefetch) {
+    Mutex::Locker lock(client_lock);
+    _readdir_prefetch(d);
+  }
+  return br.num;
+}
 
 /* getdents */
 struct getdents_result {
@@ -6687,6 +7025,19 @@ int Client::lookup_name(Inode *ino, Inode *parent)
   return r;
 }
 
+// the readahead window limit for handles on in
+static uint64_t readahead_max(const md_config_t *conf, Inode *in)
+{
+  loff_t p = in->layout.fl_stripe_count * in->layout.fl_object_size;
+  uint64_t max_readahead = Readahead::NO_LIMIT;
+  if (conf->client_readahead_max_bytes) {
+    max_readahead = MIN(max_readahead, (uint64_t)conf->client_readahead_max_bytes);
+  }
+  if (conf->client_readahead_max_periods) {
+    max_readahead = MIN(max_readahead, ((uint64_t)conf->client_readahead_max_periods) * p);
+  }
+  return max_readahead;
+}
 
 Fh *Client::_create_fh(Inode *in, int flags, int cmode)
 {
@@ -6712,14 +7063,7 @@ Fh *Client::_create_fh(Inode *in, int flags, int cmode)
   loff_t p = in->layout.fl_stripe_count * in->layout.fl_object_size;
   f->readahead.set_trigger_requests(1);
   f->readahead.set_min_readahead_size(conf->client_readahead_min);
-  uint64_t max_readahead = Readahead::NO_LIMIT;
-  if (conf->client_readahead_max_bytes) {
-    max_readahead = MIN(max_readahead, (uint64_t)conf->client_readahead_max_bytes);
-  }
-  if (conf->client_readahead_max_periods) {
-    max_readahead = MIN(max_readahead, ((uint64_t)conf->client_readahead_max_periods) * p);
-  }
-  f->readahead.set_max_readahead_size(max_readahead);
+  f->readahead.set_max_readahead_size(readahead_max(conf, in));
   vector<uint64_t> alignments;
   alignments.push_back(p);
   alignments.push_back(in->layout.fl_stripe_unit);
@@ -6728,6 +7072,36 @@ Fh *Client::_create_fh(Inode *in, int flags, int cmode)
   return f;
 }
 
+/*
+ * per-handle access hints.  SEQUENTIAL starts readahead at the largest
+ * window instead of growing it from client_readahead_min, and reads are
+ * tagged DONTNEED so the ObjectCacher trims what was read first; RANDOM
+ * turns readahead off.  NOCACHE, WRITETHROUGH and TEMPORARY are looked at
+ * by _read, _write and the ObjectCacher flusher (via oset.temporary).
+ */
+void Client::_fadvise(Fh *f, int hints)
+{
+  const md_config_t *conf = cct->_conf;
+  Inode *in = f->inode;
+
+  ldout(cct, 10) << "_fadvise " << f << " on " << *in << " hints " << hints << dendl;
+
+  if ((hints & CEPH_FADVISE_TEMPORARY) && !(f->hints & CEPH_FADVISE_TEMPORARY))
+    in->oset.temporary++;
+  else if (!(hints & CEPH_FADVISE_TEMPORARY) && (f->hints & CEPH_FADVISE_TEMPORARY))
+    in->oset.temporary--;
+  f->hints = hints;
+
+  uint64_t min_readahead = conf->client_readahead_min;
+  if (hints & CEPH_FADVISE_SEQUENTIAL) {
+    uint64_t max_readahead = readahead_max(conf, in);
+    if (max_readahead == Readahead::NO_LIMIT)
+      max_readahead = in->layout.fl_stripe_count * in->layout.fl_object_size;
+    min_readahead = MAX(min_readahead, max_readahead);
+  }
+  f->readahead.set_min_readahead_size(min_readahead);
+}
+
 int Client::_release_fh(Fh *f)
 {
   //ldout(cct, 3) << "op: client->close(open_files[ " << fh << " ]);" << dendl;
@@ -6735,6 +7109,9 @@ int Client::_release_fh(Fh *f)
   Inode *in = f->inode;
   ldout(cct, 5) << "_release_fh " << f << " mode " << f->mode << " on " << *in << dendl;
 
+  if (f->hints & CEPH_FADVISE_TEMPORARY)
+    in->oset.temporary--;
+
   if (in->snapid == CEPH_NOSNAP) {
     if (in->put_open_ref(f->mode)) {
       _flush(in, new C_Client_FlushComplete(this, in));
@@ -6956,32 +7333,80 @@ int Client::uninline_data(Inode *in, Context *onfinish)
 
 // blocking osd interface
 
+/*
+ * copy a read result out to the caller's buffer.  uncached reads were
+ * received straight into buf; only copy what landed elsewhere.
+ */
+static int read_copy_out(const bufferlist& bl, char *buf)
+{
+  unsigned pos = 0;
+  for (list<bufferptr>::const_iterator p = bl.buffers().begin();
+       p != bl.buffers().end();
+       ++p) {
+    if (p->c_str() != buf + pos)
+      memcpy(buf + pos, p->c_str(), p->length());
+    pos += p->length();
+  }
+  return bl.length();
+}
+
 int Client::read(int fd, char *buf, loff_t size, loff_t offset)
 {
-  Mutex::Locker lock(client_lock);
+  client_lock.Lock();
   tout(cct) << "read" << std::endl;
   tout(cct) << fd << std::endl;
   tout(cct) << size << std::endl;
   tout(cct) << offset << std::endl;
 
   Fh *f = get_filehandle(fd);
-  if (!f)
+  if (!f) {
+    client_lock.Unlock();
     return -EBADF;
+  }
 #if defined(__linux__) && defined(O_PATH)
-  if (f->flags & O_PATH)
+  if (f->flags & O_PATH) {
+    client_lock.Unlock();
     return -EBADF;
+  }
 #endif
   bufferlist bl;
-  int r = _read(f, offset, size, &bl);
+  int r = _read(f, offset, size, &bl, buf);
   ldout(cct, 3) << "read(" << fd << ", " << (void*)buf << ", " << size << ", " << offset << ") = " << r << dendl;
-  if (r >= 0) {
-    bl.copy(0, bl.length(), buf);
-    r = bl.length();
-  }
+  client_lock.Unlock();
+
+  // bl holds its own refs on the cached buffers (which are never modified
+  // in place), so copy out without holding client_lock.
+  if (r >= 0)
+    r = read_copy_out(bl, buf);
   return r;
 }
 
-int Client::_read(Fh *f, int64_t offset, uint64_t size, bufferlist *bl)
+/*
+ * hand out len bytes of the caller's buffer at dest to be read into, or a
+ * fresh buffer if there is none.
+ */
+static bufferptr read_dest_ptr(char *dest, uint64_t len)
+{
+  if (dest)
+    return buffer::create_static(len, dest);
+  return buffer::create(len);
+}
+
+static void read_append_zero(bufferlist *bl, char *dest, uint64_t len)
+{
+  bufferptr z = read_dest_ptr(dest, len);
+  z.zero();
+  bl->push_back(z);
+}
+
+/*
+ * if dest is given it is the caller's buffer for [offset, offset+size);
+ * uncached reads post it to the messenger so object data is received in
+ * place.  bl may still reference other memory (cached or inline data,
+ * replies that raced with a resend) and the caller must copy those out.
+ */
+int Client::_read(Fh *f, int64_t offset, uint64_t size, bufferlist *bl,
+		  char *dest)
 {
   const md_config_t *conf = cct->_conf;
   Inode *in = f->inode;
@@ -7045,6 +7470,7 @@ retry:
   }
 
   if (!conf->client_debug_force_sync_read &&
+      !(f->hints & CEPH_FADVISE_NOCACHE) &&
       (cct->_conf->client_oc && (have & CEPH_CAP_FILE_CACHE))) {
 
     if (f->flags & O_RSYNC) {
@@ -7054,8 +7480,13 @@ retry:
     if (r < 0)
       goto done;
   } else {
+    // don't read around our own dirty data
+    if (f->hints & CEPH_FADVISE_NOCACHE)
+      _flush_range(in, offset, size);
+
     bool checkeof = false;
-    r = _read_sync(f, offset, size, bl, &checkeof);
+    r = _read_sync(f, offset, size, bl, &checkeof,
+		   dest ? dest + (offset - start_pos) : NULL);
     if (r < 0)
       goto done;
     if (checkeof) {
@@ -7136,8 +7567,10 @@ int Client::_read_async(Fh *f, uint64_t off, uint64_t len, bufferlist *bl)
   Cond cond;
   bool done = false;
   Context *onfinish = new C_SafeCond(&flock, &cond, &done, &rvalue);
+  int op_flags = (f->hints & CEPH_FADVISE_SEQUENTIAL) ? CEPH_OSD_OP_FLAG_FADVISE_DONTNEED : 0;
   r = objectcacher->file_read(&in->oset, &in->layout, in->snapid,
-			      off, len, bl, 0, onfinish);
+			      off, len, bl, op_flags, onfinish);
+  _readahead(f, off, len, r > 0);
   if (r == 0) {
     get_cap_ref(in, CEPH_CAP_FILE_CACHE);
     client_lock.Unlock();
@@ -7153,39 +7586,68 @@ int Client::_read_async(Fh *f, uint64_t off, uint64_t len, bufferlist *bl)
     delete onfinish;
   }
 
-  if(conf->client_readahead_max_bytes > 0) {
-    pair<uint64_t, uint64_t> readahead_extent = f->readahead.update(off, len, in->size);
-    if (readahead_extent.second > 0) {
-      ldout(cct, 20) << "readahead " << readahead_extent.first << "~" << readahead_extent.second
-		     << " (caller wants " << off << "~" << len << ")" << dendl;
-      Context *onfinish2 = new C_Readahead(this, f);
-      f->readahead.inc_pending();
-      int r2 = objectcacher->file_read(&in->oset, &in->layout, in->snapid,
-				       readahead_extent.first, readahead_extent.second,
-				       NULL, 0, onfinish2);
-      if (r2 == 0) {
-	ldout(cct, 20) << "readahead initiated, c " << onfinish2 << dendl;
-	get_cap_ref(in, CEPH_CAP_FILE_RD | CEPH_CAP_FILE_CACHE);
-      } else {
-	f->readahead.dec_pending();
-	ldout(cct, 20) << "readahead was no-op, already cached" << dendl;
-	delete onfinish2;
-      }
-    }
-  }
-
   return r;
 }
 
-int Client::_read_sync(Fh *f, uint64_t off, uint64_t len, bufferlist *bl,
-		       bool *checkeof)
+/*
+ * account a cached read of off~len as a readahead hit or miss, and start
+ * whatever readahead that calls for.
+ */
+void Client::_readahead(Fh *f, uint64_t off, uint64_t len, bool hit)
 {
+  const md_config_t *conf = cct->_conf;
   Inode *in = f->inode;
-  uint64_t pos = off;
-  int left = len;
-  int read = 0;
 
-  ldout(cct, 10) << "_read_sync " << *in << " " << off << "~" << len << dendl;
+  if (conf->client_readahead_max_bytes == 0 &&
+      conf->client_readahead_max_periods == 0)
+    return;
+  if (f->hints & CEPH_FADVISE_RANDOM)
+    return;
+
+  logger->inc(hit ? l_c_ra_hit : l_c_ra_miss);
+  if (!hit)
+    f->readahead.note_miss();
+
+  vector<pair<uint64_t, uint64_t> > readahead_extents;
+  f->readahead.update(off, len, in->size, &readahead_extents);
+  for (vector<pair<uint64_t, uint64_t> >::iterator p = readahead_extents.begin();
+       p != readahead_extents.end();
+       ++p) {
+    ldout(cct, 20) << "readahead " << p->first << "~" << p->second
+		   << " (caller wants " << off << "~" << len << ")" << dendl;
+    Context *onfinish2 = new C_Readahead(this, f);
+    f->readahead.inc_pending();
+    int r2 = objectcacher->file_read(&in->oset, &in->layout, in->snapid,
+				     p->first, p->second,
+				     NULL, 0, onfinish2);
+    if (r2 == 0) {
+      ldout(cct, 20) << "readahead initiated, c " << onfinish2 << dendl;
+      get_cap_ref(in, CEPH_CAP_FILE_RD | CEPH_CAP_FILE_CACHE);
+      logger->inc(l_c_ra_bytes, p->second);
+    } else {
+      f->readahead.dec_pending();
+      ldout(cct, 20) << "readahead was no-op, already cached" << dendl;
+      delete onfinish2;
+    }
+  }
+  uint64_t wasted = f->readahead.take_wasted_bytes();
+  if (wasted)
+    logger->inc(l_c_ra_waste, wasted);
+}
+
+int Client::_read_sync(Fh *f, uint64_t off, uint64_t len, bufferlist *bl,
+		       bool *checkeof, char *dest)
+{
+  Inode *in = f->inode;
+  uint64_t pos = off;
+  int left = len;
+  int read = 0;
+
+  ldout(cct, 10) << "_read_sync " << *in << " " << off << "~" << len << dendl;
+
+  uint64_t su = in->layout.fl_stripe_unit;
+  if (cct->_conf->client_read_sync_window > 1 && su > 0 && len > su)
+    return _read_sync_window(f, off, len, bl, checkeof, dest);
 
   Mutex flock("Client::_read_sync flock");
   Cond cond;
@@ -7194,6 +7656,8 @@ int Client::_read_sync(Fh *f, uint64_t off, uint64_t len, bufferlist *bl,
     bool done = false;
     Context *onfinish = new C_SafeCond(&flock, &cond, &done, &r);
     bufferlist tbl;
+    if (dest)
+      tbl.push_back(read_dest_ptr(dest + read, left));
 
     int wanted = left;
     filer->read_trunc(in->ino, &in->layout, in->snapid,
@@ -7208,8 +7672,10 @@ int Client::_read_sync(Fh *f, uint64_t off, uint64_t len, bufferlist *bl,
     client_lock.Lock();
 
     // if we get ENOENT from OSD, assume 0 bytes returned
-    if (r == -ENOENT)
+    if (r == -ENOENT) {
       r = 0;
+      tbl.clear();
+    }
     if (r < 0)
       return r;
     if (tbl.length()) {
@@ -7227,9 +7693,7 @@ int Client::_read_sync(Fh *f, uint64_t off, uint64_t len, bufferlist *bl,
 	int64_t some = in->size - pos;
 	if (some > left)
 	  some = left;
-	bufferptr z(some);
-	z.zero();
-	bl->push_back(z);
+	read_append_zero(bl, dest ? dest + read : NULL, some);
 	read += some;
 	pos += some;
 	left -= some;
@@ -7245,6 +7709,131 @@ int Client::_read_sync(Fh *f, uint64_t off, uint64_t len, bufferlist *bl,
 }
 
 
+/*
+ * pipelined variant of _read_sync: split the range on stripe unit
+ * boundaries and keep up to client_read_sync_window of those reads
+ * outstanding at once.  results are consumed strictly in order, so
+ * holes between chunks are zero-filled and a short tail is handled
+ * exactly as it is for a single read_trunc.
+ */
+struct SyncReadChunk {
+  uint64_t off, len;
+  bufferlist bl;
+  int r;
+  bool done;
+  SyncReadChunk(uint64_t o, uint64_t l) : off(o), len(l), r(0), done(false) {}
+};
+
+int Client::_read_sync_window(Fh *f, uint64_t off, uint64_t len, bufferlist *bl,
+			      bool *checkeof, char *dest)
+{
+  Inode *in = f->inode;
+  uint64_t su = in->layout.fl_stripe_unit;
+  unsigned window = cct->_conf->client_read_sync_window;
+
+  ldout(cct, 10) << "_read_sync_window " << *in << " " << off << "~" << len
+		 << " window " << window << dendl;
+
+  // carve the range on stripe unit boundaries
+  vector<SyncReadChunk*> chunks;
+  uint64_t pos = off;
+  uint64_t end = off + len;
+  while (pos < end) {
+    uint64_t next = MIN(end, (pos / su + 1) * su);
+    SyncReadChunk *c = new SyncReadChunk(pos, next - pos);
+    if (dest)
+      c->bl.push_back(read_dest_ptr(dest + (pos - off), c->len));
+    chunks.push_back(c);
+    pos = next;
+  }
+
+  Mutex flock("Client::_read_sync_window flock");
+  Cond cond;
+  unsigned issued = 0;
+  unsigned consumed = 0;
+  int ret = 0;
+  bufferlist data;      // assembled result, up to the last chunk with data
+  uint64_t pending_zero = 0;  // hole bytes not yet known to precede data
+
+  while (consumed < chunks.size()) {
+    // keep the window full
+    while (ret == 0 && issued < chunks.size() && issued - consumed < window) {
+      SyncReadChunk *c = chunks[issued++];
+      Context *onfinish = new C_SafeCond(&flock, &cond, &c->done, &c->r);
+      filer->read_trunc(in->ino, &in->layout, in->snapid,
+			c->off, c->len, &c->bl, 0,
+			in->truncate_size, in->truncate_seq,
+			onfinish);
+    }
+
+    SyncReadChunk *c = chunks[consumed];
+    if (consumed < issued) {
+      client_lock.Unlock();
+      flock.Lock();
+      while (!c->done)
+	cond.Wait(flock);
+      flock.Unlock();
+      client_lock.Lock();
+    }
+    consumed++;
+
+    if (ret < 0 || consumed > issued)
+      continue;  // error seen; just drain what is still in flight
+
+    int r = c->r;
+    // if we get ENOENT from OSD, assume 0 bytes returned
+    if (r == -ENOENT) {
+      r = 0;
+      c->bl.clear();
+    }
+    if (r < 0) {
+      ret = r;
+      continue;
+    }
+    if (c->bl.length()) {
+      if (pending_zero) {
+	read_append_zero(&data, dest ? dest + data.length() : NULL,
+			 pending_zero);
+	pending_zero = 0;
+      }
+      data.claim_append(c->bl);
+    }
+    pending_zero += c->len - c->bl.length();
+  }
+
+  for (vector<SyncReadChunk*>::iterator p = chunks.begin();
+       p != chunks.end();
+       ++p)
+    delete *p;
+
+  if (ret < 0)
+    return ret;
+
+  int read = data.length();
+  bl->claim_append(data);
+
+  // short read?
+  if ((uint64_t)read < len) {
+    pos = off + read;
+    int left = len - read;
+    if (pos < in->size) {
+      // zero up to known EOF
+      int64_t some = in->size - pos;
+      if (some > left)
+	some = left;
+      read_append_zero(bl, dest ? dest + read : NULL, some);
+      read += some;
+      left -= some;
+      if (left == 0)
+	return read;
+    }
+
+    *checkeof = true;
+  }
+  return read;
+}
+
+
 /*
  * we keep count of uncommitted sync writes on the inode, so that
  * fsync can DDRT.
@@ -7281,8 +7870,143 @@ void Client::sync_write_commit(Inode *in)
   put_inode(in);
 }
 
+/*
+ * sync (no Fb) write gathering.  a write to an inode with nothing in
+ * flight goes straight out; one arriving while a batch is in flight is
+ * merged into in->write_gather with any write it overlaps or touches, and
+ * that batch goes out when the one in flight commits, when it reaches
+ * client_sync_write_gather_max bytes, or after
+ * client_sync_write_gather_window, whichever is first.  so a lone writer
+ * pays nothing, and concurrent small appenders share osd ops.
+ *
+ * onfinish and onsafe are both completed when the op carrying the write
+ * commits (or fails to go out, with the error), with client_lock not held.  with gathering disabled this is
+ * the plain write_trunc: onfinish on ack (on commit if commit is set).
+ */
+void Client::_sync_write(Inode *in, uint64_t off, uint64_t len, bufferlist& bl,
+			 Context *onfinish, Context *onsafe, bool commit)
+{
+  const md_config_t *conf = cct->_conf;
+  logger->inc(l_c_sync_writes);
+
+  if (!conf->client_sync_write_gather_max) {
+    Context *onack = onfinish;
+    Context *oncommit = new C_OnFinisher(onsafe, &objecter_finisher);
+    if (commit) {
+      // wait for the commit, not just the ack
+      C_Contexts *both = new C_Contexts(cct);
+      both->add(oncommit);
+      both->add(onfinish);
+      onack = NULL;
+      oncommit = both;
+    }
+    logger->inc(l_c_sync_write_ops);
+    int r = filer->write_trunc(in->ino, &in->layout, in->snaprealm->get_snap_context(),
+			       off, len, bl, ceph_clock_now(cct), 0,
+			       in->truncate_size, in->truncate_seq,
+			       onack, oncommit);
+    if (r < 0) {
+      // nothing went out; fail the waiters instead of leaving them blocked
+      ldout(cct, 1) << "_sync_write " << off << "~" << len << " submit failed: "
+		    << cpp_strerror(r) << dendl;
+      if (onack)
+	onack->complete(r);
+      oncommit->complete(r);
+    }
+    return;
+  }
+
+  WriteGather *g = in->write_gather;
+  if (!g)
+    g = in->write_gather = new WriteGather;
+  g->add(off, bl);
+  g->writes++;
+  g->waiters.push_back(onfinish);
+  g->waiters.push_back(onsafe);
+
+  if (in->sync_writes_inflight == 0 || g->bytes >= conf->client_sync_write_gather_max) {
+    _sync_write_dispatch(in);
+  } else if (!g->timeout) {
+    ldout(cct, 15) << "_sync_write " << off << "~" << len << " waits behind "
+		   << in->sync_writes_inflight << " in flight" << dendl;
+    in->get();
+    g->timeout = new C_SyncWriteTimeout(this, in);
+    timer.add_event_after(conf->client_sync_write_gather_window, g->timeout);
+  }
+}
+
+void Client::_sync_write_dispatch(Inode *in)
+{
+  assert(client_lock.is_locked());
+  WriteGather *g = in->write_gather;
+  if (!g)
+    return;
+  in->write_gather = NULL;
+
+  ldout(cct, 10) << "_sync_write_dispatch " << *in << " " << g->writes << " writes, "
+		 << g->bytes << " bytes in " << g->extents.size() << " ops" << dendl;
+
+  in->get();  // for C_SyncWriteCommit
+  in->sync_writes_inflight++;
+  C_GatherBuilder gather(cct, new C_OnFinisher(new C_SyncWriteCommit(this, in, g->waiters),
+					       &objecter_finisher));
+  utime_t mtime = ceph_clock_now(cct);
+  for (map<uint64_t, bufferlist>::iterator p = g->extents.begin();
+       p != g->extents.end();
+       ++p) {
+    logger->inc(l_c_sync_write_ops);
+    Context *sub = gather.new_sub();
+    int r = filer->write_trunc(in->ino, &in->layout, in->snaprealm->get_snap_context(),
+			       p->first, p->second.length(), p->second, mtime, 0,
+			       in->truncate_size, in->truncate_seq,
+			       NULL, sub);
+    if (r < 0) {
+      // the gather hands the first error to every waiter
+      ldout(cct, 1) << "_sync_write_dispatch " << p->first << "~" << p->second.length()
+		    << " submit failed: " << cpp_strerror(r) << dendl;
+      sub->complete(r);
+    }
+  }
+  gather.activate();
+
+  if (g->timeout) {
+    timer.cancel_event(g->timeout);
+    put_inode(in);
+  }
+  delete g;
+}
+
+void Client::_sync_write_timeout(Inode *in)
+{
+  // from the timer, under client_lock
+  assert(in->write_gather && in->write_gather->timeout);
+  in->write_gather->timeout = NULL;
+  _sync_write_dispatch(in);
+  put_inode(in);
+}
+
+void Client::_sync_write_commit(Inode *in, list<Context*>& waiters, int r)
+{
+  client_lock.Lock();
+  ldout(cct, 15) << "_sync_write_commit " << *in << " r=" << r << dendl;
+  assert(in->sync_writes_inflight > 0);
+  in->sync_writes_inflight--;
+  if (in->sync_writes_inflight == 0)
+    _sync_write_dispatch(in);
+  put_inode(in);
+  client_lock.Unlock();
+
+  // the waiters take client_lock themselves
+  finish_contexts(cct, waiters, r);
+}
+
 int Client::write(int fd, const char *buf, loff_t size, loff_t offset) 
 {
+  // copy into a fresh buffer before taking client_lock; the write may be
+  // resubmitted or completed asynchronously.
+  bufferlist bl;
+  _write_prepare(buf, size, bl);
+
   Mutex::Locker lock(client_lock);
   tout(cct) << "write" << std::endl;
   tout(cct) << fd << std::endl;
@@ -7296,13 +8020,20 @@ int Client::write(int fd, const char *buf, loff_t size, loff_t offset)
   if (fh->flags & O_PATH)
     return -EBADF;
 #endif
-  int r = _write(fh, offset, size, buf);
+  int r = _write(fh, offset, size, bl);
   ldout(cct, 3) << "write(" << fd << ", \"...\", " << size << ", " << offset << ") = " << r << dendl;
   return r;
 }
 
 
-int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
+void Client::_write_prepare(const char *buf, uint64_t size, bufferlist& bl)
+{
+  bufferptr bp;
+  if (size > 0) bp = buffer::copy(buf, size);
+  bl.push_back( bp );
+}
+
+int Client::_write(Fh *f, int64_t offset, uint64_t size, bufferlist& bl)
 {
   if ((uint64_t)(offset+size) > mdsmap->get_max_filesize()) //too large!
     return -EFBIG;
@@ -7353,14 +8084,6 @@ int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
     assert(in->inline_version > 0);
   }
 
-  // copy into fresh buffer (since our write may be resub, async)
-  bufferptr bp;
-  if (size > 0) bp = buffer::copy(buf, size);
-  bufferlist bl;
-  bl.push_back( bp );
-
-  utime_t lat;
-  uint64_t totalwritten;
   int have;
   int r = get_caps(in, CEPH_CAP_FILE_WR, CEPH_CAP_FILE_BUFFER, &have, endoff);
   if (r < 0)
@@ -7405,7 +8128,8 @@ int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
     }
   }
 
-  if (cct->_conf->client_oc && (have & CEPH_CAP_FILE_BUFFER)) {
+  if (cct->_conf->client_oc && (have & CEPH_CAP_FILE_BUFFER) &&
+      !(f->hints & CEPH_FADVISE_NOCACHE)) {
     // do buffered write
     if (!in->oset.dirty_or_tx)
       get_cap_ref(in, CEPH_CAP_FILE_CACHE | CEPH_CAP_FILE_BUFFER);
@@ -7425,26 +8149,30 @@ int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
     // flush cached write if O_SYNC is set on file fh
     // O_DSYNC == O_SYNC on linux < 2.6.33
     // O_SYNC = __O_SYNC | O_DSYNC on linux >= 2.6.33
-    if ((f->flags & O_SYNC) || (f->flags & O_DSYNC)) {
+    if ((f->flags & O_SYNC) || (f->flags & O_DSYNC) ||
+	(f->hints & CEPH_FADVISE_WRITETHROUGH)) {
       _flush_range(in, offset, size);
     }
   } else {
+    // uncached handle: write out and drop anything cached under us first
+    if (f->hints & CEPH_FADVISE_NOCACHE) {
+      _flush_range(in, offset, size);
+      _invalidate_inode_cache(in, offset, size);
+    }
+
     // simple, non-atomic sync write
     Mutex flock("Client::_write flock");
     Cond cond;
     bool done = false;
-    Context *onfinish = new C_SafeCond(&flock, &cond, &done);
+    int wr = 0;
+    Context *onfinish = new C_SafeCond(&flock, &cond, &done, &wr);
     Context *onsafe = new C_Client_SyncCommit(this, in);
 
     unsafe_sync_write++;
     get_cap_ref(in, CEPH_CAP_FILE_BUFFER);  // released by onsafe callback
 
-    r = filer->write_trunc(in->ino, &in->layout, in->snaprealm->get_snap_context(),
-			   offset, size, bl, ceph_clock_now(cct), 0,
-			   in->truncate_size, in->truncate_seq,
-			   onfinish, new C_OnFinisher(onsafe, &objecter_finisher));
-    if (r < 0)
-      goto done;
+    _sync_write(in, offset, size, bl, onfinish, onsafe,
+		f->hints & CEPH_FADVISE_WRITETHROUGH);
 
     client_lock.Unlock();
     flock.Lock();
@@ -7453,21 +8181,51 @@ int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
       cond.Wait(flock);
     flock.Unlock();
     client_lock.Lock();
+
+    if (wr < 0) {
+      r = wr;
+      goto done;
+    }
   }
 
   // if we get here, write was successful, update client metadata
 success:
+  _write_success(in, offset, size, start);
+  r = (int)size;
+
+done:
+
+  if (onuninline) {
+    client_lock.Unlock();
+    uninline_flock.Lock();
+    while (!uninline_done)
+      uninline_cond.Wait(uninline_flock);
+    uninline_flock.Unlock();
+    client_lock.Lock();
+
+    if (uninline_ret >= 0 || uninline_ret == -ECANCELED) {
+      in->inline_data.clear();
+      in->inline_version = CEPH_INLINE_NONE;
+      mark_caps_dirty(in, CEPH_CAP_FILE_WR);
+      check_caps(in, false);
+    } else
+      r = uninline_ret;
+  }
+
+  put_cap_ref(in, CEPH_CAP_FILE_WR);
+  return r;
+}
+
+void Client::_write_success(Inode *in, int64_t offset, uint64_t size, utime_t start)
+{
   // time
-  lat = ceph_clock_now(cct);
+  utime_t lat = ceph_clock_now(cct);
   lat -= start;
   logger->tinc(l_c_wrlat, lat);
 
-  totalwritten = size;
-  r = (int)totalwritten;
-
   // extend file?
-  if (totalwritten + offset > in->size) {
-    in->size = totalwritten + offset;
+  if (size + offset > in->size) {
+    in->size = size + offset;
     mark_caps_dirty(in, CEPH_CAP_FILE_WR);
 
     if (is_quota_bytes_approaching(in)) {
@@ -7478,36 +8236,271 @@ success:
         check_caps(in, false);
     }
 
-    ldout(cct, 7) << "wrote to " << totalwritten+offset << ", extending file size" << dendl;
+    ldout(cct, 7) << "wrote to " << size+offset << ", extending file size" << dendl;
   } else {
-    ldout(cct, 7) << "wrote to " << totalwritten+offset << ", leaving file size at " << in->size << dendl;
+    ldout(cct, 7) << "wrote to " << size+offset << ", leaving file size at " << in->size << dendl;
   }
 
   // mtime
   in->mtime = ceph_clock_now(cct);
   mark_caps_dirty(in, CEPH_CAP_FILE_WR);
+}
 
-done:
 
-  if (onuninline) {
-    client_lock.Unlock();
-    uninline_flock.Lock();
-    while (!uninline_done)
-      uninline_cond.Wait(uninline_flock);
-    uninline_flock.Unlock();
+// non-blocking osd interface
+
+/*
+ * aio_read and aio_write return as soon as the request is handed to the
+ * ObjectCacher or the Filer, and onfinish is called from aio_finisher
+ * with the byte count or a negative error.  requests that cannot be
+ * issued without waiting (caps not yet issued, inline data, O_RSYNC or
+ * O_SYNC, NOCACHE or WRITETHROUGH writes) are done synchronously before
+ * returning, and still complete through onfinish.  buffered writes are subject to the cache's dirty
+ * throttle like any other.  an error returned directly means the request
+ * was rejected and onfinish will not be called; otherwise buf must stay
+ * valid until it is.
+ */
+
+// copy the result out, off client_lock, and hand it to the caller
+class C_Client_AioReadCopy : public Context {
+  char *buf;
+  bufferlist bl;
+  Context *onfinish;
+public:
+  C_Client_AioReadCopy(char *b, bufferlist& _bl, Context *fin)
+    : buf(b), onfinish(fin) {
+    bl.claim(_bl);
+  }
+  void finish(int r) {
+    if (r >= 0)
+      r = read_copy_out(bl, buf);
+    onfinish->complete(r);
+  }
+};
+
+int Client::aio_read(int fd, char *buf, loff_t size, loff_t offset,
+		     Context *onfinish)
+{
+  if (offset < 0)
+    return -EINVAL;
+
+  Mutex::Locker lock(client_lock);
+  tout(cct) << "aio_read" << std::endl;
+  tout(cct) << fd << std::endl;
+  tout(cct) << size << std::endl;
+  tout(cct) << offset << std::endl;
+
+  Fh *f = get_filehandle(fd);
+  if (!f)
+    return -EBADF;
+#if defined(__linux__) && defined(O_PATH)
+  if (f->flags & O_PATH)
+    return -EBADF;
+#endif
+  const md_config_t *conf = cct->_conf;
+  Inode *in = f->inode;
+
+  int have;
+  int r = -EAGAIN;
+  if (in->inline_version == CEPH_INLINE_NONE && !(f->flags & O_RSYNC) &&
+      !((f->hints & CEPH_FADVISE_NOCACHE) && in->oset.dirty_or_tx))
+    r = get_caps(in, CEPH_CAP_FILE_RD, CEPH_CAP_FILE_CACHE, &have, -1, true);
+  if (r == -EAGAIN) {
+    bufferlist bl;
+    r = _read(f, offset, size, &bl, buf);
+    ldout(cct, 3) << "aio_read(" << fd << ", " << (void*)buf << ", " << size << ", " << offset
+		  << ") = " << r << " (sync)" << dendl;
+    aio_finisher.queue(new C_Client_AioReadCopy(buf, bl, onfinish), r);
+    return 0;
+  }
+  if (r < 0)
+    return r;
+
+  ldout(cct, 3) << "aio_read(" << fd << ", " << (void*)buf << ", " << size << ", " << offset
+		<< ") have " << ccap_string(have) << dendl;
+  in->get();
+  aio_inflight++;
+
+  if (!conf->client_debug_force_sync_read &&
+      !(f->hints & CEPH_FADVISE_NOCACHE) &&
+      conf->client_oc && (have & CEPH_CAP_FILE_CACHE)) {
+    uint64_t len = size;
+    if ((uint64_t)offset >= in->size)
+      len = 0;
+    else if (offset + len > in->size)
+      len = in->size - offset;
+
+    C_AioRead *req = new C_AioRead(this, in, buf, offset, len, onfinish, true);
+    get_cap_ref(in, CEPH_CAP_FILE_CACHE);
+    if (len == 0) {
+      req->complete(0);
+      return 0;
+    }
+    int op_flags = (f->hints & CEPH_FADVISE_SEQUENTIAL) ? CEPH_OSD_OP_FLAG_FADVISE_DONTNEED : 0;
+    r = objectcacher->file_read(&in->oset, &in->layout, in->snapid,
+				offset, len, &req->bl, op_flags, req);
+    _readahead(f, offset, len, r > 0);
+    if (r != 0)
+      req->complete(r);  // cached, or failed
+  } else {
+    // receive straight into buf, as _read_sync does.  req takes
+    // client_lock, so it must not run from the objecter's reply path.
+    C_AioRead *req = new C_AioRead(this, in, buf, offset, size, onfinish, false);
+    req->bl.push_back(read_dest_ptr(buf, size));
+    filer->read_trunc(in->ino, &in->layout, in->snapid,
+		      offset, size, &req->bl, 0,
+		      in->truncate_size, in->truncate_seq,
+		      new C_OnFinisher(req, &objecter_finisher));
+  }
+  return 0;
+}
+
+void Client::_aio_read_finish(C_AioRead *req, int r)
+{
+  Inode *in = req->in;
+
+  if (req->cached) {
+    // the ObjectCacher completes under client_lock
+    assert(client_lock.is_locked_by_me());
+    put_cap_ref(in, CEPH_CAP_FILE_RD | CEPH_CAP_FILE_CACHE);
+  } else {
     client_lock.Lock();
 
-    if (uninline_ret >= 0 || uninline_ret == -ECANCELED) {
-      in->inline_data.clear();
-      in->inline_version = CEPH_INLINE_NONE;
-      mark_caps_dirty(in, CEPH_CAP_FILE_WR);
-      check_caps(in, false);
-    } else
-      r = uninline_ret;
+    // if we get ENOENT from OSD, assume 0 bytes returned
+    if (r == -ENOENT) {
+      r = 0;
+      req->bl.clear();
+    }
+    // short read?  zero up to known EOF.  unlike read() we do not go back
+    // to the MDS to reverify the size.
+    uint64_t got = req->bl.length();
+    if (r >= 0 && got < req->len && req->off + got < in->size) {
+      uint64_t some = MIN(in->size - (req->off + got), req->len - got);
+      read_append_zero(&req->bl, req->buf + got, some);
+    }
+    put_cap_ref(in, CEPH_CAP_FILE_RD);
+  }
+
+  ldout(cct, 10) << "_aio_read_finish " << *in << " " << req->off << "~" << req->len
+		 << " = " << r << dendl;
+  _aio_done(in);
+  if (!req->cached)
+    client_lock.Unlock();
+
+  aio_finisher.queue(new C_Client_AioReadCopy(req->buf, req->bl, req->onfinish), r);
+}
+
+int Client::aio_write(int fd, const char *buf, loff_t size, loff_t offset,
+		      Context *onfinish)
+{
+  if (offset < 0)
+    return -EINVAL;
+
+  // copy before taking client_lock, as write() does
+  bufferlist bl;
+  _write_prepare(buf, size, bl);
+
+  Mutex::Locker lock(client_lock);
+  tout(cct) << "aio_write" << std::endl;
+  tout(cct) << fd << std::endl;
+  tout(cct) << size << std::endl;
+  tout(cct) << offset << std::endl;
+
+  Fh *f = get_filehandle(fd);
+  if (!f)
+    return -EBADF;
+#if defined(__linux__) && defined(O_PATH)
+  if (f->flags & O_PATH)
+    return -EBADF;
+#endif
+  Inode *in = f->inode;
+
+  if ((uint64_t)(offset+size) > mdsmap->get_max_filesize()) //too large!
+    return -EFBIG;
+  if (objecter->osdmap_full_flag())
+    return -ENOSPC;
+  if ((f->mode & CEPH_FILE_MODE_WR) == 0)
+    return -EBADF;
+  uint64_t endoff = offset + size;
+  if (endoff > in->size && is_quota_bytes_exceeded(in, endoff - in->size))
+    return -EDQUOT;
+
+  int have;
+  int r = -EAGAIN;
+  if (in->inline_version == CEPH_INLINE_NONE &&
+      !(f->flags & O_SYNC) && !(f->flags & O_DSYNC) &&
+      !(f->hints & (CEPH_FADVISE_NOCACHE | CEPH_FADVISE_WRITETHROUGH)))
+    r = get_caps(in, CEPH_CAP_FILE_WR, CEPH_CAP_FILE_BUFFER, &have, endoff, true);
+  if (r == -EAGAIN) {
+    r = _write(f, offset, size, bl);
+    ldout(cct, 3) << "aio_write(" << fd << ", \"...\", " << size << ", " << offset
+		  << ") = " << r << " (sync)" << dendl;
+    aio_finisher.queue(onfinish, r);
+    return 0;
+  }
+  if (r < 0)
+    return r;
+
+  ldout(cct, 3) << "aio_write(" << fd << ", \"...\", " << size << ", " << offset
+		<< ") have " << ccap_string(have) << dendl;
+  utime_t start = ceph_clock_now(cct);
+
+  if (cct->_conf->client_oc && (have & CEPH_CAP_FILE_BUFFER)) {
+    // buffered; done once it is in the cache
+    if (!in->oset.dirty_or_tx)
+      get_cap_ref(in, CEPH_CAP_FILE_CACHE | CEPH_CAP_FILE_BUFFER);
+
+    get_cap_ref(in, CEPH_CAP_FILE_BUFFER);
+    r = objectcacher->file_write(&in->oset, &in->layout, in->snaprealm->get_snap_context(),
+			         offset, size, bl, ceph_clock_now(cct), 0,
+			         client_lock);
+    put_cap_ref(in, CEPH_CAP_FILE_BUFFER);
+
+    if (r >= 0) {
+      _write_success(in, offset, size, start);
+      r = size;
+    }
+    put_cap_ref(in, CEPH_CAP_FILE_WR);
+    aio_finisher.queue(onfinish, r);
+    return 0;
   }
 
+  // sync write; done once the osds ack it (or commit it, if gathered)
+  Context *onsafe = new C_Client_SyncCommit(this, in);
+  unsafe_sync_write++;
+  get_cap_ref(in, CEPH_CAP_FILE_BUFFER);  // released by onsafe callback
+
+  in->get();
+  aio_inflight++;
+  C_AioWrite *req = new C_AioWrite(this, in, offset, size, start, onfinish);
+  _sync_write(in, offset, size, bl, new C_OnFinisher(req, &objecter_finisher),
+	      onsafe, false);
+  return 0;
+}
+
+void Client::_aio_write_finish(C_AioWrite *req, int r)
+{
+  Mutex::Locker lock(client_lock);
+  Inode *in = req->in;
+
+  ldout(cct, 10) << "_aio_write_finish " << *in << " " << req->off << "~" << req->len
+		 << " = " << r << dendl;
+  if (r >= 0) {
+    _write_success(in, req->off, req->len, req->start);
+    r = req->len;
+  }
   put_cap_ref(in, CEPH_CAP_FILE_WR);
-  return r;
+  _aio_done(in);
+  aio_finisher.queue(req->onfinish, r);
+}
+
+void Client::_aio_done(Inode *in)
+{
+  put_inode(in);
+  assert(aio_inflight > 0);
+  aio_inflight--;
+  if (aio_inflight == 0 && unmounting)
+    mount_cond.Signal();
 }
 
 int Client::_flush(Fh *f)
@@ -7582,6 +8575,10 @@ int Client::_fsync(Fh *f, bool syncdataonly)
   C_SafeCond *object_cacher_completion = NULL;
 
   ldout(cct, 3) << "_fsync(" << f << ", " << (syncdataonly ? "dataonly)":"data+metadata)") << dendl;
+
+  // don't leave gathered sync writes waiting on the timer
+  if (in->write_gather)
+    _sync_write_dispatch(in);
   
   if (cct->_conf->client_oc) {
     object_cacher_completion = new C_SafeCond(&lock, &cond, &done, &r);
@@ -7641,6 +8638,24 @@ int Client::_fsync(Fh *f, bool syncdataonly)
   return r;
 }
 
+int Client::fadvise(int fd, int hints)
+{
+  Mutex::Locker lock(client_lock);
+  tout(cct) << "fadvise" << std::endl;
+  tout(cct) << fd << std::endl;
+  tout(cct) << hints << std::endl;
+
+  Fh *f = get_filehandle(fd);
+  if (!f)
+    return -EBADF;
+  if (hints & ~(CEPH_FADVISE_SEQUENTIAL | CEPH_FADVISE_RANDOM | CEPH_FADVISE_NOCACHE |
+		CEPH_FADVISE_WRITETHROUGH | CEPH_FADVISE_TEMPORARY))
+    return -EINVAL;
+  _fadvise(f, hints);
+  ldout(cct, 3) << "fadvise(" << fd << ", " << hints << ") = 0" << dendl;
+  return 0;
+}
+
 int Client::fstat(int fd, struct stat *stbuf) 
 {
   Mutex::Locker lock(client_lock);
@@ -8042,14 +9057,14 @@ int Client::_flock(Fh *fh, int cmd, uint64_t owner, void *fuse_req)
   return ret;
 }
 
-//int Client::ll_statfs(Inode *in, struct statvfs *stbuf)
-//{
-//  /* Since the only thing this does is wrap a call to statfs, and
-//     statfs takes a lock, it doesn't seem we have a need to split it
-//     out. */
-//  return statfs(0, stbuf);
-//}
-//
+int Client::ll_statfs(Inode *in, struct statvfs *stbuf)
+{
+  /* Since the only thing this does is wrap a call to statfs, and
+     statfs takes a lock, it doesn't seem we have a need to split it
+     out. */
+  return statfs(0, stbuf);
+}
+
 //void Client::ll_register_ino_invalidate_cb(client_ino_callback_t cb, void *handle)
 //{
 //  Mutex::Locker l(client_lock);
@@ -8234,61 +9249,62 @@ Inode *Client::open_snapdir(Inode *diri)
   return in;
 }
 
-//by ketor int Client::ll_lookup(Inode *parent, const char *name, struct stat *attr,
-//		      Inode **out, int uid, int gid)
-//{
-//  Mutex::Locker lock(client_lock);
-//  ldout(cct, 3) << "ll_lookup " << parent << " " << name << dendl;
-//  tout(cct) << "ll_lookup" << std::endl;
-//  tout(cct) << name << std::endl;
-//
-//  string dname(name);
-//  Inode *in;
-//  int r = 0;
-//
-//  r = _lookup(parent, dname, &in);
-//  if (r < 0) {
-//    attr->st_ino = 0;
-//    goto out;
-//  }
-//
-//  assert(in);
-//  fill_stat(in, attr);
-//  _ll_get(in);
-//
-// out:
-//  ldout(cct, 3) << "ll_lookup " << parent << " " << name
-//	  << " -> " << r << " (" << hex << attr->st_ino << dec << ")" << dendl;
-//  tout(cct) << attr->st_ino << std::endl;
-//  *out = in;
-//  return r;
-//}
-//
-//int Client::ll_walk(const char* name, Inode **i, struct stat *attr)
-//{
-//  Mutex::Locker lock(client_lock);
-//  filepath fp(name, 0);
-//  Inode *destination = NULL;
-//  int rc;
-//
-//  ldout(cct, 3) << "ll_walk" << name << dendl;
-//  tout(cct) << "ll_walk" << std::endl;
-//  tout(cct) << name << std::endl;
-//
-//  rc = path_walk(fp, &destination, false);
-//  if (rc < 0)
-//    {
-//      attr->st_ino = 0;
-//      *i = NULL;
-//      return rc;
-//    }
-//  else
-//    {
-//      fill_stat(destination, attr);
-//      *i = destination;
-//      return 0;
-//    }
-//}
+int Client::ll_lookup(Inode *parent, const char *name, struct stat *attr,
+		      Inode **out, int uid, int gid)
+{
+  Mutex::Locker lock(client_lock);
+  ldout(cct, 3) << "ll_lookup " << parent << " " << name << dendl;
+  tout(cct) << "ll_lookup" << std::endl;
+  tout(cct) << name << std::endl;
+
+  string dname(name);
+  Inode *in = NULL;
+  int r = 0;
+
+  r = _lookup(parent, dname, &in);
+  if (r < 0) {
+    attr->st_ino = 0;
+    goto out;
+  }
+
+  assert(in);
+  fill_stat(in, attr);
+  _ll_get(in);
+
+ out:
+  ldout(cct, 3) << "ll_lookup " << parent << " " << name
+	  << " -> " << r << " (" << hex << attr->st_ino << dec << ")" << dendl;
+  tout(cct) << attr->st_ino << std::endl;
+  *out = in;
+  return r;
+}
+
+int Client::ll_walk(const char* name, Inode **i, struct stat *attr)
+{
+  Mutex::Locker lock(client_lock);
+  filepath fp(name, 0);
+  Inode *destination = NULL;
+  int rc;
+
+  ldout(cct, 3) << "ll_walk" << name << dendl;
+  tout(cct) << "ll_walk" << std::endl;
+  tout(cct) << name << std::endl;
+
+  rc = path_walk(fp, &destination, false);
+  if (rc < 0)
+    {
+      attr->st_ino = 0;
+      *i = NULL;
+      return rc;
+    }
+  else
+    {
+      fill_stat(destination, attr);
+      _ll_get(destination); // caller drops it with ll_put()/ll_forget()
+      *i = destination;
+      return 0;
+    }
+}
 
 
 void Client::_ll_get(Inode *in)
@@ -8335,111 +9351,122 @@ void Client::_ll_drop_pins()
   }
 }
 
-//by ketor bool Client::ll_forget(Inode *in, int count)
-//{
-//  Mutex::Locker lock(client_lock);
-//  inodeno_t ino = _get_inodeno(in);
-//
-//  ldout(cct, 3) << "ll_forget " << ino << " " << count << dendl;
-//  tout(cct) << "ll_forget" << std::endl;
-//  tout(cct) << ino.val << std::endl;
-//  tout(cct) << count << std::endl;
-//
-//  if (ino == 1) return true;  // ignore forget on root.
-//
-//  bool last = false;
-//  if (in->ll_ref < count) {
-//    ldout(cct, 1) << "WARNING: ll_forget on " << ino << " " << count
-//		  << ", which only has ll_ref=" << in->ll_ref << dendl;
-//    _ll_put(in, in->ll_ref);
-//    last = true;
-//  } else {
-//    if (_ll_put(in, count) == 0)
-//      last = true;
-//  }
-//
-//  return last;
-//}
-//
-//bool Client::ll_put(Inode *in)
-//{
-//  /* ll_forget already takes the lock */
-//  return ll_forget(in, 1);
-//}
-//
-//snapid_t Client::ll_get_snapid(Inode *in)
-//{
-//  Mutex::Locker lock(client_lock);
-//  return in->snapid;
-//}
-//
-//Inode *Client::ll_get_inode(vinodeno_t vino)
-//{
-//  Mutex::Locker lock(client_lock);
-//  unordered_map<vinodeno_t,Inode*>::iterator p = inode_map.find(vino);
-//  if (p == inode_map.end())
-//    return NULL;
-//  Inode *in = p->second;
-//  _ll_get(in);
-//  return in;
-//}
-//
-//int Client::ll_getattr(Inode *in, struct stat *attr, int uid, int gid)
-//{
-//  Mutex::Locker lock(client_lock);
-//
-//  vinodeno_t vino = _get_vino(in);
-//
-//  ldout(cct, 3) << "ll_getattr " << vino << dendl;
-//  tout(cct) << "ll_getattr" << std::endl;
-//  tout(cct) << vino.ino.val << std::endl;
-//
-//  /* special case for dotdot (..) */
-//  if (vino.ino.val == CEPH_INO_DOTDOT) {
-//    attr->st_mode = S_IFDIR | 0755;
-//    attr->st_nlink = 2;
-//    return 0;
-//  }
-//
-//  int res;
-//  if (vino.snapid < CEPH_NOSNAP)
-//    res = 0;
-//  else
-//    res = _getattr(in, CEPH_STAT_CAP_INODE_ALL, uid, gid);
-//  if (res == 0)
-//    fill_stat(in, attr);
-//  ldout(cct, 3) << "ll_getattr " << vino << " = " << res << dendl;
-//  return res;
-//}
-//
-//int Client::ll_setattr(Inode *in, struct stat *attr, int mask, int uid,
-//		       int gid)
-//{
-//  Mutex::Locker lock(client_lock);
-//
-//  vinodeno_t vino = _get_vino(in);
-//
-//  ldout(cct, 3) << "ll_setattr " << vino << " mask " << hex << mask << dec
-//		<< dendl;
-//  tout(cct) << "ll_setattr" << std::endl;
-//  tout(cct) << vino.ino.val << std::endl;
-//  tout(cct) << attr->st_mode << std::endl;
-//  tout(cct) << attr->st_uid << std::endl;
-//  tout(cct) << attr->st_gid << std::endl;
-//  tout(cct) << attr->st_size << std::endl;
-//  tout(cct) << attr->st_mtime << std::endl;
-//  tout(cct) << attr->st_atime << std::endl;
-//  tout(cct) << mask << std::endl;
-//
-//  Inode *target = in;
-//  int res = _setattr(in, attr, mask, uid, gid, &target);
-//  if (res == 0) {
-//    assert(in == target);
-//    fill_stat(in, attr);
-//  }
-//  ldout(cct, 3) << "ll_setattr " << vino << " = " << res << dendl;
-//  return res;
-//}
+bool Client::ll_forget(Inode *in, int count)
+{
+  Mutex::Locker lock(client_lock);
+  inodeno_t ino = _get_inodeno(in);
+
+  ldout(cct, 3) << "ll_forget " << ino << " " << count << dendl;
+  tout(cct) << "ll_forget" << std::endl;
+  tout(cct) << ino.val << std::endl;
+  tout(cct) << count << std::endl;
+
+  // the mount keeps one ll ref on root (see mount()); callers only ever
+  // drop the ones they took with get_root() or a lookup.
+  if (ino == 1) {
+    if (count >= in->ll_ref) {
+      ldout(cct, 1) << "WARNING: ll_forget on root " << count
+		    << ", which only has ll_ref=" << in->ll_ref << dendl;
+      count = in->ll_ref - 1;
+    }
+    if (count > 0)
+      _ll_put(in, count);
+    return false;
+  }
+
+  bool last = false;
+  if (in->ll_ref < count) {
+    ldout(cct, 1) << "WARNING: ll_forget on " << ino << " " << count
+		  << ", which only has ll_ref=" << in->ll_ref << dendl;
+    _ll_put(in, in->ll_ref);
+    last = true;
+  } else {
+    if (_ll_put(in, count) == 0)
+      last = true;
+  }
+
+  return last;
+}
+
+bool Client::ll_put(Inode *in)
+{
+  /* ll_forget already takes the lock */
+  return ll_forget(in, 1);
+}
+
+snapid_t Client::ll_get_snapid(Inode *in)
+{
+  Mutex::Locker lock(client_lock);
+  return in->snapid;
+}
+
+Inode *Client::ll_get_inode(vinodeno_t vino)
+{
+  Mutex::Locker lock(client_lock);
+  ceph::unordered_map<vinodeno_t,Inode*>::iterator p = inode_map.find(vino);
+  if (p == inode_map.end())
+    return NULL;
+  Inode *in = p->second;
+  _ll_get(in);
+  return in;
+}
+
+int Client::ll_getattr(Inode *in, struct stat *attr, int uid, int gid)
+{
+  Mutex::Locker lock(client_lock);
+
+  vinodeno_t vino = _get_vino(in);
+
+  ldout(cct, 3) << "ll_getattr " << vino << dendl;
+  tout(cct) << "ll_getattr" << std::endl;
+  tout(cct) << vino.ino.val << std::endl;
+
+  /* special case for dotdot (..) */
+  if (vino.ino.val == CEPH_INO_DOTDOT) {
+    attr->st_mode = S_IFDIR | 0755;
+    attr->st_nlink = 2;
+    return 0;
+  }
+
+  int res;
+  if (vino.snapid < CEPH_NOSNAP)
+    res = 0;
+  else
+    res = _getattr(in, CEPH_STAT_CAP_INODE_ALL, uid, gid);
+  if (res == 0)
+    fill_stat(in, attr);
+  ldout(cct, 3) << "ll_getattr " << vino << " = " << res << dendl;
+  return res;
+}
+
+int Client::ll_setattr(Inode *in, struct stat *attr, int mask, int uid,
+		       int gid)
+{
+  Mutex::Locker lock(client_lock);
+
+  vinodeno_t vino = _get_vino(in);
+
+  ldout(cct, 3) << "ll_setattr " << vino << " mask " << hex << mask << dec
+		<< dendl;
+  tout(cct) << "ll_setattr" << std::endl;
+  tout(cct) << vino.ino.val << std::endl;
+  tout(cct) << attr->st_mode << std::endl;
+  tout(cct) << attr->st_uid << std::endl;
+  tout(cct) << attr->st_gid << std::endl;
+  tout(cct) << attr->st_size << std::endl;
+  tout(cct) << attr->st_mtime << std::endl;
+  tout(cct) << attr->st_atime << std::endl;
+  tout(cct) << mask << std::endl;
+
+  Inode *target = in;
+  int res = _setattr(in, attr, mask, uid, gid, &target);
+  if (res == 0) {
+    assert(in == target);
+    fill_stat(in, attr);
+  }
+  ldout(cct, 3) << "ll_setattr " << vino << " = " << res << dendl;
+  return res;
+}
 
 
 // ----------
@@ -9647,73 +10674,74 @@ int Client::_link(Inode *in, Inode *dir, const char *newname, int uid, int gid,
 //
 //  return (blockno % stripes_per_object) * su;
 //}
-//
-//int Client::ll_opendir(Inode *in, dir_result_t** dirpp, int uid, int gid)
-//{
-//  Mutex::Locker lock(client_lock);
-//
-//  vinodeno_t vino = _get_vino(in);
-//
-//  ldout(cct, 3) << "ll_opendir " << vino << dendl;
-//  tout(cct) << "ll_opendir" << std::endl;
-//  tout(cct) << vino.ino.val << std::endl;
-//
-//  int r = 0;
-//  if (vino.snapid == CEPH_SNAPDIR) {
-//    *dirpp = new dir_result_t(in);
-//  } else {
-//    r = _opendir(in, dirpp);
-//  }
-//
-//  tout(cct) << (unsigned long)*dirpp << std::endl;
-//
-//  ldout(cct, 3) << "ll_opendir " << vino << " = " << r << " (" << *dirpp << ")"
-//		<< dendl;
-//  return r;
-//}
-//
-//int Client::ll_releasedir(dir_result_t *dirp)
-//{
-//  Mutex::Locker lock(client_lock);
-//  ldout(cct, 3) << "ll_releasedir " << dirp << dendl;
-//  tout(cct) << "ll_releasedir" << std::endl;
-//  tout(cct) << (unsigned long)dirp << std::endl;
-//  _closedir(dirp);
-//  return 0;
-//}
-//
-//int Client::ll_open(Inode *in, int flags, Fh **fhp, int uid, int gid)
-//{
-//  assert(!(flags & O_CREAT));
-//
-//  Mutex::Locker lock(client_lock);
-//
-//  vinodeno_t vino = _get_vino(in);
-//
-//  ldout(cct, 3) << "ll_open " << vino << " " << flags << dendl;
-//  tout(cct) << "ll_open" << std::endl;
-//  tout(cct) << vino.ino.val << std::endl;
-//  tout(cct) << flags << std::endl;
-//
-//  int r;
-//  if (uid < 0) {
-//    uid = geteuid();
-//    gid = getegid();
-//  }
-//  r = check_permissions(in, flags, uid, gid);
-//  if (r < 0)
-//    goto out;
-//
-//  r = _open(in, flags, 0, fhp /* may be NULL */, uid, gid);
-//
-// out:
-//  Fh *fhptr = fhp ? *fhp : NULL;
-//  tout(cct) << (unsigned long)fhptr << std::endl;
-//  ldout(cct, 3) << "ll_open " << vino << " " << flags << " = " << r << " (" <<
-//    fhptr << ")" << dendl;
-//  return r;
-//}
-//
+
+int Client::ll_opendir(Inode *in, dir_result_t** dirpp, int uid, int gid)
+{
+  Mutex::Locker lock(client_lock);
+
+  vinodeno_t vino = _get_vino(in);
+
+  ldout(cct, 3) << "ll_opendir " << vino << dendl;
+  tout(cct) << "ll_opendir" << std::endl;
+  tout(cct) << vino.ino.val << std::endl;
+
+  int r = 0;
+  if (vino.snapid == CEPH_SNAPDIR) {
+    *dirpp = new dir_result_t(in);
+  } else {
+    r = _opendir(in, dirpp);
+  }
+
+  tout(cct) << (unsigned long)*dirpp << std::endl;
+
+  ldout(cct, 3) << "ll_opendir " << vino << " = " << r << " (" << *dirpp << ")"
+		<< dendl;
+  return r;
+}
+
+int Client::ll_releasedir(dir_result_t *dirp)
+{
+  Mutex::Locker lock(client_lock);
+  ldout(cct, 3) << "ll_releasedir " << dirp << dendl;
+  tout(cct) << "ll_releasedir" << std::endl;
+  tout(cct) << (unsigned long)dirp << std::endl;
+  _closedir(dirp);
+  return 0;
+}
+
+int Client::ll_open(Inode *in, int flags, Fh **fhp, int uid, int gid)
+{
+  if (flags & O_CREAT)
+    return -EINVAL;  // there is no ll_create; open by path instead
+
+  Mutex::Locker lock(client_lock);
+
+  vinodeno_t vino = _get_vino(in);
+
+  ldout(cct, 3) << "ll_open " << vino << " " << flags << dendl;
+  tout(cct) << "ll_open" << std::endl;
+  tout(cct) << vino.ino.val << std::endl;
+  tout(cct) << flags << std::endl;
+
+  int r;
+  if (uid < 0) {
+    uid = geteuid();
+    gid = getegid();
+  }
+  r = check_permissions(in, flags, uid, gid);
+  if (r < 0)
+    goto out;
+
+  r = _open(in, flags, 0, fhp /* may be NULL */, uid, gid);
+
+ out:
+  Fh *fhptr = fhp ? *fhp : NULL;
+  tout(cct) << (unsigned long)fhptr << std::endl;
+  ldout(cct, 3) << "ll_open " << vino << " " << flags << " = " << r << " (" <<
+    fhptr << ")" << dendl;
+  return r;
+}
+
 //int Client::ll_create(Inode *parent, const char *name, mode_t mode,
 //		      int flags, struct stat *attr, Inode **outp, Fh **fhp,
 //		      int uid, int gid)
@@ -9789,29 +10817,29 @@ int Client::_link(Inode *in, Inode *dir, const char *newname, int uid, int gid,
 //
 //  return r;
 //}
-//
-//loff_t Client::ll_lseek(Fh *fh, loff_t offset, int whence)
-//{
-//  Mutex::Locker lock(client_lock);
-//  tout(cct) << "ll_lseek" << std::endl;
-//  tout(cct) << offset << std::endl;
-//  tout(cct) << whence << std::endl;
-//
-//  return _lseek(fh, offset, whence);
-//}
-//
-//int Client::ll_read(Fh *fh, loff_t off, loff_t len, bufferlist *bl)
-//{
-//  Mutex::Locker lock(client_lock);
-//  ldout(cct, 3) << "ll_read " << fh << " " << fh->inode->ino << " " << " " << off << "~" << len << dendl;
-//  tout(cct) << "ll_read" << std::endl;
-//  tout(cct) << (unsigned long)fh << std::endl;
-//  tout(cct) << off << std::endl;
-//  tout(cct) << len << std::endl;
-//
-//  return _read(fh, off, len, bl);
-//}
-//
+
+loff_t Client::ll_lseek(Fh *fh, loff_t offset, int whence)
+{
+  Mutex::Locker lock(client_lock);
+  tout(cct) << "ll_lseek" << std::endl;
+  tout(cct) << offset << std::endl;
+  tout(cct) << whence << std::endl;
+
+  return _lseek(fh, offset, whence);
+}
+
+int Client::ll_read(Fh *fh, loff_t off, loff_t len, bufferlist *bl)
+{
+  Mutex::Locker lock(client_lock);
+  ldout(cct, 3) << "ll_read " << fh << " " << fh->inode->ino << " " << " " << off << "~" << len << dendl;
+  tout(cct) << "ll_read" << std::endl;
+  tout(cct) << (unsigned long)fh << std::endl;
+  tout(cct) << off << std::endl;
+  tout(cct) << len << std::endl;
+
+  return _read(fh, off, len, bl);
+}
+
 //int Client::ll_read_block(Inode *in, uint64_t blockid,
 //			  char *buf,
 //			  uint64_t offset,
@@ -9948,42 +10976,45 @@ int Client::_link(Inode *in, Inode *dir, const char *newname, int uid, int gid,
 //    */
 //    return 0;
 //}
-//
-//int Client::ll_write(Fh *fh, loff_t off, loff_t len, const char *data)
-//{
-//  Mutex::Locker lock(client_lock);
-//  ldout(cct, 3) << "ll_write " << fh << " " << fh->inode->ino << " " << off <<
-//    "~" << len << dendl;
-//  tout(cct) << "ll_write" << std::endl;
-//  tout(cct) << (unsigned long)fh << std::endl;
-//  tout(cct) << off << std::endl;
-//  tout(cct) << len << std::endl;
-//
-//  int r = _write(fh, off, len, data);
-//  ldout(cct, 3) << "ll_write " << fh << " " << off << "~" << len << " = " << r
-//		<< dendl;
-//  return r;
-//}
-//
-//int Client::ll_flush(Fh *fh)
-//{
-//  Mutex::Locker lock(client_lock);
-//  ldout(cct, 3) << "ll_flush " << fh << " " << fh->inode->ino << " " << dendl;
-//  tout(cct) << "ll_flush" << std::endl;
-//  tout(cct) << (unsigned long)fh << std::endl;
-//
-//  return _flush(fh);
-//}
-//
-//int Client::ll_fsync(Fh *fh, bool syncdataonly)
-//{
-//  Mutex::Locker lock(client_lock);
-//  ldout(cct, 3) << "ll_fsync " << fh << " " << fh->inode->ino << " " << dendl;
-//  tout(cct) << "ll_fsync" << std::endl;
-//  tout(cct) << (unsigned long)fh << std::endl;
-//
-//  return _fsync(fh, syncdataonly);
-//}
+
+int Client::ll_write(Fh *fh, loff_t off, loff_t len, const char *data)
+{
+  bufferlist bl;
+  _write_prepare(data, len, bl);
+
+  Mutex::Locker lock(client_lock);
+  ldout(cct, 3) << "ll_write " << fh << " " << fh->inode->ino << " " << off <<
+    "~" << len << dendl;
+  tout(cct) << "ll_write" << std::endl;
+  tout(cct) << (unsigned long)fh << std::endl;
+  tout(cct) << off << std::endl;
+  tout(cct) << len << std::endl;
+
+  int r = _write(fh, off, len, bl);
+  ldout(cct, 3) << "ll_write " << fh << " " << off << "~" << len << " = " << r
+		<< dendl;
+  return r;
+}
+
+int Client::ll_flush(Fh *fh)
+{
+  Mutex::Locker lock(client_lock);
+  ldout(cct, 3) << "ll_flush " << fh << " " << fh->inode->ino << " " << dendl;
+  tout(cct) << "ll_flush" << std::endl;
+  tout(cct) << (unsigned long)fh << std::endl;
+
+  return _flush(fh);
+}
+
+int Client::ll_fsync(Fh *fh, bool syncdataonly)
+{
+  Mutex::Locker lock(client_lock);
+  ldout(cct, 3) << "ll_fsync " << fh << " " << fh->inode->ino << " " << dendl;
+  tout(cct) << "ll_fsync" << std::endl;
+  tout(cct) << (unsigned long)fh << std::endl;
+
+  return _fsync(fh, syncdataonly);
+}
 
 #ifdef FALLOC_FL_PUNCH_HOLE
 
@@ -10065,6 +11096,9 @@ int Client::_fallocate(Fh *fh, int mode, int64_t offset, int64_t length)
       unsafe_sync_write++;
       get_cap_ref(in, CEPH_CAP_FILE_BUFFER);
 
+      // gathered writes must not land after the zeroing
+      if (in->write_gather)
+	_sync_write_dispatch(in);
       _invalidate_inode_cache(in, offset, length);
       r = filer->zero(in->ino, &in->layout,
                       in->snaprealm->get_snap_context(),
@@ -10158,17 +11192,17 @@ int Client::fallocate(int fd, int mode, loff_t offset, loff_t length)
   return _fallocate(fh, mode, offset, length);
 }
 
-//by ketor int Client::ll_release(Fh *fh)
-//{
-//  Mutex::Locker lock(client_lock);
-//  ldout(cct, 3) << "ll_release (fh)" << fh << " " << fh->inode->ino << " " <<
-//    dendl;
-//  tout(cct) << "ll_release (fh)" << std::endl;
-//  tout(cct) << (unsigned long)fh << std::endl;
-//
-//  _release_fh(fh);
-//  return 0;
-//}
+int Client::ll_release(Fh *fh)
+{
+  Mutex::Locker lock(client_lock);
+  ldout(cct, 3) << "ll_release (fh)" << fh << " " << fh->inode->ino << " " <<
+    dendl;
+  tout(cct) << "ll_release (fh)" << std::endl;
+  tout(cct) << (unsigned long)fh << std::endl;
+
+  _release_fh(fh);
+  return 0;
+}
 
 //int Client::ll_getlk(Fh *fh, struct flock *fl, uint64_t owner)
 //{
@@ -10656,7 +11690,7 @@ enum {
   POOL_WRITE = 8,
 };
 
-int Client::check_pool_perm(Inode *in, int need)
+int Client::check_pool_perm(Inode *in, int need, bool nonblock)
 {
   if (!cct->_conf->client_check_pool_perm)
     return 0;
@@ -10668,6 +11702,8 @@ int Client::check_pool_perm(Inode *in, int need)
     if (it == pool_perms.end())
       break;
     if (it->second == POOL_CHECKING) {
+      if (nonblock)
+	return -EAGAIN;
       // avoid concurrent checkings
       wait_on_list(waiting_for_pool_perm);
     } else {
@@ -10678,6 +11714,8 @@ int Client::check_pool_perm(Inode *in, int need)
   }
 
   if (!have) {
+    if (nonblock)
+      return -EAGAIN;
     pool_perms[pool] = POOL_CHECKING;
 
     char oid_buf[32];
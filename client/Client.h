@@ -83,6 +83,15 @@ enum {
   l_c_owrlat,
   l_c_ordlat,
   l_c_wrlat,
+  l_c_ra_hit,
+  l_c_ra_miss,
+  l_c_ra_bytes,
+  l_c_ra_waste,
+  l_c_sync_writes,
+  l_c_sync_write_ops,
+  l_c_dn_hit,
+  l_c_dn_miss,
+  l_c_dn_ghost_hit,
   l_c_last,
 };
 
@@ -186,6 +195,14 @@ struct dir_result_t {
 
   string at_cache_name;  // last entry we successfully returned
 
+  // next chunk, fetched in the background (see Client::_readdir_prefetch)
+  frag_t prefetch_frag;
+  string prefetch_start;
+  uint64_t prefetch_offset;
+  MetaRequest *prefetch_req;
+  int prefetch_result;
+  bool prefetch_pending;
+
   dir_result_t(Inode *in);
 
   frag_t frag() { return frag_t(offset >> SHIFT); }
@@ -250,6 +267,9 @@ class Client : public Dispatcher {
   Finisher interrupt_finisher;
   Finisher remount_finisher;
   Finisher objecter_finisher;
+  Finisher readdir_prefetcher;
+  Finisher aio_finisher;
+  Cond readdir_prefetch_cond;
 
   Context *tick_event;
   utime_t last_cap_renew;
@@ -331,6 +351,7 @@ public:
   epoch_t local_osd_epoch;
 
   int unsafe_sync_write;
+  int aio_inflight;  // aio_read/aio_write not yet done with client state
 
 public:
   entity_name_t get_myname() { return messenger->get_myname(); } 
@@ -398,6 +419,10 @@ protected:
 
   // global client lock
   //  - protects Client and buffer cache both!
+  //  - one domain: metadata, caps and the ObjectCacher (whose completions
+  //    and flush callbacks call back into cap accounting) all run under
+  //    it.  only copies to and from the caller's buffer are done outside
+  //    (read(), write(), ll_write()).
   Mutex                  client_lock;
 
   // helpers
@@ -482,7 +507,7 @@ protected:
 
   std::map<int64_t, int> pool_perms;
   list<Cond*> waiting_for_pool_perm;
-  int check_pool_perm(Inode *in, int need);
+  int check_pool_perm(Inode *in, int need, bool nonblock=false);
 
  public:
   void set_filer_flags(int flags);
@@ -525,7 +550,8 @@ protected:
   void flush_caps(Inode *in, MetaSession *session);
   void kick_flushing_caps(MetaSession *session);
   void kick_maxsize_requests(MetaSession *session);
-  int get_caps(Inode *in, int need, int want, int *have, loff_t endoff);
+  int get_caps(Inode *in, int need, int want, int *have, loff_t endoff,
+	       bool nonblock=false);
   int get_caps_used(Inode *in);
 
   void maybe_update_snaprealm(SnapRealm *realm, snapid_t snap_created, snapid_t snap_highwater, 
@@ -615,8 +641,14 @@ private:
   bool _readdir_have_frag(dir_result_t *dirp);
   void _readdir_next_frag(dir_result_t *dirp);
   void _readdir_rechoose_frag(dir_result_t *dirp);
+  MetaRequest *_readdir_make_request(Inode *diri, frag_t fg, const string& start,
+				     uint64_t offset);
   int _readdir_get_frag(dir_result_t *dirp);
-  int _readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p);
+  void _readdir_prefetch(dir_result_t *dirp);
+  void _readdir_prefetch_finish(dir_result_t *dirp);
+  void _readdir_drop_prefetch(dir_result_t *dirp);
+  int _readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p,
+			bool cb_locked);
   void _closedir(dir_result_t *dirp);
 
   // other helpers
@@ -628,8 +660,20 @@ private:
 
   Fh *_create_fh(Inode *in, int flags, int cmode);
   int _release_fh(Fh *fh);
+  void _fadvise(Fh *f, int hints);
 
 
+  struct C_ReaddirPrefetch : public Context {
+    Client *client;
+    dir_result_t *dirp;
+    C_ReaddirPrefetch(Client *c, dir_result_t *d)
+      : client(c),
+	dirp(d) { }
+    void finish(int r) {
+      client->_readdir_prefetch_finish(dirp);
+    }
+  };
+
   struct C_Readahead : public Context {
     Client *client;
     Fh *f;
@@ -639,12 +683,79 @@ private:
     void finish(int r);
   };
 
-  int _read_sync(Fh *f, uint64_t off, uint64_t len, bufferlist *bl, bool *checkeof);
+  int _read_sync(Fh *f, uint64_t off, uint64_t len, bufferlist *bl, bool *checkeof,
+		 char *dest=NULL);
+  int _read_sync_window(Fh *f, uint64_t off, uint64_t len, bufferlist *bl, bool *checkeof,
+			char *dest=NULL);
   int _read_async(Fh *f, uint64_t off, uint64_t len, bufferlist *bl);
+  void _readahead(Fh *f, uint64_t off, uint64_t len, bool hit);
+
+  struct C_AioRead : public Context {
+    Client *client;
+    Inode *in;
+    char *buf;
+    uint64_t off, len;
+    bufferlist bl;
+    Context *onfinish;
+    bool cached;  // completed by the ObjectCacher, under client_lock
+    C_AioRead(Client *c, Inode *i, char *b, uint64_t o, uint64_t l,
+	      Context *fin, bool oc)
+      : client(c), in(i), buf(b), off(o), len(l), onfinish(fin), cached(oc) {}
+    void finish(int r) {
+      client->_aio_read_finish(this, r);
+    }
+  };
+
+  struct C_AioWrite : public Context {
+    Client *client;
+    Inode *in;
+    uint64_t off, len;
+    utime_t start;
+    Context *onfinish;
+    C_AioWrite(Client *c, Inode *i, uint64_t o, uint64_t l, utime_t s,
+	       Context *fin)
+      : client(c), in(i), off(o), len(l), start(s), onfinish(fin) {}
+    void finish(int r) {
+      client->_aio_write_finish(this, r);
+    }
+  };
+
+  void _aio_read_finish(C_AioRead *req, int r);
+  void _aio_write_finish(C_AioWrite *req, int r);
+  void _aio_done(Inode *in);
+
+  struct C_SyncWriteTimeout : public Context {
+    Client *client;
+    Inode *in;
+    C_SyncWriteTimeout(Client *c, Inode *i) : client(c), in(i) {}
+    void finish(int r) {
+      client->_sync_write_timeout(in);
+    }
+  };
+
+  struct C_SyncWriteCommit : public Context {
+    Client *client;
+    Inode *in;
+    list<Context*> waiters;
+    C_SyncWriteCommit(Client *c, Inode *i, list<Context*>& w)
+      : client(c), in(i) {
+      waiters.swap(w);
+    }
+    void finish(int r) {
+      client->_sync_write_commit(in, waiters, r);
+    }
+  };
+
+  void _sync_write(Inode *in, uint64_t off, uint64_t len, bufferlist& bl,
+		   Context *onfinish, Context *onsafe, bool commit);
+  void _sync_write_dispatch(Inode *in);
+  void _sync_write_timeout(Inode *in);
+  void _sync_write_commit(Inode *in, list<Context*>& waiters, int r);
 
   // internal interface
   //   call these with client_lock held!
   int _do_lookup(Inode *dir, const string& name, Inode **target);
+  bool _dentry_valid(Inode *dir, Dentry *dn);
   int _lookup(Inode *dir, const string& dname, Inode **target);
 
   int _link(Inode *in, Inode *dir, const char *name, int uid=-1, int gid=-1, Inode **inp = 0);
@@ -666,8 +777,10 @@ private:
               int stripe_unit, int stripe_count, int object_size, const char *data_pool,
 	      bool *created = NULL, int uid=-1, int gid=-1);
   loff_t _lseek(Fh *fh, loff_t offset, int whence);
-  int _read(Fh *fh, int64_t offset, uint64_t size, bufferlist *bl);
-  int _write(Fh *fh, int64_t offset, uint64_t size, const char *buf);
+  int _read(Fh *fh, int64_t offset, uint64_t size, bufferlist *bl, char *dest=NULL);
+  void _write_prepare(const char *buf, uint64_t size, bufferlist& bl);
+  void _write_success(Inode *in, int64_t offset, uint64_t size, utime_t start);
+  int _write(Fh *fh, int64_t offset, uint64_t size, bufferlist& bl);
   int _flush(Fh *fh);
   int _fsync(Fh *fh, bool syncdataonly);
   int _sync_fs();
@@ -766,13 +879,28 @@ public:
    *
    * Returns 0 if it reached the end of the directory.
    * If @a cb returns a negative error code, stop and return that.
+   *
+   * @a cb is called without client_lock unless @a cb_locked is set, in
+   * which case it must not call back into the Client.
    */
-  int readdir_r_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p);
+  int readdir_r_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p,
+		   bool cb_locked=false);
 
   struct dirent * readdir(dir_result_t *d);
   int readdir_r(dir_result_t *dirp, struct dirent *de);
   int readdirplus_r(dir_result_t *dirp, struct dirent *de, struct stat *st, int *stmask);
 
+  /**
+   * Fill up to @a max dirents (and their stats and stmasks) in one call.
+   * If @a prefetch is set, the next chunk of the directory is requested
+   * from the MDS in the background while the caller consumes this batch.
+   *
+   * Returns the number of entries filled, 0 at the end of the directory,
+   * or -errno.
+   */
+  int readdirplus_batch(dir_result_t *dirp, struct dirent *de, struct stat *st,
+			int *stmask, int max, bool prefetch);
+
   int getdir(const char *relpath, list<string>& names);  // get the whole dir at once.
 
   /**
@@ -810,6 +938,9 @@ public:
   int stat(const char *path, struct stat *stbuf, frag_info_t *dirstat=0, int mask=CEPH_STAT_CAP_INODE_ALL);
   int lstat(const char *path, struct stat *stbuf, frag_info_t *dirstat=0, int mask=CEPH_STAT_CAP_INODE_ALL);
   int lstatlite(const char *path, struct statlite *buf);
+  int stat_cached(inodeno_t ino, struct stat *stbuf, int mask=CEPH_STAT_CAP_INODE_ALL);
+  int stat_cached(const char *path, struct stat *stbuf, int mask=CEPH_STAT_CAP_INODE_ALL);
+  int stat_xattr_version(const char *path, struct stat *stbuf, version_t *xattr_version);
 
   int setattr(const char *relpath, struct stat *attr, int mask);
   int fsetattr(int fd, struct stat *attr, int mask);
@@ -835,9 +966,12 @@ public:
   loff_t lseek(int fd, loff_t offset, int whence);
   int read(int fd, char *buf, loff_t size, loff_t offset=-1);
   int write(int fd, const char *buf, loff_t size, loff_t offset=-1);
+  int aio_read(int fd, char *buf, loff_t size, loff_t offset, Context *onfinish);
+  int aio_write(int fd, const char *buf, loff_t size, loff_t offset, Context *onfinish);
   int fake_write_size(int fd, loff_t size);
   int ftruncate(int fd, loff_t size);
   int fsync(int fd, bool syncdataonly);
+  int fadvise(int fd, int hints);
   int fstat(int fd, struct stat *stbuf);
   int fallocate(int fd, int mode, loff_t offset, loff_t length);
 
@@ -883,31 +1017,31 @@ public:
   int get_caps_issued(const char *path);
 
   // low-level interface v2
-//by ketor  inodeno_t ll_get_inodeno(Inode *in) {
-//    Mutex::Locker lock(client_lock);
-//    return _get_inodeno(in);
-//  }
-//  snapid_t ll_get_snapid(Inode *in);
-//  vinodeno_t ll_get_vino(Inode *in) {
-//    Mutex::Locker lock(client_lock);
-//    return _get_vino(in);
-//  }
-//  Inode *ll_get_inode(vinodeno_t vino);
-//  int ll_lookup(Inode *parent, const char *name, struct stat *attr,
-//		Inode **out, int uid = -1, int gid = -1);
-//  bool ll_forget(Inode *in, int count);
-//  bool ll_put(Inode *in);
-//  int ll_getattr(Inode *in, struct stat *st, int uid = -1, int gid = -1);
-//  int ll_setattr(Inode *in, struct stat *st, int mask, int uid = -1,
-//		 int gid = -1);
+  inodeno_t ll_get_inodeno(Inode *in) {
+    Mutex::Locker lock(client_lock);
+    return _get_inodeno(in);
+  }
+  snapid_t ll_get_snapid(Inode *in);
+  vinodeno_t ll_get_vino(Inode *in) {
+    Mutex::Locker lock(client_lock);
+    return _get_vino(in);
+  }
+  Inode *ll_get_inode(vinodeno_t vino);
+  int ll_lookup(Inode *parent, const char *name, struct stat *attr,
+		Inode **out, int uid = -1, int gid = -1);
+  bool ll_forget(Inode *in, int count);
+  bool ll_put(Inode *in);
+  int ll_getattr(Inode *in, struct stat *st, int uid = -1, int gid = -1);
+  int ll_setattr(Inode *in, struct stat *st, int mask, int uid = -1,
+		 int gid = -1);
 //  int ll_getxattr(Inode *in, const char *name, void *value, size_t size,
 //		  int uid=-1, int gid=-1);
 //  int ll_setxattr(Inode *in, const char *name, const void *value, size_t size,
 //		  int flags, int uid=-1, int gid=-1);
 //  int ll_removexattr(Inode *in, const char *name, int uid=-1, int gid=-1);
 //  int ll_listxattr(Inode *in, char *list, size_t size, int uid=-1, int gid=-1);
-//  int ll_opendir(Inode *in, dir_result_t **dirpp, int uid = -1, int gid = -1);
-//  int ll_releasedir(dir_result_t* dirp);
+  int ll_opendir(Inode *in, dir_result_t **dirpp, int uid = -1, int gid = -1);
+  int ll_releasedir(dir_result_t* dirp);
 //  int ll_readlink(Inode *in, char *buf, size_t bufsize, int uid = -1, int gid = -1);
 //  int ll_mknod(Inode *in, const char *name, mode_t mode, dev_t rdev,
 //	       struct stat *attr, Inode **out, int uid = -1, int gid = -1);
@@ -921,7 +1055,7 @@ public:
 //		const char *newname, int uid = -1, int gid = -1);
 //  int ll_link(Inode *in, Inode *newparent, const char *newname,
 //	      struct stat *attr, int uid = -1, int gid = -1);
-//  int ll_open(Inode *in, int flags, Fh **fh, int uid = -1, int gid = -1);
+  int ll_open(Inode *in, int flags, Fh **fh, int uid = -1, int gid = -1);
 //  int ll_create(Inode *parent, const char *name, mode_t mode, int flags,
 //		struct stat *attr, Inode **out, Fh **fhp, int uid = -1,
 //		int gid = -1);
@@ -934,21 +1068,21 @@ public:
 //		     uint64_t snapseq, uint32_t sync);
 //  int ll_commit_blocks(Inode *in, uint64_t offset, uint64_t length);
 
-//  int ll_statfs(Inode *in, struct statvfs *stbuf);
-//  int ll_walk(const char* name, Inode **i, struct stat *attr); // XXX in?
+  int ll_statfs(Inode *in, struct statvfs *stbuf);
+  int ll_walk(const char* name, Inode **i, struct stat *attr); // XXX in?
 //  int ll_listxattr_chunks(Inode *in, char *names, size_t size,
 //			  int *cookie, int *eol, int uid, int gid);
 //  uint32_t ll_stripe_unit(Inode *in);
 //  int ll_file_layout(Inode *in, ceph_file_layout *layout);
 //  uint64_t ll_snap_seq(Inode *in);
 
-//  int ll_read(Fh *fh, loff_t off, loff_t len, bufferlist *bl);
-//  int ll_write(Fh *fh, loff_t off, loff_t len, const char *data);
-//  loff_t ll_lseek(Fh *fh, loff_t offset, int whence);
-//  int ll_flush(Fh *fh);
-//  int ll_fsync(Fh *fh, bool syncdataonly);
+  int ll_read(Fh *fh, loff_t off, loff_t len, bufferlist *bl);
+  int ll_write(Fh *fh, loff_t off, loff_t len, const char *data);
+  loff_t ll_lseek(Fh *fh, loff_t offset, int whence);
+  int ll_flush(Fh *fh);
+  int ll_fsync(Fh *fh, bool syncdataonly);
 //  int ll_fallocate(Fh *fh, int mode, loff_t offset, loff_t length);
-//  int ll_release(Fh *fh);
+  int ll_release(Fh *fh);
 //  int ll_getlk(Fh *fh, struct flock *fl, uint64_t owner);
 //  int ll_setlk(Fh *fh, struct flock *fl, uint64_t owner, int sleep, void *fuse_req);
 //  int ll_flock(Fh *fh, int cmd, uint64_t owner, void *fuse_req);
@@ -17,6 +17,7 @@ struct Fh {
   int       mode;       // the mode i opened the file with
 
   int flags;
+  int hints;                 // CEPH_FADVISE_*
   bool pos_locked;           // pos is currently in use
   list<Cond*> pos_waiters;   // waiters for pos
 
@@ -26,7 +27,7 @@ struct Fh {
   ceph_lock_state_t *fcntl_locks;
   ceph_lock_state_t *flock_locks;
 
-  Fh() : inode(0), pos(0), mds(0), mode(0), flags(0), pos_locked(false),
+  Fh() : inode(0), pos(0), mds(0), mode(0), flags(0), hints(0), pos_locked(false),
       readahead(), fcntl_locks(NULL), flock_locks(NULL) {}
 };
 
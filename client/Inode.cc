@@ -51,6 +51,43 @@ ostream& operator<<(ostream &out, Inode &in)
   return out;
 }
 
+/*
+ * merge off~bl into the extents.  whatever it overlaps or touches is
+ * folded into one extent, with bl's data winning where they overlap
+ * (it is the later write).
+ */
+void WriteGather::add(uint64_t off, bufferlist& bl)
+{
+  uint64_t end = off + bl.length();
+  map<uint64_t, bufferlist>::iterator p = extents.lower_bound(off);
+  if (p != extents.begin()) {
+    map<uint64_t, bufferlist>::iterator q = p;
+    --q;
+    if (q->first + q->second.length() >= off)
+      p = q;
+  }
+
+  uint64_t start = off;
+  bufferlist head, tail;
+  while (p != extents.end() && p->first <= end) {
+    uint64_t pend = p->first + p->second.length();
+    if (p->first < off) {
+      head.substr_of(p->second, 0, off - p->first);
+      start = p->first;
+    }
+    if (pend > end)
+      tail.substr_of(p->second, end - p->first, pend - end);
+    bytes -= p->second.length();
+    extents.erase(p++);
+  }
+
+  bufferlist& merged = extents[start];
+  merged.claim_append(head);
+  merged.append(bl);
+  merged.claim_append(tail);
+  bytes += merged.length();
+}
+
 
 void Inode::make_long_path(filepath& p)
 {
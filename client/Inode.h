@@ -146,6 +146,19 @@ public:
 #define I_COMPLETE 1
 #define I_DIR_ORDERED 2
 
+// sync writes waiting to go out together, see Client::_sync_write
+struct WriteGather {
+  map<uint64_t, bufferlist> extents;  // merged: disjoint, never adjacent
+  list<Context*> waiters;             // completed once it all commits
+  unsigned writes;                    // writes merged in
+  uint64_t bytes;                     // sum of the extents
+  Context *timeout;                   // client_sync_write_gather_window, if armed
+
+  WriteGather() : writes(0), bytes(0), timeout(NULL) {}
+
+  void add(uint64_t off, bufferlist& bl);
+};
+
 struct Inode {
   CephContext *cct;
 
@@ -259,6 +272,9 @@ struct Inode {
   list<Cond*>       waitfor_caps;
   list<Cond*>       waitfor_commit;
 
+  int sync_writes_inflight;   // gathered sync write batches not yet committed
+  WriteGather *write_gather;  // next batch, if any
+
   Dentry *get_first_parent() {
     assert(!dn_set.empty());
     return *dn_set.begin();
@@ -313,6 +329,7 @@ struct Inode {
       oset((void *)this, newlayout->fl_pg_pool, ino),
       reported_size(0), wanted_max_size(0), requested_max_size(0),
       _ref(0), ll_ref(0), dir(0), dn_set(),
+      sync_writes_inflight(0), write_gather(NULL),
       fcntl_locks(NULL), flock_locks(NULL),
       async_err(0)
   {
@@ -11,6 +11,13 @@ PrebufferedStreambuf::PrebufferedStreambuf(char *buf, size_t len)
   this->setg(0, 0, 0);
 }
 
+void PrebufferedStreambuf::reset()
+{
+  std::string().swap(m_overflow);
+  this->setp(m_buf, m_buf + m_buf_len);
+  this->setg(0, 0, 0);
+}
+
 PrebufferedStreambuf::int_type PrebufferedStreambuf::overflow(int_type c)
 {
   int old_len = m_overflow.size();
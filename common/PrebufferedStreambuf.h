@@ -29,6 +29,9 @@ class PrebufferedStreambuf
 public:
   PrebufferedStreambuf(char *buf, size_t len);
 
+  /// empty the buffer for reuse, releasing any overflow
+  void reset();
+
   // called when the buffer fills up
   int_type overflow(int_type c);
 
@@ -11,9 +11,15 @@ Readahead::Readahead()
     m_readahead_max_bytes(NO_LIMIT),
     m_alignments(),
     m_lock("Readahead::m_lock"),
+    m_pattern(PATTERN_NONE),
     m_nr_consec_read(0),
     m_consec_read_bytes(0),
     m_last_pos(0),
+    m_last_offset(0),
+    m_last_length(0),
+    m_stride(0),
+    m_readahead_outstanding(0),
+    m_wasted_bytes(0),
     m_readahead_pos(0),
     m_readahead_trigger_pos(0),
     m_readahead_size(0),
@@ -26,40 +32,122 @@ Readahead::~Readahead() {
 }
 
 Readahead::extent_t Readahead::update(const vector<extent_t>& extents, uint64_t limit) {
+  vector<extent_t> readahead;
   m_lock.Lock();
   for (vector<extent_t>::const_iterator p = extents.begin(); p != extents.end(); ++p) {
     _observe_read(p->first, p->second);
   }
-  pair<uint64_t, uint64_t> extent = _compute_readahead(limit);
+  _compute_readahead(limit, &readahead);
   m_lock.Unlock();
-  return extent;
+  if (readahead.empty())
+    return extent_t(0, 0);
+  return readahead.front();
 }
 
 Readahead::extent_t Readahead::update(uint64_t offset, uint64_t length, uint64_t limit) {
+  vector<extent_t> readahead;
+  update(offset, length, limit, &readahead);
+  if (readahead.empty())
+    return extent_t(0, 0);
+  return readahead.front();
+}
+
+void Readahead::update(uint64_t offset, uint64_t length, uint64_t limit,
+		       vector<extent_t> *readahead) {
   m_lock.Lock();
   _observe_read(offset, length);
-  extent_t extent = _compute_readahead(limit);
+  _compute_readahead(limit, readahead);
+  m_lock.Unlock();
+}
+
+void Readahead::note_miss() {
+  m_pending_lock.Lock();
+  bool in_flight = m_pending > 0;
+  m_pending_lock.Unlock();
+
+  m_lock.Lock();
+  // a miss while readahead is still in flight just means we are early;
+  // a miss on data we already fetched means it was evicted before use.
+  if (!in_flight && m_readahead_outstanding > 0 && m_readahead_size > 0) {
+    m_readahead_size /= 2;
+    _clamp_readahead_size();
+  }
   m_lock.Unlock();
-  return extent;
+}
+
+uint64_t Readahead::take_wasted_bytes() {
+  m_lock.Lock();
+  uint64_t wasted = m_wasted_bytes;
+  m_wasted_bytes = 0;
+  m_lock.Unlock();
+  return wasted;
 }
 
 void Readahead::_observe_read(uint64_t offset, uint64_t length) {
+  int pattern = PATTERN_NONE;
+  uint64_t stride = offset > m_last_offset ? offset - m_last_offset : 0;
   if (offset == m_last_pos) {
+    pattern = PATTERN_SEQUENTIAL;
+  } else if (offset + length == m_last_offset) {
+    pattern = PATTERN_REVERSE;
+  } else if (stride && stride == m_stride && length == m_last_length) {
+    pattern = PATTERN_STRIDE;
+  }
+
+  if (pattern != PATTERN_NONE && pattern == m_pattern) {
     m_nr_consec_read++;
     m_consec_read_bytes += length;
+    m_readahead_outstanding -= MIN(m_readahead_outstanding, length);
   } else {
-    m_nr_consec_read = 0;
-    m_consec_read_bytes = 0;
+    m_wasted_bytes += m_readahead_outstanding;
+    m_readahead_outstanding = 0;
+    m_pattern = pattern;
+    if (pattern == PATTERN_NONE) {
+      m_nr_consec_read = 0;
+      m_consec_read_bytes = 0;
+    } else {
+      m_nr_consec_read = 1;
+      m_consec_read_bytes = length;
+    }
     m_readahead_trigger_pos = 0;
     m_readahead_size = 0;
   }
   m_last_pos = offset + length;
+  m_last_offset = offset;
+  m_last_length = length;
+  m_stride = stride;
+}
+
+void Readahead::_clamp_readahead_size() {
+  m_readahead_size = MAX(m_readahead_size, m_readahead_min_bytes);
+  m_readahead_size = MIN(m_readahead_size, m_readahead_max_bytes);
+}
+
+uint64_t Readahead::_align_readahead(uint64_t pos, uint64_t length, bool reverse) {
+  uint64_t far = reverse ? pos - length : pos + length;
+  for (vector<uint64_t>::iterator p = m_alignments.begin(); p != m_alignments.end(); ++p) {
+    // Align the readahead, if possible.
+    uint64_t alignment = *p;
+    uint64_t align_prev = far / alignment * alignment;
+    uint64_t align_next = align_prev + alignment;
+    uint64_t dist_prev = far - align_prev;
+    uint64_t dist_next = align_next - far;
+    if (dist_prev < length / 2 && dist_prev < dist_next) {
+      // snap to the previous alignment point: shorter going forward,
+      // longer going backward, by less than 50%
+      return reverse ? length + dist_prev : length - dist_prev;
+    } else if (dist_next < length / 2) {
+      // snap to the next alignment point
+      return reverse ? length - dist_next : length + dist_next;
+    }
+  }
+  return length;
 }
 
-Readahead::extent_t Readahead::_compute_readahead(uint64_t limit) {
+void Readahead::_compute_readahead(uint64_t limit, vector<extent_t> *readahead) {
   uint64_t readahead_offset = 0;
   uint64_t readahead_length = 0;
-  if (m_nr_consec_read >= m_trigger_requests) {
+  if (m_pattern == PATTERN_SEQUENTIAL && m_nr_consec_read >= m_trigger_requests) {
     // currently reading sequentially
     if (m_last_pos >= m_readahead_trigger_pos) {
       // need to read ahead
@@ -71,43 +159,76 @@ Readahead::extent_t Readahead::_compute_readahead(uint64_t limit) {
 	// continuing readahead trigger
 	m_readahead_size *= 2;
       }
-      m_readahead_size = MAX(m_readahead_size, m_readahead_min_bytes);
-      m_readahead_size = MIN(m_readahead_size, m_readahead_max_bytes);
+      _clamp_readahead_size();
       readahead_offset = m_readahead_pos;
       readahead_length = m_readahead_size;
 
-      // Snap to the first alignment possible
-      uint64_t readahead_end = readahead_offset + readahead_length;
-      for (vector<uint64_t>::iterator p = m_alignments.begin(); p != m_alignments.end(); ++p) {
-	// Align the readahead, if possible.
-	uint64_t alignment = *p;
-	uint64_t align_prev = readahead_end / alignment * alignment;
-	uint64_t align_next = align_prev + alignment;
-	uint64_t dist_prev = readahead_end - align_prev;
-	uint64_t dist_next = align_next - readahead_end;
-	if (dist_prev < readahead_length / 2 && dist_prev < dist_next) {
-	  // we can snap to the previous alignment point by a less than 50% reduction in size
-	  assert(align_prev > readahead_offset);
-	  readahead_length = align_prev - readahead_offset;
-	  break;
-	} else if(dist_next < readahead_length / 2) {
-	  // we can snap to the next alignment point by a less than 50% increase in size
-	  assert(align_next > readahead_offset);
-	  readahead_length = align_next - readahead_offset;
-	  break;
-	}
-	// Note that m_readahead_size should remain unadjusted.
-      }
+      // Snap to the first alignment possible.
+      // Note that m_readahead_size should remain unadjusted.
+      readahead_length = _align_readahead(readahead_offset, readahead_length, false);
 
       if (m_readahead_pos + readahead_length > limit) {
-	readahead_length = limit - m_readahead_pos;
+	readahead_length = m_readahead_pos < limit ? limit - m_readahead_pos : 0;
       }
 
       m_readahead_trigger_pos = m_readahead_pos + readahead_length / 2;
       m_readahead_pos += readahead_length;
     }
+  } else if (m_pattern == PATTERN_REVERSE &&
+	     m_nr_consec_read >= MAX(m_trigger_requests, 2)) {
+    // reading backwards; m_readahead_pos is the lowest offset fetched so far
+    if (m_readahead_size == 0 || m_last_offset <= m_readahead_trigger_pos) {
+      if (m_readahead_size == 0) {
+	m_readahead_size = m_consec_read_bytes;
+	m_readahead_pos = MIN(m_last_offset, limit);
+      } else {
+	m_readahead_size *= 2;
+      }
+      _clamp_readahead_size();
+      readahead_length = MIN(m_readahead_size, m_readahead_pos);
+      readahead_length = _align_readahead(m_readahead_pos, readahead_length, true);
+      readahead_offset = m_readahead_pos - readahead_length;
+
+      m_readahead_trigger_pos = readahead_offset + readahead_length / 2;
+      m_readahead_pos = readahead_offset;
+    }
+  } else if (m_pattern == PATTERN_STRIDE &&
+	     m_nr_consec_read >= MAX(m_trigger_requests, 2)) {
+    // fixed-size records at a fixed forward stride; fetch whole records only
+    if (m_readahead_size == 0 || m_last_offset >= m_readahead_trigger_pos) {
+      if (m_readahead_size == 0) {
+	m_readahead_size = m_consec_read_bytes;
+	m_readahead_pos = m_last_offset + m_stride;
+      } else {
+	m_readahead_size *= 2;
+      }
+      _clamp_readahead_size();
+      // m_readahead_size counts record bytes, but the span is records *
+      // stride; bound both, then snap the span to an alignment
+      uint64_t records = m_readahead_size / m_last_length;
+      records = MIN(records, m_readahead_max_bytes / m_stride);
+      records = MIN(records, MAX_STRIDE_RECORDS);
+      records = MAX(records, (uint64_t)1);
+      records = MAX(_align_readahead(m_last_offset + m_stride, records * m_stride, false) /
+		    m_stride, (uint64_t)1);
+      uint64_t end = m_last_offset + records * m_stride;
+      if (m_readahead_pos <= m_last_offset)
+	m_readahead_pos = m_last_offset + m_stride;  // the reader got ahead of us
+      while (m_readahead_pos <= end && m_readahead_pos < limit) {
+	uint64_t length = MIN(m_last_length, limit - m_readahead_pos);
+	readahead->push_back(extent_t(m_readahead_pos, length));
+	m_readahead_outstanding += length;
+	m_readahead_pos += m_stride;
+      }
+      m_readahead_trigger_pos = m_last_offset + (records / 2) * m_stride;
+    }
+    return;
+  }
+
+  if (readahead_length > 0) {
+    readahead->push_back(extent_t(readahead_offset, readahead_length));
+    m_readahead_outstanding += readahead_length;
   }
-  return extent_t(readahead_offset, readahead_length);
 }
 
 void Readahead::inc_pending(int count) {
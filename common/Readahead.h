@@ -10,6 +10,7 @@
 /**
    This class provides common state and logic for code that needs to perform readahead
    on linear things such as RBD images or files.
+   Sequential, reverse and fixed-stride (forward) access patterns are recognized.
    Unless otherwise specified, all methods are thread-safe.
 
    Minimum and maximum readahead sizes may be violated by up to 50\% if alignment is enabled.
@@ -55,6 +56,35 @@ public:
    */
   extent_t update(uint64_t offset, uint64_t length, uint64_t limit);
 
+  /**
+     Update state with a new read and append the readahead to be performed to
+     \c readahead.
+     Strided access produces one extent per record to be prefetched; the
+     single-extent variants above only return the first of those.
+     No extent passes \c limit.
+
+     @param offset offset of the read operation
+     @param length length of the read operation
+     @param limit size of the thing readahead is being applied to
+     @param readahead extents to read ahead, appended to
+   */
+  void update(uint64_t offset, uint64_t length, uint64_t limit,
+	      std::vector<extent_t> *readahead);
+
+  /**
+     Records that a read had to wait for the backing store.
+     If data we already read ahead has been dropped before use, the window is
+     too large for the cache behind it, and the next readahead is halved
+     (but kept at or above the minimum size).
+   */
+  void note_miss();
+
+  /**
+     Returns the number of read-ahead bytes discarded because the access
+     pattern changed before they were consumed, and resets the count.
+   */
+  uint64_t take_wasted_bytes();
+
   /**
      Increment the pending counter.
    */
@@ -95,6 +125,13 @@ public:
   void set_alignments(const std::vector<uint64_t> &alignments);
 
 private:
+  enum {
+    PATTERN_NONE,
+    PATTERN_SEQUENTIAL,
+    PATTERN_REVERSE,
+    PATTERN_STRIDE,
+  };
+
   /**
      Records that a read request has been received.
      m_lock must be held while calling.
@@ -102,10 +139,27 @@ private:
   void _observe_read(uint64_t offset, uint64_t length);
 
   /**
-     Computes the next readahead request.
+     Computes the next readahead requests.
      m_lock must be held while calling.
   */
-  extent_t _compute_readahead(uint64_t limit);
+  void _compute_readahead(uint64_t limit, std::vector<extent_t> *readahead);
+
+  /**
+     Clamps m_readahead_size to the configured minimum and maximum.
+     m_lock must be held while calling.
+  */
+  void _clamp_readahead_size();
+
+  /**
+     Returns length, adjusted so that the far end of a readahead of that
+     many bytes from pos (backwards from pos if reverse) lands on the first
+     of m_alignments reachable by changing it by less than half.
+     m_lock must be held while calling.
+  */
+  uint64_t _align_readahead(uint64_t pos, uint64_t length, bool reverse);
+
+  /// Most records a single stride readahead will fetch
+  static const uint64_t MAX_STRIDE_RECORDS = 64;
 
   /// Number of sequential requests necessary to trigger readahead
   int m_trigger_requests;
@@ -122,19 +176,36 @@ private:
   /// Held while reading/modifying any state except m_pending
   Mutex m_lock;
 
-  /// Number of consecutive read requests in the current sequential stream
+  /// Access pattern of the current stream
+  int m_pattern;
+
+  /// Number of consecutive read requests in the current stream
   int m_nr_consec_read;
 
-  /// Number of bytes read in the current sequenial stream
+  /// Number of bytes read in the current stream
   uint64_t m_consec_read_bytes;
 
   /// Position of the read stream
   uint64_t m_last_pos;
 
+  /// Offset and length of the last read request
+  uint64_t m_last_offset;
+  uint64_t m_last_length;
+
+  /// Distance between the starts of the last two read requests, or 0 if not moving forward
+  uint64_t m_stride;
+
+  /// Read-ahead bytes not yet consumed by the read stream
+  uint64_t m_readahead_outstanding;
+
+  /// Read-ahead bytes discarded since the last take_wasted_bytes()
+  uint64_t m_wasted_bytes;
+
   /// Position of the readahead stream
   uint64_t m_readahead_pos;
 
   /// When readahead is already triggered and the read stream crosses this point, readahead is continued
+  /// (for reverse streams, crossing means moving below it)
   uint64_t m_readahead_trigger_pos;
 
   /// Size of the next readahead request (barring changes due to alignment, etc.)
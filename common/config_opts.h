@@ -132,6 +132,8 @@ OPTION(ms_type, OPT_STR, "simple")   // messenger backend
 OPTION(ms_tcp_nodelay, OPT_BOOL, true)
 OPTION(ms_tcp_rcvbuf, OPT_INT, 0)
 OPTION(ms_tcp_prefetch_max_size, OPT_INT, 4096) // max prefetch size, we limit this to avoid extra memcpy
+OPTION(ms_writer_batch_max_messages, OPT_INT, 32)   // max queued messages Pipe::writer coalesces into one gathered write
+OPTION(ms_writer_batch_max_bytes, OPT_U64, 256 << 10) // stop adding messages to a write batch past this many bytes
 OPTION(ms_initial_backoff, OPT_DOUBLE, .2)
 OPTION(ms_max_backoff, OPT_DOUBLE, 15.0)
 OPTION(ms_crc_data, OPT_BOOL, true)
@@ -296,6 +298,7 @@ OPTION(mon_pool_quota_warn_threshold, OPT_INT, 0) // percent of quota at which t
 OPTION(mon_pool_quota_crit_threshold, OPT_INT, 0) // percent of quota at which to issue errors
 OPTION(client_cache_size, OPT_INT, 16384)
 OPTION(client_cache_mid, OPT_FLOAT, .75)
+OPTION(client_cache_policy, OPT_STR, "lru") // dentry replacement: lru (midpoint insertion) or 2q (scan resistant), see include/lru.h
 OPTION(client_use_random_mds, OPT_BOOL, false)
 OPTION(client_mount_timeout, OPT_DOUBLE, 300.0)
 OPTION(client_tick_interval, OPT_DOUBLE, 1.0)
@@ -316,6 +319,9 @@ OPTION(client_oc_target_dirty, OPT_INT, 1024*1024* 8) // target dirty (keep this
 OPTION(client_oc_max_dirty_age, OPT_DOUBLE, 5.0)      // max age in cache before writeback
 OPTION(client_oc_max_objects, OPT_INT, 1000)      // max objects in cache
 OPTION(client_debug_force_sync_read, OPT_BOOL, false)     // always read synchronously (go to osds)
+OPTION(client_read_sync_window, OPT_INT, 8)     // stripe unit reads kept in flight by a sync read (<= 1 disables)
+OPTION(client_sync_write_gather_window, OPT_DOUBLE, .002) // how long a sync write may wait behind another to be merged with it
+OPTION(client_sync_write_gather_max, OPT_U64, 4*1024*1024) // send a gathered batch once it holds this many bytes (0 disables gathering)
 OPTION(client_debug_inject_tick_delay, OPT_INT, 0) // delay the client tick for a number of seconds
 OPTION(client_max_inline_size, OPT_U64, 4096)
 OPTION(client_inject_release_failure, OPT_BOOL, false)  // synthetic client bug for testing
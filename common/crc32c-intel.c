@@ -6,9 +6,14 @@
 #include <sys/types.h>
 //#include <sys/wait.h>
 
+#include "common/crc32c_intel.h"
+#include "common/sctp_crc32.h"
 
-/* this probably isn't specific enough for x86_64?  fix me someday */
-#ifdef __LP64__
+/*
+ * x86_64 only: the kernels below feed the crc32 instruction 8 bytes at a
+ * time.  Note that Win64 is LLP64, so we cannot key this off __LP64__.
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
 
 /*
  *  * Based on a posting to lkml by Austin Zhang <austin.zhang@intel.com>
@@ -22,87 +27,190 @@
  *          * Volume 2A: Instruction Set Reference, A-M
  *           */
 
-#if BITS_PER_LONG == 64
-#define REX_PRE "0x48, "
-#define SCALE_F 8
-#else
-#define REX_PRE
-#define SCALE_F 4
-#endif
+#include <cpuid.h>
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+
+#define CRC32C_POLY 0x82f63b78
 
-static uint32_t crc32c_intel_le_hw_byte(uint32_t crc, unsigned char const *data,
-                                        unsigned length)
+/*
+ * The interleaved kernels checksum three adjacent blocks independently, so
+ * the three crc32 dependency chains overlap in the pipeline, and then stitch
+ * the results together: crc(A|B) = crc(A) * x^(8*len(B)) + crc(B).
+ */
+#define CRC32C_LONG  8192
+#define CRC32C_SHORT 256
+
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TARGET_PCLMUL __attribute__((target("sse4.2,pclmul")))
+
+/* a * b mod P, bit-reflected */
+static uint32_t crc32c_multmodp(uint32_t a, uint32_t b)
 {
-        while (length--) {
-                __asm__ __volatile__(
-                        ".byte 0xf2, 0xf, 0x38, 0xf0, 0xf1"
-                        :"=S"(crc)
-                        :"0"(crc), "c"(*data)
-                );
-                data++;
-        }
+	uint32_t m = 1u << 31;
+	uint32_t p = 0;
+
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+	}
+	return p;
+}
 
-        return crc;
+/* x^n mod P, bit-reflected */
+static uint32_t crc32c_xpow(unsigned n)
+{
+	uint32_t p = 1u << 31;		/* x^0 */
+	uint32_t sq = 1u << 30;		/* x^1, squared as we go */
+
+	while (n) {
+		if (n & 1)
+			p = crc32c_multmodp(sq, p);
+		sq = crc32c_multmodp(sq, sq);
+		n >>= 1;
+	}
+	return p;
 }
 
-uint32_t ceph_crc32c_le_intel(uint32_t crc, unsigned char const *data, unsigned length)
+/*
+ * shift constants: x^(8n) mod P for the software combine, and
+ * x^(8n - 33) mod P for the pclmul one (the carry-less product is one bit
+ * short, and crc32 of a 64-bit word multiplies by x^32).
+ */
+static uint32_t crc32c_long_shift, crc32c_short_shift;
+static uint32_t crc32c_long_clmul, crc32c_short_clmul;
+
+static void crc32c_init_shifts(void)
 {
-        unsigned int iquotient = length / SCALE_F;
-        unsigned int iremainder = length % SCALE_F;
-#if BITS_PER_LONG == 64
-        uint64_t *ptmp = (uint64_t *) data;
-#else
-        uint32_t *ptmp = (uint32_t *) data;
-#endif
+	crc32c_long_shift = crc32c_xpow(8 * CRC32C_LONG);
+	crc32c_short_shift = crc32c_xpow(8 * CRC32C_SHORT);
+	crc32c_long_clmul = crc32c_xpow(8 * CRC32C_LONG - 33);
+	crc32c_short_clmul = crc32c_xpow(8 * CRC32C_SHORT - 33);
+}
 
-        while (iquotient--) {
-                __asm__ __volatile__(
-                        ".byte 0xf2, " REX_PRE "0xf, 0x38, 0xf1, 0xf1;"
-                        :"=S"(crc)
-                        :"0"(crc), "c"(*ptmp)
-                );
-                ptmp++;
-        }
+static uint32_t crc32c_shift_sw(uint32_t crc, uint32_t k)
+{
+	return crc32c_multmodp(k, crc);
+}
 
-        if (iremainder)
-                crc = crc32c_intel_le_hw_byte(crc, (unsigned char *)ptmp,
-                                 iremainder);
+TARGET_PCLMUL
+static uint32_t crc32c_shift_clmul(uint32_t crc, uint32_t k)
+{
+	__m128i prod = _mm_clmulepi64_si128(_mm_cvtsi32_si128(crc),
+					    _mm_cvtsi32_si128(k), 0);
+	return _mm_crc32_u64(0, _mm_cvtsi128_si64(prod));
+}
 
-        return crc;
+TARGET_SSE42
+static uint32_t crc32c_tail(uint32_t crc, unsigned char const *data,
+			    unsigned length)
+{
+	uint64_t crc64 = crc;
+	while (length >= 8) {
+		uint64_t v;
+		memcpy(&v, data, 8);
+		crc64 = _mm_crc32_u64(crc64, v);
+		data += 8;
+		length -= 8;
+	}
+	crc = crc64;
+	while (length--)
+		crc = _mm_crc32_u8(crc, *data++);
+	return crc;
 }
 
+/*
+ * run the 3-way kernel over as many 3*block chunks as fit; the block
+ * sizes are multiples of 8 and the loads are unaligned-safe.
+ */
+#define CRC32C_3WAY(block, shift_fn, k)					\
+	while (length >= 3 * (block)) {					\
+		const unsigned char *p1 = data + (block);		\
+		const unsigned char *p2 = data + 2 * (block);		\
+		uint64_t c0 = crc, c1 = 0, c2 = 0;			\
+		unsigned i;						\
+		for (i = 0; i < (block); i += 8) {			\
+			uint64_t v0, v1, v2;				\
+			memcpy(&v0, data + i, 8);			\
+			memcpy(&v1, p1 + i, 8);				\
+			memcpy(&v2, p2 + i, 8);				\
+			c0 = _mm_crc32_u64(c0, v0);			\
+			c1 = _mm_crc32_u64(c1, v1);			\
+			c2 = _mm_crc32_u64(c2, v2);			\
+		}							\
+		crc = shift_fn((uint32_t)c0, k) ^ (uint32_t)c1;	\
+		crc = shift_fn(crc, k) ^ (uint32_t)c2;			\
+		data += 3 * (block);					\
+		length -= 3 * (block);					\
+	}
+
+TARGET_SSE42
+uint32_t ceph_crc32c_intel_baseline(uint32_t crc, unsigned char const *data, unsigned length)
+{
+	if (!data)
+		return ceph_crc32c_sctp(crc, data, length);
+	return crc32c_tail(crc, data, length);
+}
 
-static void do_cpuid(unsigned int *eax, unsigned int *ebx, unsigned int *ecx,
-                     unsigned int *edx)
+TARGET_SSE42
+uint32_t ceph_crc32c_intel_fast(uint32_t crc, unsigned char const *data, unsigned length)
 {
-        int id = *eax;
+	if (!data)
+		return ceph_crc32c_sctp(crc, data, length);
+	CRC32C_3WAY(CRC32C_LONG, crc32c_shift_sw, crc32c_long_shift);
+	CRC32C_3WAY(CRC32C_SHORT, crc32c_shift_sw, crc32c_short_shift);
+	return crc32c_tail(crc, data, length);
+}
 
-        asm("movl %4, %%eax;"
-            "cpuid;"
-            "movl %%eax, %0;"
-            "movl %%ebx, %1;"
-            "movl %%ecx, %2;"
-            "movl %%edx, %3;"
-                : "=r" (*eax), "=r" (*ebx), "=r" (*ecx), "=r" (*edx)
-                : "r" (id)
-                : "eax", "ebx", "ecx", "edx");
+TARGET_PCLMUL
+uint32_t ceph_crc32c_intel_fast_pclmul(uint32_t crc, unsigned char const *data, unsigned length)
+{
+	if (!data)
+		return ceph_crc32c_sctp(crc, data, length);
+	CRC32C_3WAY(CRC32C_LONG, crc32c_shift_clmul, crc32c_long_clmul);
+	CRC32C_3WAY(CRC32C_SHORT, crc32c_shift_clmul, crc32c_short_clmul);
+	return crc32c_tail(crc, data, length);
 }
 
 int ceph_have_crc32c_intel(void)
 {
-	/* i know how to check this on x86_64... */
-	unsigned int eax = 1, ebx, ecx, edx;
-	do_cpuid(&eax, &ebx, &ecx, &edx);
-	if ((ecx & (1 << 20)) != 0)
-		return 1;
-	return 0;
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+	if ((ecx & bit_SSE4_2) == 0)
+		return 0;
+	crc32c_init_shifts();
+	return 1;
+}
+
+int ceph_have_pclmul_intel(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+	return (ecx & bit_PCLMUL) != 0;
+}
+
+#else /* __x86_64__ */
+
+uint32_t ceph_crc32c_intel_baseline(uint32_t crc, unsigned char const *data, unsigned length)
+{
+	return ceph_crc32c_sctp(crc, data, length);  /* this shouldn't get called! */
 }
 
-#else /* __LP64__ */
+uint32_t ceph_crc32c_intel_fast(uint32_t crc, unsigned char const *data, unsigned length)
+{
+	return ceph_crc32c_sctp(crc, data, length);
+}
 
-uint32_t ceph_crc32c_le_intel(uint32_t crc, unsigned char const *data, unsigned length)
+uint32_t ceph_crc32c_intel_fast_pclmul(uint32_t crc, unsigned char const *data, unsigned length)
 {
-	return 0;  /* this shouldn't get called! */
+	return ceph_crc32c_sctp(crc, data, length);
 }
 
 int ceph_have_crc32c_intel(void)
@@ -110,4 +218,9 @@ int ceph_have_crc32c_intel(void)
 	return 0;  	/* clearly not x86_64 */
 }
 
+int ceph_have_pclmul_intel(void)
+{
+	return 0;
+}
+
 #endif
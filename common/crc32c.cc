@@ -6,23 +6,19 @@
 //by ketor #include "arch/probe.h"
 //#include "arch/intel.h"
 #include "common/sctp_crc32.h"
-//by ketor #include "common/crc32c_intel_baseline.h"
-//#include "common/crc32c_intel_fast.h"
+#include "common/crc32c_intel.h"
 
 /*
  * choose best implementation based on the CPU architecture.
  */
 ceph_crc32c_func_t ceph_choose_crc32(void)
 {
-  // make sure we've probed cpu features; this might depend on the
-  // link order of this file relative to arch/probe.cc.
-//by ketor   ceph_arch_probe();
-
-  // if the CPU supports it, *and* the fast version is compiled in,
-  // use that.
-//by ketor   if (ceph_arch_intel_sse42 && ceph_crc32c_intel_fast_exists()) {
-//    return ceph_crc32c_intel_fast;
-//  }
+  // probe the cpu directly; arch/probe.cc is not part of this build.
+  if (ceph_have_crc32c_intel()) {
+    if (ceph_have_pclmul_intel())
+      return ceph_crc32c_intel_fast_pclmul;
+    return ceph_crc32c_intel_fast;
+  }
 
   // default
   return ceph_crc32c_sctp;
@@ -38,4 +34,3 @@ ceph_crc32c_func_t ceph_choose_crc32(void)
  * We initialize it during program init using the magic of C++.
  */
 ceph_crc32c_func_t ceph_crc32c_func = ceph_choose_crc32();
-
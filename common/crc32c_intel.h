@@ -0,0 +1,27 @@
+#ifndef CEPH_COMMON_CRC32C_INTEL_H
+#define CEPH_COMMON_CRC32C_INTEL_H
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* cpu probes; ceph_have_crc32c_intel() must be called before the kernels */
+extern int ceph_have_crc32c_intel(void);
+extern int ceph_have_pclmul_intel(void);
+
+/* sse4.2 crc32, one 8-byte word at a time */
+extern uint32_t ceph_crc32c_intel_baseline(uint32_t crc, unsigned char const *data, unsigned length);
+
+/* sse4.2 crc32, three interleaved streams combined in software */
+extern uint32_t ceph_crc32c_intel_fast(uint32_t crc, unsigned char const *data, unsigned length);
+
+/* as above, combining the streams with pclmulqdq */
+extern uint32_t ceph_crc32c_intel_fast_pclmul(uint32_t crc, unsigned char const *data, unsigned length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "include/crc32c.h"
+#include "common/sctp_crc32.h"
+#include "common/crc32c_intel.h"
+
+/*
+ * crc32c micro-benchmark: throughput of every implementation for a
+ * range of buffer sizes.  test-internals.exe checks them against the
+ * sctp tables.
+ *
+ *   crc32c-bench.exe [total_mb]
+ */
+
+struct crc_impl {
+  const char *name;
+  ceph_crc32c_func_t func;
+  int usable;
+};
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned total_mb = argc > 1 ? atoi(argv[1]) : 256;
+  int have_sse42 = ceph_have_crc32c_intel();
+  int have_pclmul = have_sse42 && ceph_have_pclmul_intel();
+
+  crc_impl impls[] = {
+    { "sctp", ceph_crc32c_sctp, 1 },
+    { "intel_baseline", ceph_crc32c_intel_baseline, have_sse42 },
+    { "intel_fast", ceph_crc32c_intel_fast, have_sse42 },
+    { "intel_fast_pclmul", ceph_crc32c_intel_fast_pclmul, have_pclmul },
+  };
+  const int nimpls = sizeof(impls) / sizeof(impls[0]);
+  const unsigned sizes[] = { 64, 512, 4096, 65536, 1 << 20, 4 << 20 };
+  const int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  printf("sse4.2 %s, pclmul %s, selected %s\n",
+	 have_sse42 ? "yes" : "no", have_pclmul ? "yes" : "no",
+	 ceph_crc32c_func == ceph_crc32c_intel_fast_pclmul ? "intel_fast_pclmul" :
+	 ceph_crc32c_func == ceph_crc32c_intel_fast ? "intel_fast" : "sctp");
+
+  unsigned maxlen = sizes[nsizes - 1];
+  unsigned char *buf = (unsigned char *)malloc(maxlen);
+  srand(0);
+  for (unsigned i = 0; i < maxlen; i++)
+    buf[i] = rand();
+
+  printf("%-18s", "size");
+  for (int j = 0; j < nimpls; j++)
+    printf(" %18s", impls[j].name);
+  printf("   (MB/s)\n");
+
+  for (int s = 0; s < nsizes; s++) {
+    unsigned len = sizes[s];
+    unsigned iters = ((uint64_t)total_mb << 20) / len;
+    printf("%-18u", len);
+    for (int j = 0; j < nimpls; j++) {
+      if (!impls[j].usable) {
+	printf(" %18s", "-");
+	continue;
+      }
+      double start = now();
+      for (unsigned i = 0; i < iters; i++)
+	impls[j].func(0, buf, len);
+      double elapsed = now() - start;
+      printf(" %18.1f", elapsed > 0 ? ((double)iters * len / (1 << 20)) / elapsed : 0.0);
+    }
+    printf("\n");
+  }
+
+  free(buf);
+  return 0;
+}
@@ -0,0 +1,147 @@
+#include "include/int_types.h"
+
+#include "hash.h"
+
+/*
+ * SSE2 and AVX2 kernels for the straw2 hash batch.  rjenkins1 is nothing
+ * but 32-bit subtracts, xors and shifts, so 4 (or 8) items hash in the
+ * time of one.  The lanes compute exactly what crush_hash32_rjenkins1_3
+ * does; the tail that doesn't fill a vector goes through the scalar code.
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
+
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+#define crush_hash_seed 1315423911
+
+/* crush_hashmix, one lane per item; needs SUB, XOR, SHL, SHR */
+#define VEC_HASHMIX(a, b, c) do {						\
+		a = SUB(a, b);  a = SUB(a, c);  a = XOR(a, SHR(c, 13));	\
+		b = SUB(b, c);  b = SUB(b, a);  b = XOR(b, SHL(a, 8));	\
+		c = SUB(c, a);  c = SUB(c, b);  c = XOR(c, SHR(b, 13));	\
+		a = SUB(a, b);  a = SUB(a, c);  a = XOR(a, SHR(c, 12));	\
+		b = SUB(b, c);  b = SUB(b, a);  b = XOR(b, SHL(a, 16));	\
+		c = SUB(c, a);  c = SUB(c, b);  c = XOR(c, SHR(b, 5));	\
+		a = SUB(a, b);  a = SUB(a, c);  a = XOR(a, SHR(c, 3));	\
+		b = SUB(b, c);  b = SUB(b, a);  b = XOR(b, SHL(a, 10));	\
+		c = SUB(c, a);  c = SUB(c, b);  c = XOR(c, SHR(b, 15));	\
+	} while (0)
+
+/* crush_hash32_rjenkins1_3 over one vector of b's */
+#define VEC_HASH32_3(vtype, SET1, va0, vb0, vc0, hash) do {			\
+		vtype a = va0, b = vb0, c = vc0;				\
+		vtype x = SET1(231232);						\
+		vtype y = SET1(1232);						\
+		hash = XOR(XOR(SET1(crush_hash_seed), a), XOR(b, c));		\
+		VEC_HASHMIX(a, b, hash);					\
+		VEC_HASHMIX(c, x, hash);					\
+		VEC_HASHMIX(y, a, hash);					\
+		VEC_HASHMIX(b, x, hash);					\
+		VEC_HASHMIX(y, c, hash);					\
+	} while (0)
+
+#define SUB _mm_sub_epi32
+#define XOR _mm_xor_si128
+#define SHL _mm_slli_epi32
+#define SHR _mm_srli_epi32
+
+TARGET_SSE2
+void crush_hash32_rjenkins1_3_batch_sse2(__u32 a, const __s32 *b, __u32 c,
+					 __u32 *out, unsigned n)
+{
+	__m128i va = _mm_set1_epi32(a);
+	__m128i vc = _mm_set1_epi32(c);
+	unsigned i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		__m128i hash;
+		VEC_HASH32_3(__m128i, _mm_set1_epi32, va, vb, vc, hash);
+		_mm_storeu_si128((__m128i *)(out + i), hash);
+	}
+	crush_hash32_rjenkins1_3_batch(a, b + i, c, out + i, n - i);
+}
+
+#undef SUB
+#undef XOR
+#undef SHL
+#undef SHR
+#define SUB _mm256_sub_epi32
+#define XOR _mm256_xor_si256
+#define SHL _mm256_slli_epi32
+#define SHR _mm256_srli_epi32
+
+TARGET_AVX2
+void crush_hash32_rjenkins1_3_batch_avx2(__u32 a, const __s32 *b, __u32 c,
+					 __u32 *out, unsigned n)
+{
+	__m256i va = _mm256_set1_epi32(a);
+	__m256i vc = _mm256_set1_epi32(c);
+	unsigned i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i hash;
+		VEC_HASH32_3(__m256i, _mm256_set1_epi32, va, vb, vc, hash);
+		_mm256_storeu_si256((__m256i *)(out + i), hash);
+	}
+	crush_hash32_rjenkins1_3_batch_sse2(a, b + i, c, out + i, n - i);
+}
+
+int crush_have_sse2(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+	return (edx & bit_SSE2) != 0;
+}
+
+int crush_have_avx2(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int xcr0_lo, xcr0_hi;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+	/* the OS must save the ymm state */
+	if ((ecx & bit_OSXSAVE) == 0)
+		return 0;
+	__asm__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+	if ((xcr0_lo & 6) != 6)
+		return 0;
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & bit_AVX2) != 0;
+}
+
+#else /* __x86_64__ */
+
+void crush_hash32_rjenkins1_3_batch_sse2(__u32 a, const __s32 *b, __u32 c,
+					 __u32 *out, unsigned n)
+{
+	crush_hash32_rjenkins1_3_batch(a, b, c, out, n);
+}
+
+void crush_hash32_rjenkins1_3_batch_avx2(__u32 a, const __s32 *b, __u32 c,
+					 __u32 *out, unsigned n)
+{
+	crush_hash32_rjenkins1_3_batch(a, b, c, out, n);
+}
+
+int crush_have_sse2(void)
+{
+	return 0;
+}
+
+int crush_have_avx2(void)
+{
+	return 0;
+}
+
+#endif
@@ -6,6 +6,8 @@
 #include <sys/types.h>
 #endif
 
+#include <string.h>
+
 #include "hash.h"
 
 /*
@@ -144,6 +146,47 @@ __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d, __u32 e)
 	}
 }
 
+void crush_hash32_rjenkins1_3_batch(__u32 a, const __s32 *b, __u32 c,
+				    __u32 *out, unsigned n)
+{
+	unsigned i;
+
+	for (i = 0; i < n; i++)
+		out[i] = crush_hash32_rjenkins1_3(a, b[i], c);
+}
+
+crush_hash32_3_batch_func_t crush_choose_hash32_3_batch(void)
+{
+	if (crush_have_avx2())
+		return crush_hash32_rjenkins1_3_batch_avx2;
+	if (crush_have_sse2())
+		return crush_hash32_rjenkins1_3_batch_sse2;
+	return crush_hash32_rjenkins1_3_batch;
+}
+
+/* picks the kernel on the first call; racing callers pick the same one */
+static void crush_hash32_3_batch_resolve(__u32 a, const __s32 *b, __u32 c,
+					 __u32 *out, unsigned n)
+{
+	crush_hash32_3_batch_func = crush_choose_hash32_3_batch();
+	crush_hash32_3_batch_func(a, b, c, out, n);
+}
+
+crush_hash32_3_batch_func_t crush_hash32_3_batch_func =
+	crush_hash32_3_batch_resolve;
+
+void crush_hash32_3_batch(int type, __u32 a, const __s32 *b, __u32 c,
+			  __u32 *out, unsigned n)
+{
+	switch (type) {
+	case CRUSH_HASH_RJENKINS1:
+		crush_hash32_3_batch_func(a, b, c, out, n);
+		break;
+	default:
+		memset(out, 0, n * sizeof(*out));
+	}
+}
+
 const char *crush_hash_name(int type)
 {
 	switch (type) {
@@ -14,4 +14,29 @@ extern __u32 crush_hash32_4(int type, __u32 a, __u32 b, __u32 c, __u32 d);
 extern __u32 crush_hash32_5(int type, __u32 a, __u32 b, __u32 c, __u32 d,
 			    __u32 e);
 
+/*
+ * batched crush_hash32_3 for straw2: out[i] = crush_hash32_3(type, a,
+ * b[i], c) for i < n.  the rjenkins1 kernel is chosen at first use from
+ * the implementations below; all of them give bit-identical results.
+ */
+typedef void (*crush_hash32_3_batch_func_t)(__u32 a, const __s32 *b, __u32 c,
+					    __u32 *out, unsigned n);
+
+extern crush_hash32_3_batch_func_t crush_hash32_3_batch_func;
+extern crush_hash32_3_batch_func_t crush_choose_hash32_3_batch(void);
+
+extern void crush_hash32_3_batch(int type, __u32 a, const __s32 *b, __u32 c,
+				 __u32 *out, unsigned n);
+
+extern void crush_hash32_rjenkins1_3_batch(__u32 a, const __s32 *b, __u32 c,
+					   __u32 *out, unsigned n);
+extern void crush_hash32_rjenkins1_3_batch_sse2(__u32 a, const __s32 *b, __u32 c,
+						__u32 *out, unsigned n);
+extern void crush_hash32_rjenkins1_3_batch_avx2(__u32 a, const __s32 *b, __u32 c,
+						__u32 *out, unsigned n);
+
+/* cpu probes, in crush/hash-intel.c */
+extern int crush_have_sse2(void);
+extern int crush_have_avx2(void);
+
 #endif
@@ -302,6 +302,9 @@ uint64_t crush_ln(unsigned xin)
  *
  */
 
+/* items hashed per crush_hash32_3_batch call */
+#define CRUSH_STRAW2_BATCH 64
+
 static int bucket_straw2_choose(struct crush_bucket_straw2 *bucket,
 				int x, int r)
 {
@@ -309,12 +312,21 @@ static int bucket_straw2_choose(struct crush_bucket_straw2 *bucket,
 	unsigned u;
 	unsigned w;
 	__s64 ln, draw, high_draw = 0;
+	__u32 hashes[CRUSH_STRAW2_BATCH];
 
 	for (i = 0; i < bucket->h.size; i++) {
+		/* hash the next run of items in one go (SIMD if we can) */
+		if (i % CRUSH_STRAW2_BATCH == 0) {
+			unsigned n = bucket->h.size - i;
+			if (n > CRUSH_STRAW2_BATCH)
+				n = CRUSH_STRAW2_BATCH;
+			crush_hash32_3_batch(bucket->h.hash, x,
+					     bucket->h.items + i, r,
+					     hashes, n);
+		}
 		w = bucket->item_weights[i];
 		if (w) {
-			u = crush_hash32_3(bucket->h.hash, x,
-					   bucket->h.items[i], r);
+			u = hashes[i % CRUSH_STRAW2_BATCH];
 			u &= 0xffff;
 
 			/*
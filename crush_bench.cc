@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <vector>
+#include "include/int_types.h"
+extern "C" {
+#include "crush/crush.h"
+#include "crush/hash.h"
+#include "crush/mapper.h"
+#include "crush/builder.h"
+}
+
+/*
+ * crush straw2 micro-benchmark: mapping throughput of crush_do_rule with
+ * each crush_hash32_3_batch kernel over a set of generated maps.
+ * test-internals.exe checks the kernels against the scalar hash.
+ *
+ *   crush-bench.exe [mappings]
+ */
+
+struct hash_impl {
+  const char *name;
+  crush_hash32_3_batch_func_t func;
+  int usable;
+};
+
+struct map_shape {
+  int hosts;
+  int osds_per_host;
+};
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* root (straw2) -> hosts (straw2) -> osds; some osds get zero weight */
+static struct crush_map *build_map(const map_shape& s, int *ndevices)
+{
+  struct crush_map *map = crush_create();
+  map->choose_local_tries = 0;
+  map->choose_local_fallback_tries = 0;
+  map->choose_total_tries = 50;
+  map->chooseleaf_descend_once = 1;
+  map->chooseleaf_vary_r = 1;
+
+  std::vector<int> hosts(s.hosts), host_weights(s.hosts);
+  int osd = 0;
+  for (int h = 0; h < s.hosts; h++) {
+    std::vector<int> items(s.osds_per_host), weights(s.osds_per_host);
+    int total = 0;
+    for (int i = 0; i < s.osds_per_host; i++) {
+      items[i] = osd++;
+      weights[i] = rand() % 8 == 0 ? 0 : 0x10000 + rand() % 0x30000;
+      total += weights[i];
+    }
+    struct crush_bucket *b = crush_make_bucket(map, CRUSH_BUCKET_STRAW2,
+					       CRUSH_HASH_DEFAULT, 1,
+					       s.osds_per_host, &items[0],
+					       &weights[0]);
+    crush_add_bucket(map, 0, b, &hosts[h]);
+    host_weights[h] = total;
+  }
+  struct crush_bucket *root = crush_make_bucket(map, CRUSH_BUCKET_STRAW2,
+						CRUSH_HASH_DEFAULT, 2,
+						s.hosts, &hosts[0],
+						&host_weights[0]);
+  int rootno;
+  crush_add_bucket(map, 0, root, &rootno);
+
+  struct crush_rule *rule = crush_make_rule(3, 0, 1, 1, 10);
+  crush_rule_set_step(rule, 0, CRUSH_RULE_TAKE, rootno, 0);
+  crush_rule_set_step(rule, 1, CRUSH_RULE_CHOOSELEAF_FIRSTN, 0, 1);
+  crush_rule_set_step(rule, 2, CRUSH_RULE_EMIT, 0, 0);
+  crush_add_rule(map, rule, 0);
+  crush_finalize(map);
+  *ndevices = osd;
+  return map;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned mappings = argc > 1 ? atoi(argv[1]) : 1000000;
+  int have_sse2 = crush_have_sse2();
+  int have_avx2 = crush_have_avx2();
+
+  hash_impl impls[] = {
+    { "scalar", crush_hash32_rjenkins1_3_batch, 1 },
+    { "sse2", crush_hash32_rjenkins1_3_batch_sse2, have_sse2 },
+    { "avx2", crush_hash32_rjenkins1_3_batch_avx2, have_avx2 },
+  };
+  const int nimpls = sizeof(impls) / sizeof(impls[0]);
+  crush_hash32_3_batch_func_t chosen = crush_choose_hash32_3_batch();
+
+  printf("sse2 %s, avx2 %s, selected %s\n",
+	 have_sse2 ? "yes" : "no", have_avx2 ? "yes" : "no",
+	 chosen == crush_hash32_rjenkins1_3_batch_avx2 ? "avx2" :
+	 chosen == crush_hash32_rjenkins1_3_batch_sse2 ? "sse2" : "scalar");
+
+  const map_shape shapes[] = {
+    { 4, 4 }, { 12, 12 }, { 10, 24 }, { 40, 24 }, { 3, 61 }, { 100, 8 },
+  };
+  const int nshapes = sizeof(shapes) / sizeof(shapes[0]);
+  const int result_max = 3;
+  int result[result_max];
+  int scratch[result_max * 3];
+
+  printf("%-18s", "hosts x osds");
+  for (int j = 0; j < nimpls; j++)
+    printf(" %18s", impls[j].name);
+  printf("   (mappings/s)\n");
+
+  for (int s = 0; s < nshapes; s++) {
+    int ndevices;
+    struct crush_map *map = build_map(shapes[s], &ndevices);
+    std::vector<__u32> weights(ndevices, 0x10000);
+
+    char label[32];
+    snprintf(label, sizeof(label), "%d x %d", shapes[s].hosts, shapes[s].osds_per_host);
+    printf("%-18s", label);
+    for (int j = 0; j < nimpls; j++) {
+      if (!impls[j].usable) {
+	printf(" %18s", "-");
+	continue;
+      }
+      crush_hash32_3_batch_func = impls[j].func;
+      double start = now();
+      for (unsigned x = 0; x < mappings; x++)
+	crush_do_rule(map, 0, x, result, result_max,
+		      &weights[0], ndevices, scratch);
+      double elapsed = now() - start;
+      printf(" %18.0f", elapsed > 0 ? mappings / elapsed : 0.0);
+    }
+    printf("\n");
+    crush_destroy(map);
+  }
+
+  crush_hash32_3_batch_func = chosen;
+  return 0;
+}
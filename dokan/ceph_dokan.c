@@ -22,6 +22,7 @@
 
 #define MAX_PATH_CEPH 8192
 #define CEPH_DOKAN_IO_TIMEOUT 1000 * 60 * 2
+#define CEPH_DOKAN_READDIR_BATCH 256
 
 BOOL WINAPI CCHandler(DWORD);
 
@@ -96,6 +97,240 @@ struct fd_context{
     short read_only;
 };
 
+/*
+ * Shared handles for I/O on contexts that carry no fd (fd_context.fd == 0),
+ * e.g. paging I/O for memory-mapped files or scanners that read through a
+ * handle opened without data access.  Handles are keyed by inode number
+ * and access mode, opened lazily, referenced for the duration of each I/O
+ * and closed by the sweeper thread once idle for CEPH_DOKAN_HANDLE_IDLE_MS.
+ * They are opened through the ll interface on the Inode the stat already
+ * brought into cache, so opening one does not walk the path a second time.
+ */
+#define CEPH_DOKAN_HANDLE_BUCKETS 256
+#define CEPH_DOKAN_HANDLE_IDLE_MS 5000
+
+struct shared_handle{
+    unsigned long long ino;
+    Inode *in;
+    Fh    *fh;
+    int   writable;
+    int   ref;
+    DWORD last_used;
+    struct shared_handle *next;
+};
+
+static struct shared_handle *g_Handles[CEPH_DOKAN_HANDLE_BUCKETS];
+static CRITICAL_SECTION g_HandlesLock;
+static BOOL g_HandlesClosed;    /*unmounting: no new handles*/
+
+static int stat_cache_stat(const char *path, struct stat *stbuf);
+
+static struct shared_handle *
+shared_handle_find(unsigned long long ino, int writable)
+{
+    struct shared_handle *h;
+    for(h = g_Handles[ino % CEPH_DOKAN_HANDLE_BUCKETS]; h; h = h->next){
+        if(h->ino == ino && h->writable >= writable){
+            h->ref++;
+            h->last_used = GetTickCount();
+            return h;
+        }
+    }
+    return NULL;
+}
+
+static int
+shared_handle_get(const char *file_name, int writable, struct shared_handle **out)
+{
+    struct stat st_buf;
+    int ret = stat_cache_stat(file_name, &st_buf);
+    if(ret)
+        return ret;
+
+    EnterCriticalSection(&g_HandlesLock);
+    *out = g_HandlesClosed ? NULL : shared_handle_find(st_buf.st_ino, writable);
+    LeaveCriticalSection(&g_HandlesLock);
+    if(*out)
+        return 0;
+
+    vinodeno_t vino;
+    vino.ino.val = st_buf.st_ino;
+    vino.snapid.val = CEPH_NOSNAP;
+    Inode *in = ceph_ll_get_inode(cmount, vino);
+    if(in == NULL)
+        return -ENOENT;     /*dropped from cache since the stat*/
+    Fh *fh;
+    ret = ceph_ll_open(cmount, in, writable ? O_RDWR : O_RDONLY, &fh, -1, -1);
+    if(ret < 0){
+        ceph_ll_put(cmount, in);
+        return ret;
+    }
+
+    EnterCriticalSection(&g_HandlesLock);
+    if(g_HandlesClosed){
+        LeaveCriticalSection(&g_HandlesLock);
+        ceph_ll_close(cmount, fh);
+        ceph_ll_put(cmount, in);
+        return -ENOTCONN;
+    }
+    *out = shared_handle_find(st_buf.st_ino, writable);
+    if(*out == NULL){
+        struct shared_handle *h = (struct shared_handle *)malloc(sizeof(struct shared_handle));
+        unsigned b = st_buf.st_ino % CEPH_DOKAN_HANDLE_BUCKETS;
+        h->ino = st_buf.st_ino;
+        h->in = in;
+        h->fh = fh;
+        h->writable = writable;
+        h->ref = 1;
+        h->last_used = GetTickCount();
+        h->next = g_Handles[b];
+        g_Handles[b] = h;
+        *out = h;
+        in = NULL;
+    }
+    LeaveCriticalSection(&g_HandlesLock);
+
+    /*somebody else opened it while we were at the MDS*/
+    if(in){
+        ceph_ll_close(cmount, fh);
+        ceph_ll_put(cmount, in);
+    }
+    return 0;
+}
+
+static void
+shared_handle_put(struct shared_handle *h)
+{
+    EnterCriticalSection(&g_HandlesLock);
+    h->ref--;
+    h->last_used = GetTickCount();
+    LeaveCriticalSection(&g_HandlesLock);
+}
+
+/*
+ * close unreferenced handles idle for longer than the timeout, or all of
+ * them; returns how many are left because an I/O still holds them
+ */
+static int
+shared_handle_sweep(BOOL all)
+{
+    struct shared_handle *idle = NULL;
+    DWORD now = GetTickCount();
+    int busy = 0;
+    int i;
+
+    EnterCriticalSection(&g_HandlesLock);
+    for(i = 0; i < CEPH_DOKAN_HANDLE_BUCKETS; i++){
+        struct shared_handle **pp = &g_Handles[i];
+        while(*pp){
+            struct shared_handle *h = *pp;
+            if(h->ref == 0 && (all || now - h->last_used >= CEPH_DOKAN_HANDLE_IDLE_MS)){
+                *pp = h->next;
+                h->next = idle;
+                idle = h;
+            }
+            else{
+                if(h->ref)
+                    busy++;
+                pp = &h->next;
+            }
+        }
+    }
+    LeaveCriticalSection(&g_HandlesLock);
+
+    while(idle){
+        struct shared_handle *h = idle;
+        idle = h->next;
+        ceph_ll_close(cmount, h->fh);
+        ceph_ll_put(cmount, h->in);
+        free(h);
+    }
+    return busy;
+}
+
+/*refuse new handles, then close every one as soon as its last I/O is done*/
+static void
+shared_handle_drain(void)
+{
+    EnterCriticalSection(&g_HandlesLock);
+    g_HandlesClosed = TRUE;
+    LeaveCriticalSection(&g_HandlesLock);
+    while(shared_handle_sweep(TRUE))
+        Sleep(10);
+}
+
+/*
+ * Attribute cache for GetFileInformation on contexts without an fd, which
+ * Explorer, Office and virus scanners issue in storms for the same paths.
+ * ceph_stat_cached_path() resolves the path from the client's dentry
+ * cache, trusting a dentry only under its MDS lease or the parent's
+ * FILE_SHARED cap, and reads the attributes while the caps covering them
+ * are held: no MDS round trip, and it already reflects local writes.  A
+ * rename or replace by another client revokes those leases and caps, so
+ * the next lookup misses and walks the path with ceph_stat instead of
+ * returning the old inode.  No path -> inode binding is kept here, so
+ * there is nothing to invalidate on unlink or rename.
+ */
+#define CEPH_DOKAN_STAT_REPORT_MS 60000
+
+static volatile LONG g_StatCapHits, g_StatMisses;
+
+static int
+stat_cache_stat(const char *path, struct stat *stbuf)
+{
+    int ret = ceph_stat_cached_path(cmount, path, stbuf);
+    if(ret == 0 || ret == -ENOENT){
+        InterlockedIncrement(&g_StatCapHits);
+        return ret;
+    }
+    InterlockedIncrement(&g_StatMisses);
+    return ceph_stat(cmount, path, stbuf);
+}
+
+static void
+stat_cache_report(void)
+{
+    LONG cap_hits = g_StatCapHits, misses = g_StatMisses;
+    LONG total = cap_hits + misses;
+
+    fwprintf(stderr, L"stat cache: %ld lookups, %ld cap hits, %ld misses (%.1f%% hit)\n",
+        total, cap_hits, misses,
+        total ? 100.0 * cap_hits / total : 0.0);
+}
+
+static HANDLE g_SweeperStop, g_Sweeper;
+
+static DWORD WINAPI
+cache_sweeper(LPVOID arg)
+{
+    DWORD last_report = GetTickCount();
+    while(WaitForSingleObject(g_SweeperStop, 1000) == WAIT_TIMEOUT){
+        shared_handle_sweep(FALSE);
+        if(g_DebugMode && GetTickCount() - last_report >= CEPH_DOKAN_STAT_REPORT_MS){
+            stat_cache_report();
+            last_report = GetTickCount();
+        }
+    }
+    return 0;
+}
+
+/*
+ * stop and join the sweeper, then close the shared handles; must run
+ * before ceph_unmount.  safe to call more than once.
+ */
+static void
+cache_shutdown(void)
+{
+    if(g_Sweeper){
+        SetEvent(g_SweeperStop);
+        WaitForSingleObject(g_Sweeper, INFINITE);
+        CloseHandle(g_Sweeper);
+        CloseHandle(g_SweeperStop);
+        g_Sweeper = NULL;
+    }
+    shared_handle_drain();
+}
+
 void UnixTimeToFileTime(time_t t, LPFILETIME pft)
 {
     // Note that LONGLONG is a 64-bit value
@@ -251,6 +486,33 @@ PrintUserName(PDOKAN_FILE_INFO    DokanFileInfo)
 #define WinCephCheckFlag(val, flag) if (val&flag) { DbgPrintW(L"\t" #flag L"\n"); }
 #define AlwaysCheckFlag(val, flag) if (val&flag) { AlwaysPrintW(L"\t" #flag L"\n"); }
 
+/*
+ * pass the open's caching hints on to libcephfs, so that backups stop
+ * flooding the cache and random-access files skip readahead.
+ */
+static void
+WinCephOpenHints(int fd, DWORD FlagsAndAttributes)
+{
+    int hints = 0;
+
+    if (FlagsAndAttributes & FILE_FLAG_SEQUENTIAL_SCAN)
+        hints |= CEPH_FADVISE_SEQUENTIAL;
+    if (FlagsAndAttributes & FILE_FLAG_RANDOM_ACCESS)
+        hints |= CEPH_FADVISE_RANDOM;
+    if (FlagsAndAttributes & FILE_FLAG_NO_BUFFERING)
+        hints |= CEPH_FADVISE_NOCACHE;
+    if (FlagsAndAttributes & FILE_FLAG_WRITE_THROUGH)
+        hints |= CEPH_FADVISE_WRITETHROUGH;
+    if (FlagsAndAttributes & FILE_ATTRIBUTE_TEMPORARY)
+        hints |= CEPH_FADVISE_TEMPORARY;
+
+    if (hints) {
+        int ret = ceph_fadvise(cmount, fd, hints);
+        if (ret)
+            DbgPrint("\tceph_fadvise(%d, 0x%x) error %d\n", fd, hints, ret);
+    }
+}
+
 static int
 WinCephCreateFile(
     LPCWSTR                  FileName,
@@ -408,6 +670,7 @@ WinCephCreateFile(
                         }
                         
                         fdc.fd = fd;
+                        WinCephOpenHints(fd, FlagsAndAttributes);
                         memcpy(&(DokanFileInfo->Context), &fdc, sizeof(fdc));
                         //fwprintf(stderr, L"CreateFile REG TRUNCATE_EXISTING ceph_open OK [%s][fd=%d][Context=%d]\n", FileName, fd,
                         //    (int)DokanFileInfo->Context);
@@ -455,6 +718,7 @@ WinCephCreateFile(
                         }
                         
                         fdc.fd = fd;
+                        WinCephOpenHints(fd, FlagsAndAttributes);
                         memcpy(&(DokanFileInfo->Context), &fdc, sizeof(fdc));
                         //fwprintf(stderr, L"CreateFile ceph_open REG OPEN_ALWAYS OK [%s][fd=%d][Context=%d]\n", FileName, fd,
                         //    (int)DokanFileInfo->Context);
@@ -503,6 +767,7 @@ WinCephCreateFile(
                             return fd;
                         }
                         fdc.fd = fd;
+                        WinCephOpenHints(fd, FlagsAndAttributes);
                         memcpy(&(DokanFileInfo->Context), &fdc, sizeof(fdc));
                         /*fwprintf(stderr, L"CreateFile ceph_open REG OPEN_EXISTING OK [%s][fd=%d][Context=%d]\n", FileName, fd,
                             (int)DokanFileInfo->Context);*/
@@ -526,6 +791,7 @@ WinCephCreateFile(
                         }
                         
                         fdc.fd = fd;
+                        WinCephOpenHints(fd, FlagsAndAttributes);
                         memcpy(&(DokanFileInfo->Context), &fdc, sizeof(fdc));
                         //fwprintf(stderr, L"CreateFile ceph_open REG CREATE_ALWAYS OK [%s][fd=%d][Context=%d]\n", FileName, fd,
                         //    (int)DokanFileInfo->Context);
@@ -573,6 +839,7 @@ WinCephCreateFile(
                     }
                     
                     fdc.fd = fd;
+                    WinCephOpenHints(fd, FlagsAndAttributes);
                     memcpy(&(DokanFileInfo->Context), &fdc, sizeof(fdc));
                     //fwprintf(stderr, L"CreateFile ceph_open NOF CREATE_NEW OK [%s][fd=%d][Context=%d]\n", FileName, fd,
                     //    (int)DokanFileInfo->Context);
@@ -598,6 +865,7 @@ WinCephCreateFile(
                     }
                     
                     fdc.fd = fd;
+                    WinCephOpenHints(fd, FlagsAndAttributes);
                     memcpy(&(DokanFileInfo->Context), &fdc, sizeof(fdc));
                     //fwprintf(stderr, L"CreateFile ceph_open NOF CREATE_ALWAYS_ALWAYS OK [%s][fd=%d][Context=%d]\n", FileName, fd,
                     //    (int)DokanFileInfo->Context);
@@ -622,6 +890,7 @@ WinCephCreateFile(
                     }
                     
                     fdc.fd = fd;
+                    WinCephOpenHints(fd, FlagsAndAttributes);
                     memcpy(&(DokanFileInfo->Context), &fdc, sizeof(fdc));
                     //fwprintf(stderr, L"CreateFile ceph_open REG NOF OPEN_ALWAYS OK [%s][fd=%d][Context=%d]\n", FileName, fd,
                     //    (int)DokanFileInfo->Context);
@@ -907,28 +1176,22 @@ WinCephReadFile(
     struct fd_context fdc;
     memcpy(&fdc, &(DokanFileInfo->Context), sizeof(fdc));
     if(fdc.fd == 0){
-        char file_name[MAX_PATH_CEPH];
-        int len = wchar_to_char(file_name, FileName, MAX_PATH_CEPH);
-        ToLinuxFilePath(file_name);
-        
-        fwprintf(stderr, L"ceph_read reopen fd [fn:%s][Offset=%ld]\n", FileName, Offset);
-        
-        int fd_new = ceph_open(cmount, file_name, O_RDONLY, 0);
-        if(fd_new < 0)
+        struct shared_handle *h;
+        int ret = shared_handle_get(file_name, 0, &h);
+        if(ret)
         {
-            fwprintf(stderr, L"ceph_read reopen fd [fn:%s][fd_new=%d][Offset=%ld]\n", FileName, fd_new, Offset);
+            fwprintf(stderr, L"ceph_read shared fd [fn:%s][ret=%d][Offset=%ld]\n", FileName, ret, Offset);
             return -1;
         }
         
-        int ret = ceph_read(cmount, fd_new, Buffer, BufferLength, Offset);
+        ret = ceph_ll_read(cmount, h->fh, Offset, BufferLength, Buffer);
+        shared_handle_put(h);
         if(ret<0)
         {
             fwprintf(stderr, L"ceph_read IO error [Offset=%ld][ret=%d]\n", Offset, ret);
-            ceph_close(cmount, fd_new);
             return ret;
         }
         *ReadLength = ret;
-        ceph_close(cmount, fd_new);
         return 0;
     }
     else{
@@ -982,29 +1245,22 @@ WinCephWriteFile(
         return -ERROR_ACCESS_DENIED;
     
     if(fdc.fd==0){
-        char file_name[MAX_PATH_CEPH];
-        int len = wchar_to_char(file_name, FileName, MAX_PATH_CEPH);
-        ToLinuxFilePath(file_name);
-        
-        fwprintf(stderr, L"ceph_write reopen fd [fn:%s][Offset=%ld]\n",FileName, Offset);
-        
-        int fd_new = ceph_open(cmount, file_name, O_RDONLY, 0);
-        if(fd_new < 0)
+        struct shared_handle *h;
+        int ret = shared_handle_get(file_name, 1, &h);
+        if(ret)
         {
-            fwprintf(stderr, L"ceph_write reopen fd [fn:%s][fd_new=%d][Offset=%ld]\n", FileName, fd_new, Offset);
+            fwprintf(stderr, L"ceph_write shared fd [fn:%s][ret=%d][Offset=%ld]\n", FileName, ret, Offset);
             return -1;
         }
 
-        int ret = ceph_write(cmount, fd_new, Buffer, NumberOfBytesToWrite, Offset);
+        ret = ceph_ll_write(cmount, h->fh, Offset, NumberOfBytesToWrite, Buffer);
+        shared_handle_put(h);
         if(ret<0)
         {
-            fwprintf(stderr, L"ceph_write IO error [fn:%s][fd=%d][Offset=%lld][Length=%ld]\n", FileName, fd_new, Offset, NumberOfBytesToWrite);
-            ceph_close(cmount, fd_new);
+            fwprintf(stderr, L"ceph_write IO error [fn:%s][shared][Offset=%lld][Length=%ld]\n", FileName, Offset, NumberOfBytesToWrite);
             return ret;
         }
         *NumberOfBytesWritten = ret;
-        
-        ceph_close(cmount, fd_new);
         return 0;
     }
     else{
@@ -1080,7 +1336,7 @@ WinCephGetFileInformation(
     struct fd_context fdc;
     memcpy(&fdc, &(DokanFileInfo->Context), sizeof(fdc));
     if (fdc.fd==0) {
-        int ret = ceph_stat(cmount, file_name, &stbuf);
+        int ret = stat_cache_stat(file_name, &stbuf);
         if(ret){
             //fwprintf(stderr, L"GetFileInformation ceph_stat error [%s]\n", FileName);
             return -1;
@@ -1171,55 +1427,62 @@ WinCephFindFiles(
     
     //fwprintf(stderr, L"FindFiles ceph_opendir OK: %s\n", FileName);
     
+    struct dirent *results = (struct dirent *)malloc(sizeof(struct dirent) * CEPH_DOKAN_READDIR_BATCH);
+    struct stat *stbufs = (struct stat *)malloc(sizeof(struct stat) * CEPH_DOKAN_READDIR_BATCH);
+    int *stmasks = (int *)malloc(sizeof(int) * CEPH_DOKAN_READDIR_BATCH);
     while(1)
     {
-        memset(&findData, 0, sizeof(findData));
-        struct dirent result;
-        struct stat stbuf;
-        int stmask;
-        
-        ret = ceph_readdirplus_r(cmount, dirp, &result, &stbuf, &stmask);
+        ret = ceph_readdirplus_batch(cmount, dirp, results, stbufs, stmasks,
+                                     CEPH_DOKAN_READDIR_BATCH, 1);
         if(ret==0)
             break;
         if(ret<0){
-            fprintf(stderr, "FindFiles ceph_readdirplus_r error [%ls][ret=%d]\n", FileName, ret);
-            return ret;
-        }
-        
-        if(strcmp(result.d_name, ".")==0 || strcmp(result.d_name, "..")==0){
-        //     continue;
+            fprintf(stderr, "FindFiles ceph_readdirplus_batch error [%ls][ret=%d]\n", FileName, ret);
+            break;
         }
         
-        //d_name
-        WCHAR d_name[MAX_PATH_CEPH];
-        int len = char_to_wchar(d_name, result.d_name, MAX_PATH_CEPH);
-        
-        wcscpy(findData.cFileName, d_name);
-        
-        //st_size
-        findData.nFileSizeLow = (stbuf.st_size << 32)>>32;
-        findData.nFileSizeHigh = stbuf.st_size >> 32;
-        
-        //st_mtim
-        UnixTimeToFileTime(stbuf.st_mtime, &findData.ftCreationTime);
-        UnixTimeToFileTime(stbuf.st_mtime, &findData.ftLastAccessTime);
-        UnixTimeToFileTime(stbuf.st_mtime, &findData.ftLastWriteTime);
-        
-        //st_mode
-        if(S_ISDIR(stbuf.st_mode)){
-            //printf("[%s] is a Directory.............\n", result.d_name);
-            findData.dwFileAttributes |= FILE_ATTRIBUTE_DIRECTORY;
-        }
-        else if(S_ISREG(stbuf.st_mode)){
-            //printf("[%s] is a Regular File.............\n", result.d_name);
-            findData.dwFileAttributes |= FILE_ATTRIBUTE_NORMAL;
+        int i;
+        for(i = 0; i < ret; i++)
+        {
+            struct dirent *result = &results[i];
+            struct stat *stbuf = &stbufs[i];
+            memset(&findData, 0, sizeof(findData));
+            
+            //d_name
+            WCHAR d_name[MAX_PATH_CEPH];
+            int len = char_to_wchar(d_name, result->d_name, MAX_PATH_CEPH);
+            
+            wcscpy(findData.cFileName, d_name);
+            
+            //st_size
+            findData.nFileSizeLow = (stbuf->st_size << 32)>>32;
+            findData.nFileSizeHigh = stbuf->st_size >> 32;
+            
+            //st_mtim
+            UnixTimeToFileTime(stbuf->st_mtime, &findData.ftCreationTime);
+            UnixTimeToFileTime(stbuf->st_mtime, &findData.ftLastAccessTime);
+            UnixTimeToFileTime(stbuf->st_mtime, &findData.ftLastWriteTime);
+            
+            //st_mode
+            if(S_ISDIR(stbuf->st_mode)){
+                findData.dwFileAttributes |= FILE_ATTRIBUTE_DIRECTORY;
+            }
+            else if(S_ISREG(stbuf->st_mode)){
+                findData.dwFileAttributes |= FILE_ATTRIBUTE_NORMAL;
+            }
+            
+            FillFindData(&findData, DokanFileInfo);
+            count++;
+            DbgPrintW(L"findData.cFileName is [%s]\n", findData.cFileName);
         }
-        
-        FillFindData(&findData, DokanFileInfo);
-        count++;
-        DbgPrintW(L"findData.cFileName is [%s]\n", findData.cFileName);
-        
-        //fprintf(stderr, "ceph_readdir [%d][%s]\n", count, result.d_name);
+    }
+    free(results);
+    free(stbufs);
+    free(stmasks);
+    
+    if(ret<0){
+        ceph_closedir(cmount, dirp);
+        return ret;
     }
     
     ret = ceph_closedir(cmount, dirp);
@@ -1755,6 +2018,8 @@ WinCephUnmount(
 {
     DbgPrintW(L"Unmount\n");
     fwprintf(stderr, L"umount\n");
+    stat_cache_report();
+    cache_shutdown();
     ceph_unmount(cmount);
     return 0;
 }
@@ -1776,6 +2041,7 @@ BOOL WINAPI ConsoleHandler(DWORD dwType)
 
 static void unmount_atexit(void) 
 {
+    cache_shutdown();
     int ret = ceph_unmount(cmount);
     printf("umount FINISHED [%d]\n", ret);
 }
@@ -1972,6 +2238,10 @@ main(int argc, char* argv[])
     
     ceph_printf_stdout("ceph_mount OK");
     
+    InitializeCriticalSection(&g_HandlesLock);
+    g_SweeperStop = CreateEvent(NULL, TRUE, FALSE, NULL);
+    g_Sweeper = CreateThread(NULL, 0, cache_sweeper, NULL, 0, NULL);
+
     atexit(unmount_atexit);
     
     sprintf(msg, "ceph_getcwd [%s]", ceph_getcwd(cmount));
@@ -24,6 +24,7 @@ Don't replace this file with the origin.
 #include <utime.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <stdint.h>
 //#include <sys/statvfs.h>
 //#include <sys/socket.h>
 
@@ -59,6 +60,15 @@ struct CephContext;
 # define CEPH_SETATTR_CTIME 64
 #endif
 
+/* ceph_fadvise hints */
+#ifndef CEPH_FADVISE_SEQUENTIAL
+# define CEPH_FADVISE_SEQUENTIAL    1
+# define CEPH_FADVISE_RANDOM        2
+# define CEPH_FADVISE_NOCACHE       4
+# define CEPH_FADVISE_WRITETHROUGH  8
+# define CEPH_FADVISE_TEMPORARY    16
+#endif
+
 /**
  * @defgroup libcephfs_h_init Setup and Teardown
  * These are the first and last functions that should be called
@@ -337,6 +347,25 @@ int ceph_readdir_r(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp,
 int ceph_readdirplus_r(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp, struct dirent *de,
 		       struct stat *st, int *stmask);
 
+/**
+ * Gets up to max directory entries and their statistics in one call.
+ *
+ * @param cmount the ceph mount handle to use for performing the readdirplus.
+ * @param dirp the directory stream pointer from an opendir holding the state of the
+ *        next entry to return.
+ * @param de an array of at least max dirents filled in with the next directory entries.
+ * @param st an array of at least max stats filled in for those entries.
+ * @param stmask an array of at least max masks of the stats fields that are set in st.
+ * @param max the number of entries the arrays can hold.
+ * @param prefetch if non-zero, ask the MDS for the next chunk of the directory
+ *        while the caller consumes this batch.
+ * @returns the number of entries filled in, 0 if the end of the directory stream was
+ *          reached, and a negative error code on failure.
+ */
+int ceph_readdirplus_batch(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp,
+			   struct dirent *de, struct stat *st, int *stmask, int max,
+			   int prefetch);
+
 /**
  * Gets multiple directory entries.
  *
@@ -513,6 +542,47 @@ int ceph_stat(struct ceph_mount_info *cmount, const char *path, struct stat *stb
  */
 int ceph_lstat(struct ceph_mount_info *cmount, const char *path, struct stat *stbuf);
 
+/**
+ * Get the statistics of an inode from the client's cache, without a path walk
+ * or a round trip to the MDS.
+ *
+ * @param cmount the ceph mount handle to use for performing the stat.
+ * @param ino the inode number, as returned in st_ino by an earlier stat.
+ * @param stbuf the stat struct that will be filled in with the file's statistics.
+ * @returns 0 on success, -ESTALE if the inode is no longer cached, or -EAGAIN if
+ *          the client does not hold the caps that keep the cached attributes valid.
+ */
+int ceph_stat_cached(struct ceph_mount_info *cmount, uint64_t ino, struct stat *stbuf);
+
+/**
+ * Get the statistics of a path from the client's cache, without a round trip
+ * to the MDS.  Each path component is only trusted while the client holds a
+ * lease on its dentry (or the shared cap on its parent directory), so a path
+ * renamed or replaced by another client is not resolved to the old inode.
+ *
+ * @param cmount the ceph mount handle to use for performing the stat.
+ * @param path the file or directory to get the statistics of.
+ * @param stbuf the stat struct that will be filled in with the file's statistics.
+ * @returns 0 on success, -ENOENT if the cache knows the path does not exist, or
+ *          -EAGAIN if the cache cannot answer (a component or the attributes are
+ *          not covered, or the path has a symlink); then use ceph_stat.
+ */
+int ceph_stat_cached_path(struct ceph_mount_info *cmount, const char *path,
+			  struct stat *stbuf);
+
+/**
+ * Get a file's statistics along with the version of its extended attributes,
+ * which changes whenever any of them (a POSIX ACL included) does.
+ *
+ * @param cmount the ceph mount handle to use for performing the stat.
+ * @param path the file or directory to get the statistics of.
+ * @param stbuf the stat struct that will be filled in with the file's statistics.
+ * @param xattr_version filled in with the xattr version.
+ * @returns 0 on success or negative error code on failure.
+ */
+int ceph_stat_xattr_version(struct ceph_mount_info *cmount, const char *path,
+			    struct stat *stbuf, uint64_t *xattr_version);
+
 /**
  * Set a file's attributes.
  * 
@@ -693,6 +763,54 @@ int ceph_read(struct ceph_mount_info *cmount, int fd, char *buf, loff_t size, lo
 int ceph_write(struct ceph_mount_info *cmount, int fd, const char *buf, loff_t size,
 	       loff_t offset);
 
+/**
+ * Completion callback for ceph_aio_read and ceph_aio_write.
+ *
+ * @param arg the argument given when the request was submitted.
+ * @param result the number of bytes read or written, or a negative error code.
+ */
+typedef void (*ceph_aio_callback_t)(void *arg, int result);
+
+/**
+ * Read data from a file without waiting for it.
+ *
+ * The request is handed to the cache or the OSDs and the call returns; cb is
+ * later called from a libcephfs thread with the result.  Requests that cannot
+ * be issued without waiting (e.g. while the client has no read caps on the
+ * file) are done before returning, and still complete through cb.
+ *
+ * @param cmount the ceph mount handle to use for performing the read.
+ * @param fd the file descriptor of the open file to read from.
+ * @param buf the buffer to read data into; it must stay valid until cb is called.
+ * @param size the size of the buffer
+ * @param offset the offset in the file to read from.  Must not be negative.
+ * @param cb the completion callback.
+ * @param arg an argument passed to cb.
+ * @returns 0 if the request was submitted, or a negative error code, in which case
+ *          cb is not called.
+ */
+int ceph_aio_read(struct ceph_mount_info *cmount, int fd, char *buf, loff_t size,
+		  loff_t offset, ceph_aio_callback_t cb, void *arg);
+
+/**
+ * Write data to a file without waiting for it.
+ *
+ * buf is copied before the call returns.  cb is called once the data is in
+ * the cache or, without buffering caps, acknowledged by the OSDs.
+ *
+ * @param cmount the ceph mount handle to use for performing the write.
+ * @param fd the file descriptor of the open file to write to
+ * @param buf the bytes to write to the file
+ * @param size the size of the buf array
+ * @param offset the offset of the file write into.  Must not be negative.
+ * @param cb the completion callback.
+ * @param arg an argument passed to cb.
+ * @returns 0 if the request was submitted, or a negative error code, in which case
+ *          cb is not called.
+ */
+int ceph_aio_write(struct ceph_mount_info *cmount, int fd, const char *buf, loff_t size,
+		   loff_t offset, ceph_aio_callback_t cb, void *arg);
+
 /**
  * Truncate a file to the given size.
  *
@@ -714,6 +832,24 @@ int ceph_ftruncate(struct ceph_mount_info *cmount, int fd, loff_t size);
  */
 int ceph_fsync(struct ceph_mount_info *cmount, int fd, int syncdataonly);
 
+/**
+ * Set the access hints for an open file.
+ *
+ * The hints apply to this file descriptor only and replace any set before.
+ * CEPH_FADVISE_SEQUENTIAL reads ahead in large windows and lets the cache
+ * drop data once it has been read; CEPH_FADVISE_RANDOM disables readahead;
+ * CEPH_FADVISE_NOCACHE reads and writes the OSDs directly; with
+ * CEPH_FADVISE_WRITETHROUGH each write is committed before it returns; and
+ * CEPH_FADVISE_TEMPORARY keeps dirty data cached until the cache needs the
+ * space or the file is flushed or closed.
+ *
+ * @param cmount the ceph mount handle to use.
+ * @param fd the file descriptor of the open file.
+ * @param hints a mask of CEPH_FADVISE_* flags, or 0 for the defaults.
+ * @returns 0 on success or a negative error code on failure.
+ */
+int ceph_fadvise(struct ceph_mount_info *cmount, int fd, int hints);
+
 /**
  * Get the open file's statistics.
  *
@@ -1140,6 +1276,184 @@ int ceph_debug_get_fd_caps(struct ceph_mount_info *cmount, int fd);
  */
 int ceph_debug_get_file_caps(struct ceph_mount_info *cmount, const char *path);
 
+/**
+ * @defgroup libcephfs_h_ll Low Level Inode Handle Interface.
+ * Functions keyed by a pinned Inode (or open Fh) instead of a path, so
+ * the path is resolved once and later calls skip the path walk.
+ *
+ * @{
+ */
+
+struct Inode;
+typedef struct Inode Inode;
+struct Fh;
+typedef struct Fh Fh;
+
+/* layout-compatible with the client's inodeno_t/snapid_t/vinodeno_t */
+typedef struct _inodeno_t {
+  uint64_t val;
+} inodeno_t;
+
+typedef struct _snapid_t {
+  uint64_t val;
+} snapid_t;
+
+typedef struct vinodeno_t {
+  inodeno_t ino;
+  snapid_t snapid;
+} vinodeno_t;
+
+#ifndef CEPH_NOSNAP
+# define CEPH_NOSNAP  ((uint64_t)(-2))
+#endif
+
+/**
+ * Get the root inode of the mount.  The returned reference must be dropped
+ * with ceph_ll_put.
+ *
+ * @param cmount the ceph mount handle to use.
+ * @param parent filled in with the root Inode.
+ * @returns 0 on success or -EFAULT if the client has no root.
+ */
+int ceph_ll_lookup_root(struct ceph_mount_info *cmount, Inode **parent);
+
+/**
+ * Pin an Inode the client already has in cache, e.g. by the st_ino of an
+ * earlier stat, without a path walk or a round trip to the MDS.
+ *
+ * @param cmount the ceph mount handle to use.
+ * @param vino the inode number, with snapid.val = CEPH_NOSNAP for the live file.
+ * @returns the pinned Inode (release it with ceph_ll_put), or NULL if it is
+ *          not in cache.
+ */
+Inode *ceph_ll_get_inode(struct ceph_mount_info *cmount, vinodeno_t vino);
+
+/**
+ * Look up a name in a directory and pin the resulting Inode.
+ *
+ * @param cmount the ceph mount handle to use.
+ * @param parent the directory Inode to look in.
+ * @param name the entry name (a single path component).
+ * @param attr filled in with the stat of the entry.
+ * @param out filled in with the pinned Inode; release it with ceph_ll_put.
+ * @param uid user id for permission checks (-1 for the mount default).
+ * @param gid group id for permission checks (-1 for the mount default).
+ * @returns 0 on success or a negative error code on failure.
+ */
+int ceph_ll_lookup(struct ceph_mount_info *cmount, Inode *parent,
+		   const char *name, struct stat *attr,
+		   Inode **out, int uid, int gid);
+
+/**
+ * Resolve a full path once and pin the resulting Inode.
+ *
+ * @param cmount the ceph mount handle to use.
+ * @param name the path to resolve; symlinks in the last component are not followed.
+ * @param i filled in with the pinned Inode; release it with ceph_ll_put.
+ * @param attr filled in with the stat of the Inode.
+ * @returns 0 on success or a negative error code on failure.
+ */
+int ceph_ll_walk(struct ceph_mount_info *cmount, const char *name,
+		 Inode **i, struct stat *attr);
+
+/**
+ * Drop one reference taken by ceph_ll_lookup, ceph_ll_walk or ceph_ll_lookup_root.
+ *
+ * @returns non-zero if this was the last reference.
+ */
+int ceph_ll_put(struct ceph_mount_info *cmount, Inode *in);
+
+/**
+ * Drop count references on an Inode.
+ *
+ * @returns non-zero if this was the last reference.
+ */
+int ceph_ll_forget(struct ceph_mount_info *cmount, Inode *in, int count);
+
+/**
+ * Get the stat of a pinned Inode, refreshing it from the MDS if our caps
+ * do not cover it.
+ *
+ * @returns 0 on success or a negative error code on failure.
+ */
+int ceph_ll_getattr(struct ceph_mount_info *cmount, Inode *in,
+		    struct stat *attr, int uid, int gid);
+
+/**
+ * Set attributes on a pinned Inode.
+ *
+ * @param mask a combination of the CEPH_SETATTR_* flags.
+ * @returns 0 on success or a negative error code on failure.
+ */
+int ceph_ll_setattr(struct ceph_mount_info *cmount, Inode *in,
+		    struct stat *st, int mask, int uid, int gid);
+
+/**
+ * Truncate the file behind a pinned Inode.
+ *
+ * @returns 0 on success or a negative error code on failure.
+ */
+int ceph_ll_truncate(struct ceph_mount_info *cmount, Inode *in,
+		     uint64_t length, int uid, int gid);
+
+/**
+ * Open a pinned Inode.  O_CREAT is not supported here.
+ *
+ * @param fh filled in with the open file handle; close it with ceph_ll_close.
+ * @returns 0 on success, -EINVAL if flags has O_CREAT, or a negative error
+ *          code on failure.
+ */
+int ceph_ll_open(struct ceph_mount_info *cmount, Inode *in, int flags,
+		 Fh **fh, int uid, int gid);
+
+/**
+ * Read from an open file handle.
+ *
+ * @returns the number of bytes read into buf, or a negative error code on failure.
+ */
+int ceph_ll_read(struct ceph_mount_info *cmount, Fh *filehandle,
+		 int64_t off, uint64_t len, char *buf);
+
+/**
+ * Write to an open file handle.
+ *
+ * @returns the number of bytes written, or a negative error code on failure.
+ */
+int ceph_ll_write(struct ceph_mount_info *cmount, Fh *filehandle,
+		  int64_t off, uint64_t len, const char *data);
+
+loff_t ceph_ll_lseek(struct ceph_mount_info *cmount, Fh *filehandle,
+		     loff_t offset, int whence);
+int ceph_ll_fsync(struct ceph_mount_info *cmount, Fh *fh, int syncdataonly);
+
+/**
+ * Close a file handle returned by ceph_ll_open.
+ *
+ * @returns 0 on success or a negative error code on failure.
+ */
+int ceph_ll_close(struct ceph_mount_info *cmount, Fh *filehandle);
+
+/**
+ * Open a pinned directory Inode for listing.  The result is read with
+ * ceph_readdir_r/ceph_readdirplus_r like one from ceph_opendir.
+ *
+ * @returns 0 on success or a negative error code on failure.
+ */
+int ceph_ll_opendir(struct ceph_mount_info *cmount, Inode *in,
+		    struct ceph_dir_result **dirpp, int uid, int gid);
+int ceph_ll_releasedir(struct ceph_mount_info *cmount,
+		       struct ceph_dir_result *dir);
+
+/**
+ * Get file system statistics for the file system holding a pinned Inode.
+ *
+ * @returns 0 on success or a negative error code on failure.
+ */
+int ceph_ll_statfs(struct ceph_mount_info *cmount, Inode *in,
+		   struct statvfs *stbuf);
+
+/** @} ll */
+
 void ceph_show_version();
 
 void ceph_printf_stdout(const char* strlog);
@@ -2,7 +2,10 @@
 
 #include "posix_acl.h"
 
+#include <pthread.h>
 #include <string>
+#include <map>
+#include "include/unordered_map.h"
 
 #define    EPERM         1    /* Operation not permitted */
 #define    ENOENT        2    /* No such file or directory */
@@ -613,28 +616,15 @@ check_perm:
     return -EACCES;
 }
 
-int permission_walk_ugo(struct ceph_mount_info *cmount, const char *path, uid_t uid, gid_t gid,
-                           int perm_chk, int readlink = 0){
-    int rt;
-    //I'm root~~
-    if(uid == 0){
-        return 0;
-    }
-    
-    struct stat stbuf;
-    int chk = perm_chk;
-    int res = ceph_stat(cmount, path, &stbuf);
-    if(res){
-        rt =  res;
-        goto __free_quit;
-    }
-
+/*check the mode bits of an already stat'ed inode*/
+static int permission_check_ugo(const struct stat *stbuf, uid_t uid, gid_t gid, int perm_chk)
+{
     int mr,mw,mx;
-    if(stbuf.st_uid == uid){
+    if(stbuf->st_uid == uid){
         mr = S_IRUSR;
         mw = S_IWUSR;
         mx = S_IXUSR;
-    }else if(stbuf.st_gid == gid){
+    }else if(stbuf->st_gid == gid){
         mr = S_IRGRP;
         mw = S_IWGRP;
         mx = S_IXGRP;
@@ -643,28 +633,28 @@ int permission_walk_ugo(struct ceph_mount_info *cmount, const char *path, uid_t
         mw = S_IWOTH;
         mx = S_IXOTH;
     }
-    if(chk & PERM_WALK_CHECK_READ){
-        if(!(stbuf.st_mode & mr)){
-            rt = -EACCES;
-            goto __free_quit;
-        }
-    }
-    if(chk & PERM_WALK_CHECK_WRITE){
-        if(!(stbuf.st_mode & mw)){
-            rt = -EACCES;
-            goto __free_quit;
-        }
+    if((perm_chk & PERM_WALK_CHECK_READ) && !(stbuf->st_mode & mr))
+        return -EACCES;
+    if((perm_chk & PERM_WALK_CHECK_WRITE) && !(stbuf->st_mode & mw))
+        return -EACCES;
+    if((perm_chk & PERM_WALK_CHECK_EXEC) && !(stbuf->st_mode & mx))
+        return -EACCES;
+    return 0;
+}
+
+int permission_walk_ugo(struct ceph_mount_info *cmount, const char *path, uid_t uid, gid_t gid,
+                           int perm_chk, int readlink = 0){
+    //I'm root~~
+    if(uid == 0){
+        return 0;
     }
-    if(chk & PERM_WALK_CHECK_EXEC){
-        if(!(stbuf.st_mode & mx)){
-            rt = -EACCES;
-            goto __free_quit;
-        }
+    
+    struct stat stbuf;
+    int res = ceph_stat(cmount, path, &stbuf);
+    if(res){
+        return res;
     }
-
-    rt = 0;
-__free_quit:
-    return rt;
+    return permission_check_ugo(&stbuf, uid, gid, perm_chk);
 }
 
 int fuse_check_acl(struct ceph_mount_info *cmount, const char *path, const char *acl_xattr, int length, kuid_t uid, kgid_t gid, int mask)
@@ -675,7 +665,6 @@ int fuse_check_acl(struct ceph_mount_info *cmount, const char *path, const char
     acl = posix_acl_from_xattr(acl_xattr, length);
     if(IS_ERR(acl)) {
         error = PTR_ERR(acl);
-        printf("error1 = %d\n", error);
         return error;
     }
     
@@ -698,6 +687,119 @@ int fuse_check_acl(struct ceph_mount_info *cmount, const char *path, const char
     return error;
 }
 
+/*
+ * Parsed access ACLs, keyed by inode number.
+ *
+ * An entry remembers the xattr version/mode/owner the inode had when its
+ * POSIX_ACL_XATTR_ACCESS was read; any xattr change bumps the version and
+ * chmod/chown change the others, so a fresh ceph_stat_xattr_version
+ * (served from our caps until the MDS revokes them) tells us whether the
+ * entry is still good.  Inodes without an access ACL are cached too
+ * (acl == NULL), and every (uid, gid, mask) decision is memoized on the
+ * entry.
+ *
+ * The ACL is checked against the owner ceph_lstat reports for the path,
+ * as fuse_check_acl does.  When the path is a symlink that is not the
+ * inode the ACL came from, so those decisions are made but not cached.
+ */
+#define ACL_CACHE_MAX 8192
+
+typedef std::pair<std::pair<uid_t, gid_t>, int> acl_decision_key;
+
+struct acl_cache_entry {
+    uint64_t xattr_version;
+    unsigned int mode;
+    uid_t uid;
+    gid_t gid;
+    struct posix_acl *acl;
+    std::map<acl_decision_key, int> decisions;
+};
+
+static pthread_mutex_t acl_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static ceph::unordered_map<uint64_t, struct acl_cache_entry *> acl_cache;
+
+static void acl_cache_erase(uint64_t ino)
+{
+    ceph::unordered_map<uint64_t, struct acl_cache_entry *>::iterator p = acl_cache.find(ino);
+    if(p == acl_cache.end())
+        return;
+    posix_acl_release(p->second->acl);
+    delete p->second;
+    acl_cache.erase(p);
+}
+
+/*return the entry for stbuf's inode if it is still valid, dropping it otherwise*/
+static struct acl_cache_entry *acl_cache_get(const struct stat *stbuf, uint64_t xattr_version)
+{
+    ceph::unordered_map<uint64_t, struct acl_cache_entry *>::iterator p = acl_cache.find(stbuf->st_ino);
+    if(p == acl_cache.end())
+        return NULL;
+    struct acl_cache_entry *ent = p->second;
+    if(ent->xattr_version == xattr_version &&
+       ent->mode == stbuf->st_mode &&
+       ent->uid == stbuf->st_uid &&
+       ent->gid == stbuf->st_gid)
+        return ent;
+    acl_cache_erase(stbuf->st_ino);
+    return NULL;
+}
+
+/*takes ownership of acl*/
+static struct acl_cache_entry *acl_cache_insert(const struct stat *stbuf, uint64_t xattr_version,
+                                               struct posix_acl *acl)
+{
+    acl_cache_erase(stbuf->st_ino);
+    if(acl_cache.size() >= ACL_CACHE_MAX){
+        while(!acl_cache.empty())
+            acl_cache_erase(acl_cache.begin()->first);
+    }
+
+    struct acl_cache_entry *ent = new acl_cache_entry;
+    ent->xattr_version = xattr_version;
+    ent->mode = stbuf->st_mode;
+    ent->uid = stbuf->st_uid;
+    ent->gid = stbuf->st_gid;
+    ent->acl = acl;
+    acl_cache[stbuf->st_ino] = ent;
+    return ent;
+}
+
+static int acl_cache_decide(struct acl_cache_entry *ent, const struct stat *stbuf,
+                            uid_t uid, gid_t gid, int perm_chk)
+{
+    acl_decision_key key(std::make_pair(uid, gid), perm_chk);
+    std::map<acl_decision_key, int>::iterator p = ent->decisions.find(key);
+    if(p != ent->decisions.end())
+        return p->second;
+
+    int rt;
+    if(ent->acl){
+        struct inode_cxt inode;
+        inode.i_uid = ent->uid;
+        inode.i_gid = ent->gid;
+
+        struct inode_cxt evn_cxt;
+        evn_cxt.i_uid = uid;
+        evn_cxt.i_gid = gid;
+
+        rt = posix_acl_permission(&inode, &evn_cxt, ent->acl, perm_chk);
+    }else{
+        rt = permission_check_ugo(stbuf, uid, gid, perm_chk);
+    }
+    ent->decisions[key] = rt;
+    return rt;
+}
+
+void posix_acl_cache_invalidate(struct ceph_mount_info *cmount, const char *path)
+{
+    struct stat stbuf;
+    if(ceph_stat(cmount, path, &stbuf))
+        return;
+    pthread_mutex_lock(&acl_cache_lock);
+    acl_cache_erase(stbuf.st_ino);
+    pthread_mutex_unlock(&acl_cache_lock);
+}
+
 /*check ACL first, if ACL does not exists, check UGO*/
 int permission_walk(struct ceph_mount_info *cmount, const char *path, uid_t uid, gid_t gid, int perm_chk)
 {
@@ -706,17 +808,62 @@ int permission_walk(struct ceph_mount_info *cmount, const char *path, uid_t uid,
         return 0;
     }
     
+    struct stat stbuf;
+    uint64_t xattr_version;
+    int rt = ceph_stat_xattr_version(cmount, path, &stbuf, &xattr_version);
+    if(rt){
+        return rt;
+    }
+
+    pthread_mutex_lock(&acl_cache_lock);
+    struct acl_cache_entry *ent = acl_cache_get(&stbuf, xattr_version);
+    if(ent){
+        rt = acl_cache_decide(ent, &stbuf, uid, gid, perm_chk);
+        pthread_mutex_unlock(&acl_cache_lock);
+        return rt;
+    }
+    pthread_mutex_unlock(&acl_cache_lock);
+
+    /*miss: fetch and parse the ACL without holding the cache lock*/
     char acl_xattr[XATTR_MAX_SIZE];
     memset(acl_xattr, 0x00, sizeof(acl_xattr));
     
-    int length = 0;
-    length = ceph_getxattr(cmount, path, POSIX_ACL_XATTR_ACCESS, acl_xattr, XATTR_MAX_SIZE);
-    if(length <= 0){
-        return permission_walk_ugo(cmount, path, uid, gid, perm_chk, 0);
-    }
-    else{
-        return fuse_check_acl(cmount, path, acl_xattr, length, uid, gid, perm_chk);
+    struct posix_acl *acl = NULL;
+    int length = ceph_getxattr(cmount, path, POSIX_ACL_XATTR_ACCESS, acl_xattr, XATTR_MAX_SIZE);
+    if(length > 0){
+        acl = posix_acl_from_xattr(acl_xattr, length);
+        if(IS_ERR(acl)) {
+            rt = PTR_ERR(acl);
+            return rt;
+        }
+
+        /*the owner the ACL is checked against is the path's own*/
+        struct stat lstbuf;
+        rt = ceph_lstat(cmount, path, &lstbuf);
+        if(rt){
+            posix_acl_release(acl);
+            return rt;
+        }
+        if(lstbuf.st_ino != stbuf.st_ino){
+            struct inode_cxt inode;
+            inode.i_uid = lstbuf.st_uid;
+            inode.i_gid = lstbuf.st_gid;
+
+            struct inode_cxt evn_cxt;
+            evn_cxt.i_uid = uid;
+            evn_cxt.i_gid = gid;
+
+            rt = posix_acl_permission(&inode, &evn_cxt, acl, perm_chk);
+            posix_acl_release(acl);
+            return rt;
+        }
     }
+
+    pthread_mutex_lock(&acl_cache_lock);
+    ent = acl_cache_insert(&stbuf, xattr_version, acl);
+    rt = acl_cache_decide(ent, &stbuf, uid, gid, perm_chk);
+    pthread_mutex_unlock(&acl_cache_lock);
+    return rt;
 }
 
 int permission_walk_parent(struct ceph_mount_info *cmount, const char *path, uid_t uid, gid_t gid, int perm_chk)
@@ -752,7 +899,6 @@ int fuse_init_acl(struct ceph_mount_info *cmount, const char *path, umode_t i_mo
     acl = posix_acl_from_xattr(acl_xattr, length);
     if(IS_ERR(acl)) {
         error = PTR_ERR(acl);
-        printf("error1 = %d\n", error);
         return error;
     }
     
@@ -781,6 +927,7 @@ int fuse_init_acl(struct ceph_mount_info *cmount, const char *path, umode_t i_mo
             memset(buffer, 0x00, sizeof(buffer));
             int real_len = posix_acl_to_xattr(acl, buffer, XATTR_MAX_SIZE);
             error = ceph_setxattr(cmount, path, POSIX_ACL_XATTR_ACCESS, buffer, real_len, 0);
+            posix_acl_cache_invalidate(cmount, path);
             if (error){
                 fprintf(stderr, "ceph_setxattr2 error %s %d\n", path, error);
                 goto cleanup;
@@ -835,6 +982,7 @@ int fuse_disable_acl_mask(struct ceph_mount_info *cmount, const char *path)
         
         int real_len = posix_acl_to_xattr(acl, buffer, XATTR_MAX_SIZE);
         error = ceph_setxattr(cmount, path, POSIX_ACL_XATTR_ACCESS, buffer, real_len, 0);
+        posix_acl_cache_invalidate(cmount, path);
         if (error) goto cleanup;
     }
 cleanup:
@@ -877,6 +1025,7 @@ int fuse_inherit_acl(struct ceph_mount_info *cmount, const char *path)
         
         int real_len = posix_acl_to_xattr(acl, buffer, XATTR_MAX_SIZE);
         error = ceph_setxattr(cmount, path, POSIX_ACL_XATTR_ACCESS, buffer, real_len, 0);
+        posix_acl_cache_invalidate(cmount, path);
         if (error)
             goto cleanup;
     }
@@ -186,6 +186,7 @@ posix_acl_valid(const struct posix_acl *acl);
 
 int permission_walk(struct ceph_mount_info *cmount, const char *path, uid_t uid, gid_t gid, int perm_chk);
 int permission_walk_parent(struct ceph_mount_info *cmount, const char *path, uid_t uid, gid_t gid, int perm_chk);
+void posix_acl_cache_invalidate(struct ceph_mount_info *cmount, const char *path);
 int fuse_init_acl(struct ceph_mount_info *cmount, const char *path, umode_t i_mode);
 int fuse_disable_acl_mask(struct ceph_mount_info *cmount, const char *path);
 int fuse_inherit_acl(struct ceph_mount_info *cmount, const char *path);
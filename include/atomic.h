@@ -127,6 +127,47 @@ namespace ceph {
 
 }
 
+#elif defined(__GNUC__) && defined(__ATOMIC_SEQ_CST)
+/*
+ * no libatomic_ops, but gcc (>= 4.7) has the __atomic builtins.  every
+ * operation is sequentially consistent, so this is no weaker than the
+ * spinlock version, and costs one locked instruction at most.
+ */
+namespace ceph {
+  template <class T>
+  class atomic_builtin_t {
+    // 64-bit values must be naturally aligned to be atomic on i386
+    T val __attribute__((aligned(sizeof(T))));
+  public:
+    atomic_builtin_t(T i=0) : val(i) {}
+    void set(T v) {
+      __atomic_store_n(&val, v, __ATOMIC_SEQ_CST);
+    }
+    T inc() {
+      return __atomic_add_fetch(&val, 1, __ATOMIC_SEQ_CST);
+    }
+    T dec() {
+      return __atomic_sub_fetch(&val, 1, __ATOMIC_SEQ_CST);
+    }
+    void add(T d) {
+      __atomic_add_fetch(&val, d, __ATOMIC_SEQ_CST);
+    }
+    void sub(T d) {
+      __atomic_sub_fetch(&val, d, __ATOMIC_SEQ_CST);
+    }
+    T read() const {
+      return __atomic_load_n(&val, __ATOMIC_SEQ_CST);
+    }
+  private:
+    // forbid copying
+    atomic_builtin_t(const atomic_builtin_t<T> &other);
+    atomic_builtin_t &operator=(const atomic_builtin_t<T> &rhs);
+  };
+
+  typedef atomic_builtin_t<unsigned> atomic_t;
+  typedef atomic_builtin_t<unsigned long long> atomic64_t;
+}
+
 #else
 /*
  * crappy slow implementation that uses a pthreads spinlock.
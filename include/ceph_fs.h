@@ -360,6 +360,15 @@ extern const char *ceph_mds_op_name(int op);
 #define CEPH_SETATTR_SIZE  32
 #define CEPH_SETATTR_CTIME 64
 
+/*
+ * Per-handle access hints, see ceph_fadvise().
+ */
+#define CEPH_FADVISE_SEQUENTIAL    1  /* read ahead hard, drop what was read */
+#define CEPH_FADVISE_RANDOM        2  /* no readahead */
+#define CEPH_FADVISE_NOCACHE       4  /* bypass the object cacher */
+#define CEPH_FADVISE_WRITETHROUGH  8  /* commit each write before returning */
+#define CEPH_FADVISE_TEMPORARY    16  /* don't flush dirty data for age alone */
+
 /*
  * Ceph setxattr request flags.
  */
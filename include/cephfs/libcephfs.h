@@ -107,6 +107,15 @@ struct CephContext;
 # define CEPH_SETATTR_CTIME 64
 #endif
 
+/* ceph_fadvise hints */
+#ifndef CEPH_FADVISE_SEQUENTIAL
+# define CEPH_FADVISE_SEQUENTIAL    1
+# define CEPH_FADVISE_RANDOM        2
+# define CEPH_FADVISE_NOCACHE       4
+# define CEPH_FADVISE_WRITETHROUGH  8
+# define CEPH_FADVISE_TEMPORARY    16
+#endif
+
 /* define error codes for the mount function*/
 # define CEPHFS_ERROR_MON_MAP_BUILD 1000
 # define CEPHFS_ERROR_NEW_CLIENT 1002
@@ -433,6 +442,25 @@ int ceph_readdir_r(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp,
 int ceph_readdirplus_r(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp, struct dirent *de,
 		       struct stat *st, int *stmask);
 
+/**
+ * Gets up to max directory entries and their statistics in one call.
+ *
+ * @param cmount the ceph mount handle to use for performing the readdirplus.
+ * @param dirp the directory stream pointer from an opendir holding the state of the
+ *        next entry to return.
+ * @param de an array of at least max dirents filled in with the next directory entries.
+ * @param st an array of at least max stats filled in for those entries.
+ * @param stmask an array of at least max masks of the stats fields that are set in st.
+ * @param max the number of entries the arrays can hold.
+ * @param prefetch if non-zero, ask the MDS for the next chunk of the directory
+ *        while the caller consumes this batch.
+ * @returns the number of entries filled in, 0 if the end of the directory stream was
+ *          reached, and a negative error code on failure.
+ */
+int ceph_readdirplus_batch(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp,
+			   struct dirent *de, struct stat *st, int *stmask, int max,
+			   int prefetch);
+
 /**
  * Gets multiple directory entries.
  *
@@ -609,6 +637,47 @@ int ceph_stat(struct ceph_mount_info *cmount, const char *path, struct stat *stb
  */
 int ceph_lstat(struct ceph_mount_info *cmount, const char *path, struct stat *stbuf);
 
+/**
+ * Get the statistics of an inode from the client's cache, without a path walk
+ * or a round trip to the MDS.
+ *
+ * @param cmount the ceph mount handle to use for performing the stat.
+ * @param ino the inode number, as returned in st_ino by an earlier stat.
+ * @param stbuf the stat struct that will be filled in with the file's statistics.
+ * @returns 0 on success, -ESTALE if the inode is no longer cached, or -EAGAIN if
+ *          the client does not hold the caps that keep the cached attributes valid.
+ */
+int ceph_stat_cached(struct ceph_mount_info *cmount, uint64_t ino, struct stat *stbuf);
+
+/**
+ * Get the statistics of a path from the client's cache, without a round trip
+ * to the MDS.  Each path component is only trusted while the client holds a
+ * lease on its dentry (or the shared cap on its parent directory), so a path
+ * renamed or replaced by another client is not resolved to the old inode.
+ *
+ * @param cmount the ceph mount handle to use for performing the stat.
+ * @param path the file or directory to get the statistics of.
+ * @param stbuf the stat struct that will be filled in with the file's statistics.
+ * @returns 0 on success, -ENOENT if the cache knows the path does not exist, or
+ *          -EAGAIN if the cache cannot answer (a component or the attributes are
+ *          not covered, or the path has a symlink); then use ceph_stat.
+ */
+int ceph_stat_cached_path(struct ceph_mount_info *cmount, const char *path,
+			  struct stat *stbuf);
+
+/**
+ * Get a file's statistics along with the version of its extended attributes,
+ * which changes whenever any of them (a POSIX ACL included) does.
+ *
+ * @param cmount the ceph mount handle to use for performing the stat.
+ * @param path the file or directory to get the statistics of.
+ * @param stbuf the stat struct that will be filled in with the file's statistics.
+ * @param xattr_version filled in with the xattr version.
+ * @returns 0 on success or negative error code on failure.
+ */
+int ceph_stat_xattr_version(struct ceph_mount_info *cmount, const char *path,
+			    struct stat *stbuf, uint64_t *xattr_version);
+
 /**
  * Set a file's attributes.
  * 
@@ -789,6 +858,54 @@ int ceph_read(struct ceph_mount_info *cmount, int fd, char *buf, int64_t size, i
 int ceph_write(struct ceph_mount_info *cmount, int fd, const char *buf, int64_t size,
 	       int64_t offset);
 
+/**
+ * Completion callback for ceph_aio_read and ceph_aio_write.
+ *
+ * @param arg the argument given when the request was submitted.
+ * @param result the number of bytes read or written, or a negative error code.
+ */
+typedef void (*ceph_aio_callback_t)(void *arg, int result);
+
+/**
+ * Read data from a file without waiting for it.
+ *
+ * The request is handed to the cache or the OSDs and the call returns; cb is
+ * later called from a libcephfs thread with the result.  Requests that cannot
+ * be issued without waiting (e.g. while the client has no read caps on the
+ * file) are done before returning, and still complete through cb.
+ *
+ * @param cmount the ceph mount handle to use for performing the read.
+ * @param fd the file descriptor of the open file to read from.
+ * @param buf the buffer to read data into; it must stay valid until cb is called.
+ * @param size the size of the buffer
+ * @param offset the offset in the file to read from.  Must not be negative.
+ * @param cb the completion callback.
+ * @param arg an argument passed to cb.
+ * @returns 0 if the request was submitted, or a negative error code, in which case
+ *          cb is not called.
+ */
+int ceph_aio_read(struct ceph_mount_info *cmount, int fd, char *buf, int64_t size,
+		  int64_t offset, ceph_aio_callback_t cb, void *arg);
+
+/**
+ * Write data to a file without waiting for it.
+ *
+ * buf is copied before the call returns.  cb is called once the data is in
+ * the cache or, without buffering caps, acknowledged by the OSDs.
+ *
+ * @param cmount the ceph mount handle to use for performing the write.
+ * @param fd the file descriptor of the open file to write to
+ * @param buf the bytes to write to the file
+ * @param size the size of the buf array
+ * @param offset the offset of the file write into.  Must not be negative.
+ * @param cb the completion callback.
+ * @param arg an argument passed to cb.
+ * @returns 0 if the request was submitted, or a negative error code, in which case
+ *          cb is not called.
+ */
+int ceph_aio_write(struct ceph_mount_info *cmount, int fd, const char *buf, int64_t size,
+		   int64_t offset, ceph_aio_callback_t cb, void *arg);
+
 /**
  * Truncate a file to the given size.
  *
@@ -810,6 +927,24 @@ int ceph_ftruncate(struct ceph_mount_info *cmount, int fd, int64_t size);
  */
 int ceph_fsync(struct ceph_mount_info *cmount, int fd, int syncdataonly);
 
+/**
+ * Set the access hints for an open file.
+ *
+ * The hints apply to this file descriptor only and replace any set before.
+ * CEPH_FADVISE_SEQUENTIAL reads ahead in large windows and lets the cache
+ * drop data once it has been read; CEPH_FADVISE_RANDOM disables readahead;
+ * CEPH_FADVISE_NOCACHE reads and writes the OSDs directly; with
+ * CEPH_FADVISE_WRITETHROUGH each write is committed before it returns; and
+ * CEPH_FADVISE_TEMPORARY keeps dirty data cached until the cache needs the
+ * space or the file is flushed or closed.
+ *
+ * @param cmount the ceph mount handle to use.
+ * @param fd the file descriptor of the open file.
+ * @param hints a mask of CEPH_FADVISE_* flags, or 0 for the defaults.
+ * @returns 0 on success or a negative error code on failure.
+ */
+int ceph_fadvise(struct ceph_mount_info *cmount, int fd, int hints);
+
 /**
  * Preallocate or release disk space for the file for the byte range.
  *
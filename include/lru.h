@@ -18,8 +18,10 @@
 #define CEPH_LRU_H
 
 #include <stdint.h>
+#include <list>
 
 #include "common/config.h"
+#include "include/unordered_map.h"
 
 
 
@@ -29,6 +31,7 @@ class LRUObject {
   bool lru_pinned;
   class LRU *lru;
   class LRUList *lru_list;
+  uint64_t lru_key;  // identity that outlives the object, for LRU_POLICY_2Q
 
  public:
   LRUObject() {
@@ -36,6 +39,7 @@ class LRUObject {
     lru_list = 0;
     lru_pinned = false;
     lru = 0;
+    lru_key = 0;
   }
 
   // pin/unpin item in cache
@@ -43,6 +47,9 @@ class LRUObject {
   void lru_unpin();
   bool lru_is_expireable() { return !lru_pinned; }
 
+  // set before insertion; 0 means the item is never remembered once gone
+  void lru_set_key(uint64_t k) { lru_key = k; }
+
   friend class LRU;
   friend class LRUList;
 };
@@ -118,15 +125,84 @@ class LRUList {
 };
 
 
+/*
+ * replacement policies
+ *
+ * LRU_POLICY_MIDPOINT: new items go in at the midpoint, any touch moves an
+ *   item to the top, and top spills into bot past lru_midpoint.  anything
+ *   touched once (a directory crawl, say) outranks the whole bot.
+ *
+ * LRU_POLICY_2Q: bot is the fifo of items seen once (2Q's A1in), top the
+ *   lru of items seen again (Am).  once we are full, touching an item in
+ *   bot does not move it; an item only reaches top if it is inserted again
+ *   shortly after being expired from bot, which the ghost list (A1out:
+ *   keys only, up to lru_max/2) remembers.  bot is expired first while it holds more than
+ *   1 - lru_midpoint of the items, so a crawl recycles bot and leaves top
+ *   alone.
+ */
+enum {
+  LRU_POLICY_MIDPOINT = 0,
+  LRU_POLICY_2Q = 1,
+};
+
 class LRU {
  protected:
   LRUList lru_top, lru_bot, lru_pintail;
   uint32_t lru_num, lru_num_pinned;
   uint32_t lru_max;   // max items
   double lru_midpoint;
+  int lru_policy;
+
+  // LRU_POLICY_2Q ghosts, newest first
+  std::list<uint64_t> lru_ghost;
+  ceph::unordered_map<uint64_t, std::list<uint64_t>::iterator> lru_ghost_map;
 
   friend class LRUObject;
   //friend class MDCache; // hack
+
+  void lru_ghost_trim() {
+    while (lru_ghost.size() > lru_max / 2) {
+      lru_ghost_map.erase(lru_ghost.back());
+      lru_ghost.pop_back();
+    }
+  }
+
+  void lru_ghost_add(uint64_t key) {
+    if (!key)
+      return;
+    ceph::unordered_map<uint64_t, std::list<uint64_t>::iterator>::iterator p =
+      lru_ghost_map.find(key);
+    if (p != lru_ghost_map.end())
+      lru_ghost.erase(p->second);
+    lru_ghost.push_front(key);
+    lru_ghost_map[key] = lru_ghost.begin();
+    lru_ghost_trim();
+  }
+
+  bool lru_ghost_take(uint64_t key) {
+    if (!key)
+      return false;
+    ceph::unordered_map<uint64_t, std::list<uint64_t>::iterator>::iterator p =
+      lru_ghost_map.find(key);
+    if (p == lru_ghost_map.end())
+      return false;
+    lru_ghost.erase(p->second);
+    lru_ghost_map.erase(p);
+    return true;
+  }
+
+  // unpinned tail of l, moving pinned items to the pintail on the way
+  LRUObject *lru_get_next_expire(LRUList& l) {
+    while (l.get_length()) {
+      LRUObject *p = l.get_tail();
+      if (!p->lru_pinned) return p;
+
+      // move to pintail
+      l.remove(p);
+      lru_pintail.insert_head(p);
+    }
+    return NULL;
+  }
   
  public:
   LRU(int max = 0) {
@@ -134,6 +210,7 @@ class LRU {
     lru_num_pinned = 0;
     lru_midpoint = .6;
     lru_max = max;
+    lru_policy = LRU_POLICY_MIDPOINT;
   }
 
   uint32_t lru_get_size() { return lru_num; }
@@ -142,15 +219,27 @@ class LRU {
   uint32_t lru_get_pintail() { return lru_pintail.get_length(); }
   uint32_t lru_get_max() { return lru_max; }
   uint32_t lru_get_num_pinned() { return lru_num_pinned; }
+  uint32_t lru_get_ghosts() { return lru_ghost.size(); }
+  int lru_get_policy() { return lru_policy; }
 
-  void lru_set_max(uint32_t m) { lru_max = m; }
+  void lru_set_max(uint32_t m) {
+    lru_max = m;
+    lru_ghost_trim();
+  }
   void lru_set_midpoint(float f) { lru_midpoint = f; }
+  // set while empty
+  void lru_set_policy(int p) {
+    assert(lru_num == 0);
+    lru_policy = p;
+  }
   
   void lru_clear() {
     lru_top.clear();
     lru_bot.clear();
     lru_pintail.clear();
     lru_num = 0;
+    lru_ghost.clear();
+    lru_ghost_map.clear();
   }
 
   // insert at top of lru
@@ -165,15 +254,21 @@ class LRU {
     lru_adjust();
   }
 
-  // insert at mid point in lru
-  void lru_insert_mid(LRUObject *o) {
+  // insert at mid point in lru.  under LRU_POLICY_2Q an item expired
+  // recently goes to the top instead, and we return true.
+  bool lru_insert_mid(LRUObject *o) {
     //assert(!o->lru_in_lru);
     //o->lru_in_lru = true;
+    if (lru_policy == LRU_POLICY_2Q && lru_ghost_take(o->lru_key)) {
+      lru_insert_top(o);
+      return true;
+    }
     assert(!o->lru);
     o->lru = this;
     lru_bot.insert_head(o);
     lru_num++;
     if (o->lru_pinned) lru_num_pinned++;
+    return false;
   }
 
   // insert at bottom of lru
@@ -205,6 +300,7 @@ class LRU {
   // adjust top/bot balance, as necessary
   void lru_adjust() {
     if (!lru_max) return;
+    if (lru_policy == LRU_POLICY_2Q) return;  // top and bot are sized by expiry
 
     unsigned toplen = lru_top.get_length();
     unsigned topwant = (unsigned)(lru_midpoint * ((double)lru_max - lru_num_pinned));
@@ -239,8 +335,12 @@ class LRU {
     return o;
   }
 
-  // touch item -- move to head of lru
+  // touch item -- move to head of lru (2Q: unless it has only been seen
+  // once and we are full)
   bool lru_touch(LRUObject *o) {
+    if (lru_policy == LRU_POLICY_2Q && o->lru_list == &lru_bot &&
+	lru_num >= lru_max)
+      return false;
     lru_remove(o);
     lru_insert_top(o);
     return true;
@@ -275,26 +375,21 @@ class LRU {
   // expire -- expire a single item
   LRUObject *lru_get_next_expire() {
     LRUObject *p;
-    
-    // look through tail of bot
-    while (lru_bot.get_length()) {
-      p = lru_bot.get_tail();
-      if (!p->lru_pinned) return p;
 
-      // move to pintail
-      lru_bot.remove(p);
-      lru_pintail.insert_head(p);
+    if (lru_policy == LRU_POLICY_2Q && lru_bot.get_length() <=
+	(unsigned)((1.0 - lru_midpoint) * ((double)lru_max - lru_num_pinned))) {
+      // bot is within its share; keep it, take from the top
+      p = lru_get_next_expire(lru_top);
+      if (p) return p;
     }
+    
+    // look through tail of bot
+    p = lru_get_next_expire(lru_bot);
+    if (p) return p;
 
     // ok, try head then
-    while (lru_top.get_length()) {
-      p = lru_top.get_tail();
-      if (!p->lru_pinned) return p;
-
-      // move to pintail
-      lru_top.remove(p);
-      lru_pintail.insert_head(p);
-    }
+    p = lru_get_next_expire(lru_top);
+    if (p) return p;
     
     // no luck!
     return NULL;
@@ -302,8 +397,11 @@ class LRU {
   
   LRUObject *lru_expire() {
     LRUObject *p = lru_get_next_expire();
-    if (p) 
+    if (p) {
+      if (lru_policy == LRU_POLICY_2Q && p->lru_list == &lru_bot)
+	lru_ghost_add(p->lru_key);
       return lru_remove(p);
+    }
     return NULL;
   }
 
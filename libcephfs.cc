@@ -493,6 +493,16 @@ extern "C" int ceph_readdirplus_r(struct ceph_mount_info *cmount, struct ceph_di
   return cmount->get_client()->readdirplus_r(reinterpret_cast<dir_result_t*>(dirp), de, st, stmask);
 }
 
+extern "C" int ceph_readdirplus_batch(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp,
+				      struct dirent *de, struct stat *st, int *stmask, int max,
+				      int prefetch)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  return cmount->get_client()->readdirplus_batch(reinterpret_cast<dir_result_t*>(dirp),
+						 de, st, stmask, max, prefetch != 0);
+}
+
 extern "C" int ceph_getdents(struct ceph_mount_info *cmount, struct ceph_dir_result *dirp,
 			     char *buf, int buflen)
 {
@@ -609,6 +619,35 @@ extern "C" int ceph_lstat(struct ceph_mount_info *cmount, const char *path,
   return cmount->get_client()->lstat(path, stbuf);
 }
 
+extern "C" int ceph_stat_cached(struct ceph_mount_info *cmount, uint64_t ino,
+				struct stat *stbuf)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  return cmount->get_client()->stat_cached(ino, stbuf);
+}
+
+extern "C" int ceph_stat_cached_path(struct ceph_mount_info *cmount,
+				     const char *path, struct stat *stbuf)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  return cmount->get_client()->stat_cached(path, stbuf);
+}
+
+extern "C" int ceph_stat_xattr_version(struct ceph_mount_info *cmount,
+				       const char *path, struct stat *stbuf,
+				       uint64_t *xattr_version)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  version_t v;
+  int r = cmount->get_client()->stat_xattr_version(path, stbuf, &v);
+  if (r == 0)
+    *xattr_version = v;
+  return r;
+}
+
 extern "C" int ceph_setattr(struct ceph_mount_info *cmount, const char *relpath,
 			    struct stat *attr, int mask)
 {
@@ -783,6 +822,42 @@ extern "C" int ceph_write(struct ceph_mount_info *cmount, int fd, const char *bu
   return cmount->get_client()->write(fd, buf, size, offset);
 }
 
+class C_AioCallback : public Context {
+  ceph_aio_callback_t cb;
+  void *arg;
+public:
+  C_AioCallback(ceph_aio_callback_t c, void *a) : cb(c), arg(a) {}
+  void finish(int r) {
+    cb(arg, r);
+  }
+};
+
+extern "C" int ceph_aio_read(struct ceph_mount_info *cmount, int fd, char *buf,
+			     int64_t size, int64_t offset,
+			     ceph_aio_callback_t cb, void *arg)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  Context *onfinish = new C_AioCallback(cb, arg);
+  int r = cmount->get_client()->aio_read(fd, buf, size, offset, onfinish);
+  if (r < 0)
+    delete onfinish;
+  return r;
+}
+
+extern "C" int ceph_aio_write(struct ceph_mount_info *cmount, int fd, const char *buf,
+			      int64_t size, int64_t offset,
+			      ceph_aio_callback_t cb, void *arg)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  Context *onfinish = new C_AioCallback(cb, arg);
+  int r = cmount->get_client()->aio_write(fd, buf, size, offset, onfinish);
+  if (r < 0)
+    delete onfinish;
+  return r;
+}
+
 extern "C" int ceph_ftruncate(struct ceph_mount_info *cmount, int fd, int64_t size)
 {
   if (!cmount->is_mounted())
@@ -797,6 +872,13 @@ extern "C" int ceph_fsync(struct ceph_mount_info *cmount, int fd, int syncdataon
   return cmount->get_client()->fsync(fd, syncdataonly);
 }
 
+extern "C" int ceph_fadvise(struct ceph_mount_info *cmount, int fd, int hints)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  return cmount->get_client()->fadvise(fd, hints);
+}
+
 extern "C" int ceph_fallocate(struct ceph_mount_info *cmount, int fd, int mode,
 	                      int64_t offset, int64_t length)
 {
@@ -1251,21 +1333,21 @@ extern "C" int ceph_get_pool_replication(struct ceph_mount_info *cmount,
 }
 /* Low-level exports */
 
-//by ketor extern "C" int ceph_ll_lookup_root(struct ceph_mount_info *cmount,
-//                  Inode **parent)
-//{
-//  *parent = cmount->get_client()->get_root();
-//  if (*parent)
-//    return 0;
-//  return EFAULT;
-//}
-//
-//extern "C" struct Inode *ceph_ll_get_inode(class ceph_mount_info *cmount,
-//					   vinodeno_t vino)
-//{
-//  return (cmount->get_client())->ll_get_inode(vino);
-//}
-//
+extern "C" int ceph_ll_lookup_root(struct ceph_mount_info *cmount,
+                  Inode **parent)
+{
+  *parent = cmount->get_client()->get_root();
+  if (*parent)
+    return 0;
+  return -EFAULT;
+}
+
+extern "C" struct Inode *ceph_ll_get_inode(class ceph_mount_info *cmount,
+					   vinodeno_t vino)
+{
+  return (cmount->get_client())->ll_get_inode(vino);
+}
+
 //
 ///**
 // * Populates the client cache with the requested inode, and its
@@ -1310,68 +1392,68 @@ extern "C" int ceph_get_pool_replication(struct ceph_mount_info *cmount,
 //  (cmount->get_client())->ll_forget(parent, 1);
 //  return 0;
 //}
-//
-//extern "C" int ceph_ll_lookup(class ceph_mount_info *cmount,
-//			      struct Inode *parent, const char *name,
-//			      struct stat *attr, Inode **out,
-//			      int uid, int gid)
-//{
-//  return (cmount->get_client())->ll_lookup(parent, name, attr, out, uid, gid);
-//}
-//
-//extern "C" int ceph_ll_put(class ceph_mount_info *cmount, Inode *in)
-//{
-//  return (cmount->get_client()->ll_put(in));
-//}
-//
-//extern "C" int ceph_ll_forget(class ceph_mount_info *cmount, Inode *in,
-//			      int count)
-//{
-//  return (cmount->get_client()->ll_forget(in, count));
-//}
-//
-//extern "C" int ceph_ll_walk(class ceph_mount_info *cmount, const char *name,
-//			    struct Inode **i,
-//			    struct stat *attr)
-//{
-//  return(cmount->get_client()->ll_walk(name, i, attr));
-//}
-//
-//extern "C" int ceph_ll_getattr(class ceph_mount_info *cmount,
-//			       Inode *in, struct stat *attr,
-//			       int uid, int gid)
-//{
-//  return (cmount->get_client()->ll_getattr(in, attr, uid, gid));
-//}
-//
-//extern "C" int ceph_ll_setattr(class ceph_mount_info *cmount,
-//			       Inode *in, struct stat *st,
-//			       int mask, int uid, int gid)
-//{
-//  return (cmount->get_client()->ll_setattr(in, st, mask, uid, gid));
-//}
-//
-//extern "C" int ceph_ll_open(class ceph_mount_info *cmount, Inode *in,
-//			    int flags, Fh **fh, int uid, int gid)
-//{
-//  return (cmount->get_client()->ll_open(in, flags, fh, uid, gid));
-//}
-//
-//extern "C" int ceph_ll_read(class ceph_mount_info *cmount, Fh* filehandle,
-//			    int64_t off, uint64_t len, char* buf)
-//{
-//  bufferlist bl;
-//  int r = 0;
-//
-//  r = cmount->get_client()->ll_read(filehandle, off, len, &bl);
-//  if (r >= 0)
-//    {
-//      bl.copy(0, bl.length(), buf);
-//      r = bl.length();
-//    }
-//  return r;
-//}
-//
+
+extern "C" int ceph_ll_lookup(class ceph_mount_info *cmount,
+			      struct Inode *parent, const char *name,
+			      struct stat *attr, Inode **out,
+			      int uid, int gid)
+{
+  return (cmount->get_client())->ll_lookup(parent, name, attr, out, uid, gid);
+}
+
+extern "C" int ceph_ll_put(class ceph_mount_info *cmount, Inode *in)
+{
+  return (cmount->get_client()->ll_put(in));
+}
+
+extern "C" int ceph_ll_forget(class ceph_mount_info *cmount, Inode *in,
+			      int count)
+{
+  return (cmount->get_client()->ll_forget(in, count));
+}
+
+extern "C" int ceph_ll_walk(class ceph_mount_info *cmount, const char *name,
+			    struct Inode **i,
+			    struct stat *attr)
+{
+  return(cmount->get_client()->ll_walk(name, i, attr));
+}
+
+extern "C" int ceph_ll_getattr(class ceph_mount_info *cmount,
+			       Inode *in, struct stat *attr,
+			       int uid, int gid)
+{
+  return (cmount->get_client()->ll_getattr(in, attr, uid, gid));
+}
+
+extern "C" int ceph_ll_setattr(class ceph_mount_info *cmount,
+			       Inode *in, struct stat *st,
+			       int mask, int uid, int gid)
+{
+  return (cmount->get_client()->ll_setattr(in, st, mask, uid, gid));
+}
+
+extern "C" int ceph_ll_open(class ceph_mount_info *cmount, Inode *in,
+			    int flags, Fh **fh, int uid, int gid)
+{
+  return (cmount->get_client()->ll_open(in, flags, fh, uid, gid));
+}
+
+extern "C" int ceph_ll_read(class ceph_mount_info *cmount, Fh* filehandle,
+			    int64_t off, uint64_t len, char* buf)
+{
+  bufferlist bl;
+  int r = 0;
+
+  r = cmount->get_client()->ll_read(filehandle, off, len, &bl);
+  if (r >= 0)
+    {
+      bl.copy(0, bl.length(), buf);
+      r = bl.length();
+    }
+  return r;
+}
+
 //extern "C" int ceph_ll_read_block(class ceph_mount_info *cmount,
 //				  Inode *in, uint64_t blockid,
 //				  char* buf, uint64_t offset,
@@ -1400,26 +1482,26 @@ extern "C" int ceph_get_pool_replication(struct ceph_mount_info *cmount,
 //{
 //  return (cmount->get_client()->ll_commit_blocks(in, offset, range));
 //}
-//
-//extern "C" int ceph_ll_fsync(class ceph_mount_info *cmount,
-//			     Fh *fh, int syncdataonly)
-//{
-//  return (cmount->get_client()->ll_fsync(fh, syncdataonly));
-//}
-//
-//extern "C" loff_t ceph_ll_lseek(class ceph_mount_info *cmount,
-//				Fh *fh, loff_t offset, int whence)
-//{
-//  return (cmount->get_client()->ll_lseek(fh, offset, whence));
-//}
-//
-//extern "C" int ceph_ll_write(class ceph_mount_info *cmount,
-//			     Fh *fh, int64_t off, uint64_t len,
-//			     const char *data)
-//{
-//  return (cmount->get_client()->ll_write(fh, off, len, data));
-//}
-//
+
+extern "C" int ceph_ll_fsync(class ceph_mount_info *cmount,
+			     Fh *fh, int syncdataonly)
+{
+  return (cmount->get_client()->ll_fsync(fh, syncdataonly));
+}
+
+extern "C" loff_t ceph_ll_lseek(class ceph_mount_info *cmount,
+				Fh *fh, loff_t offset, int whence)
+{
+  return (cmount->get_client()->ll_lseek(fh, offset, whence));
+}
+
+extern "C" int ceph_ll_write(class ceph_mount_info *cmount,
+			     Fh *fh, int64_t off, uint64_t len,
+			     const char *data)
+{
+  return (cmount->get_client()->ll_write(fh, off, len, data));
+}
+
 //extern "C" int64_t ceph_ll_readv(class ceph_mount_info *cmount,
 //				 struct Fh *fh, const struct iovec *iov,
 //				 int iovcnt, int64_t off)
@@ -1433,12 +1515,12 @@ extern "C" int ceph_get_pool_replication(struct ceph_mount_info *cmount,
 //{
 //  return -1; // TODO:  implement
 //}
-//
-//extern "C" int ceph_ll_close(class ceph_mount_info *cmount, Fh* fh)
-//{
-//  return (cmount->get_client()->ll_release(fh));
-//}
-//
+
+extern "C" int ceph_ll_close(class ceph_mount_info *cmount, Fh* fh)
+{
+  return (cmount->get_client()->ll_release(fh));
+}
+
 //extern "C" int ceph_ll_create(class ceph_mount_info *cmount,
 //			      struct Inode *parent, const char *name,
 //			      mode_t mode, int flags, struct stat *attr,
@@ -1465,34 +1547,34 @@ extern "C" int ceph_get_pool_replication(struct ceph_mount_info *cmount,
 //  return (cmount->get_client()->ll_link(in, newparent, name, attr, uid,
 //					gid));
 //}
-//
-//extern "C" int ceph_ll_truncate(class ceph_mount_info *cmount,
-//				Inode *in, uint64_t length, int uid,
-//				int gid)
-//{
-//  struct stat st;
-//  st.st_size=length;
-//
-//  return(cmount->get_client()->ll_setattr(in, &st, CEPH_SETATTR_SIZE, uid,
-//					  gid));
-//}
-//
-//extern "C" int ceph_ll_opendir(class ceph_mount_info *cmount,
-//			       Inode *in,
-//			       struct ceph_dir_result **dirpp,
-//			       int uid, int gid)
-//{
-//  return (cmount->get_client()->ll_opendir(in, (dir_result_t**) dirpp, uid,
-//					   gid));
-//}
-//
-//extern "C" int ceph_ll_releasedir(class ceph_mount_info *cmount,
-//				  ceph_dir_result *dir)
-//{
-//  (void) cmount->get_client()->ll_releasedir((dir_result_t*) dir);
-//  return (0);
-//}
-//
+
+extern "C" int ceph_ll_truncate(class ceph_mount_info *cmount,
+				Inode *in, uint64_t length, int uid,
+				int gid)
+{
+  struct stat st;
+  st.st_size=length;
+
+  return(cmount->get_client()->ll_setattr(in, &st, CEPH_SETATTR_SIZE, uid,
+					  gid));
+}
+
+extern "C" int ceph_ll_opendir(class ceph_mount_info *cmount,
+			       Inode *in,
+			       struct ceph_dir_result **dirpp,
+			       int uid, int gid)
+{
+  return (cmount->get_client()->ll_opendir(in, (dir_result_t**) dirpp, uid,
+					   gid));
+}
+
+extern "C" int ceph_ll_releasedir(class ceph_mount_info *cmount,
+				  ceph_dir_result *dir)
+{
+  (void) cmount->get_client()->ll_releasedir((dir_result_t*) dir);
+  return (0);
+}
+
 //extern "C" int ceph_ll_rename(class ceph_mount_info *cmount,
 //			      Inode *parent, const char *name,
 //			      Inode *newparent, const char *newname,
@@ -1508,13 +1590,13 @@ extern "C" int ceph_get_pool_replication(struct ceph_mount_info *cmount,
 //{
 //  return (cmount->get_client()->ll_unlink(in, name, uid, gid));
 //}
-//
-//extern "C" int ceph_ll_statfs(class ceph_mount_info *cmount,
-//			      Inode *in, struct statvfs *stbuf)
-//{
-//  return (cmount->get_client()->ll_statfs(in, stbuf));
-//}
-//
+
+extern "C" int ceph_ll_statfs(class ceph_mount_info *cmount,
+			      Inode *in, struct statvfs *stbuf)
+{
+  return (cmount->get_client()->ll_statfs(in, stbuf));
+}
+
 //extern "C" int ceph_ll_readlink(class ceph_mount_info *cmount,
 //				Inode *in, char *buf, size_t bufsiz, int uid,
 //				int gid)
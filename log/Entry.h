@@ -9,7 +9,8 @@
 #include <pthread.h>
 #include <string>
 
-#define CEPH_LOG_ENTRY_PREALLOC 80
+// sized so that most lines never overflow onto the heap
+#define CEPH_LOG_ENTRY_PREALLOC 256
 
 namespace ceph {
 namespace log {
@@ -42,6 +43,16 @@ struct Entry {
     }
   }
 
+  /// reinitialize a recycled entry
+  void reset(utime_t s, pthread_t t, short pr, short sub) {
+    m_stamp = s;
+    m_thread = t;
+    m_prio = pr;
+    m_subsys = sub;
+    m_next = NULL;
+    m_streambuf.reset();
+  }
+
   void set_str(const std::string &s) {
     ostream os(&m_streambuf);
     os << s;
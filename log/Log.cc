@@ -21,6 +21,9 @@
 
 #define PREALLOC 1000000
 
+// flush formatted lines to the log file in writes of about this size
+#define LOG_WRITE_BATCH (64 << 10)
+
 namespace ceph {
 namespace log {
 
@@ -37,7 +40,9 @@ static void log_on_exit(void *p)
 Log::Log(SubsystemMap *s)
   : m_indirect_this(NULL),
     m_subs(s),
-    m_new(), m_recent(),
+    m_new_head(NULL), m_loggers_waiting(0),
+    m_recent(),
+    m_next_pool(0),
     m_fd(-1),
     m_syslog_log(-2), m_syslog_crash(-2),
     m_stderr_log(1), m_stderr_crash(-1),
@@ -62,6 +67,13 @@ Log::Log(SubsystemMap *s)
   ret = pthread_cond_init(&m_cond_flusher, NULL);
   assert(ret == 0);
 
+  for (unsigned i = 0; i < NUM_POOLS; i++) {
+    ret = pthread_mutex_init(&m_pools[i].lock, NULL);
+    assert(ret == 0);
+  }
+  ret = pthread_key_create(&m_pool_key, NULL);
+  assert(ret == 0);
+
   // kludge for prealloc testing
   if (false)
     for (int i=0; i < PREALLOC; i++)
@@ -75,6 +87,11 @@ Log::~Log()
   }
 
   assert(!is_started());
+  while (m_new_head) {
+    Entry *e = m_new_head;
+    m_new_head = e->m_next;
+    delete e;
+  }
   if (m_fd >= 0)
     VOID_TEMP_FAILURE_RETRY(::close(m_fd));
 
@@ -82,6 +99,9 @@ Log::~Log()
   pthread_mutex_destroy(&m_flush_mutex);
   pthread_cond_destroy(&m_cond_loggers);
   pthread_cond_destroy(&m_cond_flusher);
+  for (unsigned i = 0; i < NUM_POOLS; i++)
+    pthread_mutex_destroy(&m_pools[i].lock);
+  pthread_key_delete(m_pool_key);
 }
 
 
@@ -143,56 +163,129 @@ void Log::set_stderr_level(int log, int crash)
 
 void Log::submit_entry(Entry *e)
 {
-  pthread_mutex_lock(&m_queue_mutex);
-  m_queue_mutex_holder = pthread_self();
-
   if (m_inject_segv)
     *(int *)(0) = 0xdead;
 
-  // wait for flush to catch up
-  while (m_new.m_len > m_max_new)
-    pthread_cond_wait(&m_cond_loggers, &m_queue_mutex);
+  // count before pushing, so the flusher never takes more than we counted
+  int len = m_new_len.inc();
+
+  Entry *head = __atomic_load_n(&m_new_head, __ATOMIC_RELAXED);
+  do {
+    e->m_next = head;
+  } while (!__atomic_compare_exchange_n(&m_new_head, &head, e, true,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  // only the entry that found the list empty needs to wake the flusher;
+  // if it is busy it will look at the list again before sleeping.
+  if (head == NULL || len > m_max_new) {
+    pthread_mutex_lock(&m_queue_mutex);
+    m_queue_mutex_holder = pthread_self();
+    pthread_cond_signal(&m_cond_flusher);
+
+    // wait for flush to catch up
+    while ((int)m_new_len.read() > m_max_new && !m_stop) {
+      m_loggers_waiting++;
+      pthread_cond_wait(&m_cond_loggers, &m_queue_mutex);
+      m_loggers_waiting--;
+    }
+    m_queue_mutex_holder = 0;
+    pthread_mutex_unlock(&m_queue_mutex);
+  }
+}
 
-  m_new.enqueue(e);
-  pthread_cond_signal(&m_cond_flusher);
-  m_queue_mutex_holder = 0;
-  pthread_mutex_unlock(&m_queue_mutex);
+bool Log::_have_new() const
+{
+  return __atomic_load_n(&m_new_head, __ATOMIC_ACQUIRE) != NULL;
+}
+
+void Log::_take_new(EntryQueue *q)
+{
+  Entry *e = __atomic_exchange_n(&m_new_head, (Entry *)NULL, __ATOMIC_ACQUIRE);
+
+  // the list is newest first; reverse it back into submission order
+  Entry *oldest = NULL;
+  int n = 0;
+  while (e) {
+    Entry *next = e->m_next;
+    e->m_next = oldest;
+    oldest = e;
+    e = next;
+    n++;
+  }
+  while (oldest) {
+    Entry *next = oldest->m_next;
+    oldest->m_next = NULL;
+    q->enqueue(oldest);
+    oldest = next;
+  }
+  m_new_len.sub(n);
+}
+
+/*
+ * the pool this thread allocates from.  threads are dealt pools round
+ * robin the first time they log; pthread_t itself is no use for this,
+ * being a small sequential id with winpthreads and an aligned pointer
+ * with glibc.
+ */
+unsigned Log::_thread_pool()
+{
+  uintptr_t slot = (uintptr_t)pthread_getspecific(m_pool_key);
+  if (!slot) {
+    slot = m_thread_pools.inc();  // from 1; 0 means unassigned
+    pthread_setspecific(m_pool_key, (void *)slot);
+  }
+  return slot % NUM_POOLS;
 }
 
 Entry *Log::create_entry(int level, int subsys)
 {
-  if (true) {
-    return new Entry(ceph_clock_now(NULL),
-		   pthread_self(),
-		   level, subsys);
-  } else {
-    // kludge for perf testing
-    Entry *e = m_recent.dequeue();
-    e->m_stamp = ceph_clock_now(NULL);
-    e->m_thread = pthread_self();
-    e->m_prio = level;
-    e->m_subsys = subsys;
+  pthread_t self = pthread_self();
+  EntryPool& pool = m_pools[_thread_pool()];
+  pthread_mutex_lock(&pool.lock);
+  Entry *e = pool.free.dequeue();
+  pthread_mutex_unlock(&pool.lock);
+  if (e) {
+    e->reset(ceph_clock_now(NULL), self, level, subsys);
     return e;
   }
+  return new Entry(ceph_clock_now(NULL), self, level, subsys);
+}
+
+void Log::_recycle(EntryQueue *q)
+{
+  // spread the entries over the pools, up to m_max_new in all; whatever
+  // is left is freed along with q
+  unsigned per_pool = (m_max_new + NUM_POOLS - 1) / NUM_POOLS;
+  for (unsigned i = 0; i < NUM_POOLS && !q->empty(); i++) {
+    EntryPool& pool = m_pools[m_next_pool];
+    m_next_pool = (m_next_pool + 1) % NUM_POOLS;
+    pthread_mutex_lock(&pool.lock);
+    while ((unsigned)pool.free.m_len < per_pool && !q->empty())
+      pool.free.enqueue(q->dequeue());
+    pthread_mutex_unlock(&pool.lock);
+  }
 }
 
 void Log::flush()
 {
   pthread_mutex_lock(&m_flush_mutex);
   m_flush_mutex_holder = pthread_self();
+  EntryQueue t;
+  _take_new(&t);
   pthread_mutex_lock(&m_queue_mutex);
   m_queue_mutex_holder = pthread_self();
-  EntryQueue t;
-  t.swap(m_new);
-  pthread_cond_broadcast(&m_cond_loggers);
+  if (m_loggers_waiting)
+    pthread_cond_broadcast(&m_cond_loggers);
   m_queue_mutex_holder = 0;
   pthread_mutex_unlock(&m_queue_mutex);
   _flush(&t, &m_recent, false);
 
-  // trim
+  // trim, recycling what we trimmed
+  EntryQueue trimmed;
   while (m_recent.m_len > m_max_recent) {
-    delete m_recent.dequeue();
+    trimmed.enqueue(m_recent.dequeue());
   }
+  _recycle(&trimmed);
 
   m_flush_mutex_holder = 0;
   pthread_mutex_unlock(&m_flush_mutex);
@@ -223,13 +316,11 @@ void Log::_flush(EntryQueue *t, EntryQueue *requeue, bool crash)
       string s = e->get_str();
 
       if (do_fd) {
-	int r = safe_write(m_fd, buf, buflen);
-	if (r >= 0)
-	  r = safe_write(m_fd, s.data(), s.size());
-	if (r >= 0)
-	  r = write(m_fd, "\n", 1);
-	if (r < 0)
-	  cerr << "problem writing to " << m_log_file << ": " << cpp_strerror(r) << std::endl;
+	m_log_buf.append(buf, buflen);
+	m_log_buf.append(s);
+	m_log_buf.push_back('\n');
+	if (m_log_buf.size() >= LOG_WRITE_BATCH)
+	  _write_log_buf();
       }
 
       if (do_syslog) {
@@ -244,6 +335,17 @@ void Log::_flush(EntryQueue *t, EntryQueue *requeue, bool crash)
 
     requeue->enqueue(e);
   }
+  _write_log_buf();
+}
+
+void Log::_write_log_buf()
+{
+  if (m_log_buf.empty())
+    return;
+  int r = safe_write(m_fd, m_log_buf.data(), m_log_buf.size());
+  if (r < 0)
+    cerr << "problem writing to " << m_log_file << ": " << cpp_strerror(r) << std::endl;
+  m_log_buf.clear();
 }
 
 void Log::_log_message(const char *s, bool crash)
@@ -270,14 +372,8 @@ void Log::dump_recent()
   pthread_mutex_lock(&m_flush_mutex);
   m_flush_mutex_holder = pthread_self();
 
-  pthread_mutex_lock(&m_queue_mutex);
-  m_queue_mutex_holder = pthread_self();
-
   EntryQueue t;
-  t.swap(m_new);
-
-  m_queue_mutex_holder = 0;
-  pthread_mutex_unlock(&m_queue_mutex);
+  _take_new(&t);
   _flush(&t, &m_recent, false);
 
   EntryQueue old;
@@ -335,7 +431,7 @@ void *Log::entry()
   pthread_mutex_lock(&m_queue_mutex);
   m_queue_mutex_holder = pthread_self();
   while (!m_stop) {
-    if (!m_new.empty()) {
+    if (_have_new()) {
       m_queue_mutex_holder = 0;
       pthread_mutex_unlock(&m_queue_mutex);
       flush();
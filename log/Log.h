@@ -5,6 +5,7 @@
 #define __CEPH_LOG_LOG_H
 
 #include "common/Thread.h"
+#include "include/atomic.h"
 
 #include <pthread.h>
 
@@ -29,9 +30,36 @@ class Log : private Thread
   pthread_t m_queue_mutex_holder;
   pthread_t m_flush_mutex_holder;
 
-  EntryQueue m_new;    ///< new entries
+  /**
+   * new entries.  submitters push onto this list (newest first) with a
+   * compare-and-swap, so logging never takes m_queue_mutex unless the
+   * flusher needs waking or m_max_new is exceeded.  the flusher takes
+   * the whole list at once.
+   */
+  Entry *m_new_head;
+  atomic_t m_new_len;       ///< entries pushed and not yet taken
+  int m_loggers_waiting;    ///< submitters throttled on m_max_new
+
   EntryQueue m_recent; ///< recent (less new) entries we've already written at low detail
 
+  std::string m_log_buf;    ///< formatted lines waiting for one write to m_fd
+
+  /**
+   * recycled entries.  the flusher hands back what it trims from
+   * m_recent instead of deleting it, and create_entry takes from here
+   * before allocating.  sharded by thread so loggers rarely contend;
+   * at most m_max_new entries are kept in all.
+   */
+  struct EntryPool {
+    pthread_mutex_t lock;
+    EntryQueue free;
+  };
+  static const unsigned NUM_POOLS = 8;
+  EntryPool m_pools[NUM_POOLS];
+  unsigned m_next_pool;     ///< where the flusher recycles to next (flush lock)
+  pthread_key_t m_pool_key; ///< each thread's pool, see _thread_pool()
+  atomic_t m_thread_pools;  ///< threads dealt a pool so far
+
   std::string m_log_file;
   int m_fd;
 
@@ -46,7 +74,12 @@ class Log : private Thread
 
   void *entry();
 
+  bool _have_new() const;
+  void _take_new(EntryQueue *q);
   void _flush(EntryQueue *q, EntryQueue *requeue, bool crash);
+  void _write_log_buf();
+  void _recycle(EntryQueue *q);
+  unsigned _thread_pool();
 
   void _log_message(const char *s, bool crash);
 
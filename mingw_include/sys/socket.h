@@ -1,5 +1,30 @@
+#ifndef CEPH_MINGW_SYS_SOCKET_H
+#define CEPH_MINGW_SYS_SOCKET_H
 #include <winsock2.h>
 #include <ws2tcpip.h> // for struct sockaddr_storage
 #define _SS_MAXSIZE 128                 /* Maximum size. */
 #define SHUT_RDWR SD_BOTH
 #define MSG_NOSIGNAL
+
+struct iovec;
+
+/* Structure describing messages sent by
+   `sendmsg' and received by `recvmsg'.  */
+struct msghdr
+  {
+    void *msg_name;             /* Address to send to/receive from.  */
+    socklen_t msg_namelen;      /* Length of address data.  */
+
+    struct iovec *msg_iov;	/* Vector of data to send/receive into.  */
+    size_t msg_iovlen;          /* Number of elements in the vector.  */
+
+    void *msg_control;          /* Ancillary data (eg BSD filedesc passing). */
+    size_t msg_controllen;	/* Ancillary data buffer length.
+                                   !! The type should be socklen_t but the
+                                   definition of the kernel is incompatible
+                                   with this.  */
+
+    int msg_flags;              /* Flags on received message.  */
+  };
+
+#endif
@@ -5,7 +5,7 @@
 #include "Messenger.h"
 
 #include "msg/simple/SimpleMessenger.h"
-//by ketor #include "../msg/async/AsyncMessenger.h"
+#include "msg/async/AsyncMessenger.h"
 #ifdef HAVE_XIO
 #include "msg/xio/XioMessenger.h"
 #endif
@@ -19,9 +19,9 @@ Messenger *Messenger::create(CephContext *cct, const string &type,
     r = rand() % 2; // random does not include xio
   if (r == 0 || type == "simple")
     return new SimpleMessenger(cct, name, lname, nonce);
-//  else if ((r == 1 || type == "async") &&
-//	   cct->check_experimental_feature_enabled("ms-type-async"))
-//    return new AsyncMessenger(cct, name, lname, nonce);
+  else if ((r == 1 || type == "async") &&
+	   cct->check_experimental_feature_enabled("ms-type-async"))
+    return new AsyncMessenger(cct, name, lname, nonce);
 #ifdef HAVE_XIO
   else if ((type == "xio") &&
 	   cct->check_experimental_feature_enabled("ms-type-xio"))
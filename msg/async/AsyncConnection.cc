@@ -22,6 +22,7 @@
 #include "common/errno.h"
 #include "AsyncMessenger.h"
 #include "AsyncConnection.h"
+#include "net_handler.h"
 
 // Constant to limit starting sequence number to 2^31.  Nothing special about it, just a big number.  PLR
 #define SEQ_MASK  0x7fffffff 
@@ -145,13 +146,14 @@ AsyncConnection::~AsyncConnection()
  * return 0 means EAGAIN or EINTR */
 int AsyncConnection::read_bulk(int fd, char *buf, int len)
 {
-  int nread = ::read(fd, buf, len);
+  int nread = ::recv(fd, buf, len, 0);
   if (nread == -1) {
-    if (errno == EAGAIN || errno == EINTR) {
+    int err = ceph::net_errno();
+    if (err == EAGAIN || err == EINTR) {
       nread = 0;
     } else {
       ldout(async_msgr->cct, 1) << __func__ << " Reading from fd=" << fd
-                          << " : "<< strerror(errno) << dendl;
+                          << " : "<< cpp_strerror(err) << dendl;
       return -1;
     }
   } else if (nread == 0) {
@@ -167,15 +169,29 @@ int AsyncConnection::read_bulk(int fd, char *buf, int len)
 int AsyncConnection::do_sendmsg(struct msghdr &msg, int len, bool more)
 {
   while (len > 0) {
+#ifdef _WIN32
+    // no sendmsg in winsock; WSASend takes the same gather list
+    WSABUF bufs[msg.msg_iovlen];
+    for (size_t i = 0; i < msg.msg_iovlen; i++) {
+      bufs[i].buf = (char *)msg.msg_iov[i].iov_base;
+      bufs[i].len = msg.msg_iov[i].iov_len;
+    }
+    DWORD sent = 0;
+    int r = ::WSASend(sd, bufs, msg.msg_iovlen, &sent, 0, NULL, NULL);
+    if (r == 0)
+      r = sent;
+#else
     int r = ::sendmsg(sd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+#endif
 
     if (r == 0) {
       ldout(async_msgr->cct, 10) << __func__ << " sendmsg got r==0!" << dendl;
     } else if (r < 0) {
-      if (errno == EAGAIN || errno == EINTR) {
+      int err = ceph::net_errno();
+      if (err == EAGAIN || err == EINTR) {
         r = len;
       } else {
-        ldout(async_msgr->cct, 1) << __func__ << " sendmsg error: " << cpp_strerror(errno) << dendl;
+        ldout(async_msgr->cct, 1) << __func__ << " sendmsg error: " << cpp_strerror(err) << dendl;
       }
 
       return r;
@@ -813,7 +829,7 @@ int AsyncConnection::_process_connection()
         // close old socket.  this is safe because we stopped the reader thread above.
         if (sd >= 0) {
           center->delete_file_event(sd, EVENT_READABLE|EVENT_WRITABLE);
-          ::close(sd);
+          ceph::net_close(sd);
         }
 
         sd = net.connect(get_peer_addr());
@@ -920,7 +936,7 @@ int AsyncConnection::_process_connection()
               << async_msgr->get_myaddr() << dendl;
         } else {
           ldout(async_msgr->cct, 2) << __func__ << " connect couldn't write my addr, "
-              << cpp_strerror(errno) << dendl;
+              << cpp_strerror(ceph::net_errno()) << dendl;
           goto fail;
         }
 
@@ -966,7 +982,7 @@ int AsyncConnection::_process_connection()
           ldout(async_msgr->cct, 10) << __func__ << " continue send reply " << dendl;
         } else {
           ldout(async_msgr->cct, 2) << __func__ << " connect couldn't send reply "
-              << cpp_strerror(errno) << dendl;
+              << cpp_strerror(ceph::net_errno()) << dendl;
           goto fail;
         }
 
@@ -1122,7 +1138,7 @@ int AsyncConnection::_process_connection()
         r = ::getpeername(sd, (sockaddr*)&socket_addr.ss_addr(), &len);
         if (r < 0) {
           ldout(async_msgr->cct, 0) << __func__ << " failed to getpeername "
-                              << cpp_strerror(errno) << dendl;
+                              << cpp_strerror(ceph::net_errno()) << dendl;
           goto fail;
         }
         ::encode(socket_addr, bl);
@@ -1883,7 +1899,7 @@ int AsyncConnection::_send(Message *m)
 
   if (rc < 0) {
     ldout(async_msgr->cct, 1) << __func__ << " error sending " << m << ", "
-                        << cpp_strerror(errno) << dendl;
+                        << cpp_strerror(ceph::net_errno()) << dendl;
   } else if (rc == 0) {
     ldout(async_msgr->cct, 10) << __func__ << " sending " << m << " done." << dendl;
   } else {
@@ -17,9 +17,12 @@
 #include <errno.h>
 #include <iostream>
 #include <fstream>
-#include <poll.h>
+#ifndef _WIN32
+#include <sys/select.h>
+#endif
 
 #include "AsyncMessenger.h"
+#include "net_handler.h"
 
 #include "common/config.h"
 #include "common/Timer.h"
@@ -93,8 +96,8 @@ int Processor::bind(const entity_addr_t &bind_addr, const set<int>& avoid_ports)
   listen_sd = ::socket(family, SOCK_STREAM, 0);
   if (listen_sd < 0) {
     lderr(msgr->cct) << __func__ << " unable to create socket: "
-                     << cpp_strerror(errno) << dendl;
-    return -errno;
+                     << cpp_strerror(ceph::net_errno()) << dendl;
+    return -ceph::net_errno();
   }
 
   // use whatever user specified (if anything)
@@ -108,18 +111,18 @@ int Processor::bind(const entity_addr_t &bind_addr, const set<int>& avoid_ports)
 
     // reuse addr+port when possible
     int on = 1;
-    rc = ::setsockopt(listen_sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    rc = ::setsockopt(listen_sd, SOL_SOCKET, SO_REUSEADDR, (char*)&on, sizeof(on));
     if (rc < 0) {
       lderr(msgr->cct) << __func__ << " unable to setsockopt: "
-                       << cpp_strerror(errno) << dendl;
-      return -errno;
+                       << cpp_strerror(ceph::net_errno()) << dendl;
+      return -ceph::net_errno();
     }
 
     rc = ::bind(listen_sd, (struct sockaddr *) &listen_addr.ss_addr(), listen_addr.addr_size());
     if (rc < 0) {
       lderr(msgr->cct) << __func__ << " unable to bind to " << listen_addr.ss_addr()
-                       << ": " << cpp_strerror(errno) << dendl;
-      return -errno;
+                       << ": " << cpp_strerror(ceph::net_errno()) << dendl;
+      return -ceph::net_errno();
     }
   } else {
     // try a range of ports
@@ -135,8 +138,8 @@ int Processor::bind(const entity_addr_t &bind_addr, const set<int>& avoid_ports)
       lderr(msgr->cct) << __func__ << " unable to bind to " << listen_addr.ss_addr()
                        << " on any port in range " << msgr->cct->_conf->ms_bind_port_min
                        << "-" << msgr->cct->_conf->ms_bind_port_max
-                       << ": " << cpp_strerror(errno) << dendl;
-      return -errno;
+                       << ": " << cpp_strerror(ceph::net_errno()) << dendl;
+      return -ceph::net_errno();
     }
     ldout(msgr->cct,10) << __func__ << " bound on random port " << listen_addr << dendl;
   }
@@ -145,7 +148,7 @@ int Processor::bind(const entity_addr_t &bind_addr, const set<int>& avoid_ports)
   socklen_t llen = sizeof(listen_addr.ss_addr());
   rc = getsockname(listen_sd, (sockaddr*)&listen_addr.ss_addr(), &llen);
   if (rc < 0) {
-    rc = -errno;
+    rc = -ceph::net_errno();
     lderr(msgr->cct) << __func__ << " failed getsockname: " << cpp_strerror(rc) << dendl;
     return rc;
   }
@@ -155,7 +158,7 @@ int Processor::bind(const entity_addr_t &bind_addr, const set<int>& avoid_ports)
   // listen!
   rc = ::listen(listen_sd, 128);
   if (rc < 0) {
-    rc = -errno;
+    rc = -ceph::net_errno();
     lderr(msgr->cct) << __func__ << " unable to listen on " << listen_addr
                      << ": " << cpp_strerror(rc) << dendl;
     return rc;
@@ -215,20 +218,22 @@ void *Processor::entry()
   ldout(msgr->cct, 10) << __func__ << " starting" << dendl;
   int errors = 0;
 
-  struct pollfd pfd;
-  pfd.fd = listen_sd;
-  pfd.events = POLLIN | POLLERR | POLLNVAL | POLLHUP;
+  // select rather than poll: winsock has no poll()
   while (!done) {
-    ldout(msgr->cct, 20) << __func__ << " calling poll" << dendl;
-    int r = poll(&pfd, 1, -1);
+    fd_set rfds, efds;
+    FD_ZERO(&rfds);
+    FD_ZERO(&efds);
+    FD_SET(listen_sd, &rfds);
+    FD_SET(listen_sd, &efds);
+    ldout(msgr->cct, 20) << __func__ << " calling select" << dendl;
+    int r = ::select(listen_sd + 1, &rfds, NULL, &efds, NULL);
     if (r < 0)
       break;
-    ldout(msgr->cct,20) << __func__ << " poll got " << r << dendl;
+    ldout(msgr->cct,20) << __func__ << " select got " << r << dendl;
 
-    if (pfd.revents & (POLLERR | POLLNVAL | POLLHUP))
+    if (FD_ISSET(listen_sd, &efds))
       break;
 
-    ldout(msgr->cct,10) << __func__ << " pfd.revents=" << pfd.revents << dendl;
     if (done) break;
 
     // accept
@@ -242,7 +247,7 @@ void *Processor::entry()
       msgr->add_accept(sd);
     } else {
       ldout(msgr->cct,0) << __func__ << " no incoming connection?  sd = " << sd
-                         << " errno " << errno << " " << cpp_strerror(errno) << dendl;
+                         << " errno " << ceph::net_errno() << " " << cpp_strerror(ceph::net_errno()) << dendl;
       if (++errors > 4)
         break;
     }
@@ -251,7 +256,7 @@ void *Processor::entry()
   ldout(msgr->cct,20) << __func__ << " closing" << dendl;
   // don't close socket, in case we start up again?  blech.
   if (listen_sd >= 0) {
-    ::close(listen_sd);
+    ceph::net_close(listen_sd);
     listen_sd = -1;
   }
   ldout(msgr->cct,10) << __func__ << " stopping" << dendl;
@@ -274,7 +279,7 @@ void Processor::stop()
   }
 
   if (listen_sd >= 0) {
-    ::close(listen_sd);
+    ceph::net_close(listen_sd);
     listen_sd = -1;
   }
   done = false;
@@ -298,7 +303,7 @@ void *Worker::entry()
     r = center.process_events(30000000);
     if (r < 0) {
       ldout(msgr->cct,20) << __func__ << " process events failed: "
-                          << cpp_strerror(errno) << dendl;
+                          << cpp_strerror(ceph::net_errno()) << dendl;
       // TODO do something?
     }
   }
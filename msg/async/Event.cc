@@ -15,9 +15,14 @@
  */
 
 #include <time.h>
+#ifdef _WIN32
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
 
 #include "common/errno.h"
 #include "Event.h"
+#include "net_handler.h"
 
 #ifdef HAVE_EPOLL
 #include "EventEpoll.h"
@@ -38,9 +43,65 @@ class C_handle_notify : public EventCallback {
  public:
   C_handle_notify() {}
   void do_request(int fd_or_id) {
+    // drain the wakeup bytes, otherwise a level triggered driver keeps
+    // firing on the notify fd
+    char c[256];
+    int r;
+    do {
+#ifdef _WIN32
+      r = ::recv(fd_or_id, c, sizeof(c), 0);
+#else
+      r = ::read(fd_or_id, c, sizeof(c));
+#endif
+    } while (r > 0);
   }
 };
 
+#ifdef _WIN32
+/*
+ * winsock can't select on a pipe, so the notify channel is a connected
+ * pair of loopback sockets.
+ */
+static int notify_socketpair(int fds[2])
+{
+  struct sockaddr_in addr;
+  int addrlen = sizeof(addr);
+  int listener, r = -1;
+
+  fds[0] = fds[1] = -1;
+  listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0)
+    return -ceph::net_errno();
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  if (::bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+      ::getsockname(listener, (struct sockaddr*)&addr, &addrlen) < 0 ||
+      ::listen(listener, 1) < 0)
+    goto fail;
+
+  fds[1] = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fds[1] < 0 ||
+      ::connect(fds[1], (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    goto fail;
+  fds[0] = ::accept(listener, NULL, NULL);
+  if (fds[0] < 0)
+    goto fail;
+  ceph::net_close(listener);
+  return 0;
+
+ fail:
+  r = -ceph::net_errno();
+  ceph::net_close(listener);
+  if (fds[1] >= 0)
+    ceph::net_close(fds[1]);
+  fds[0] = fds[1] = -1;
+  return r;
+}
+#endif
+
 int EventCenter::init(int n)
 {
   // can't init multi times
@@ -67,13 +128,27 @@ int EventCenter::init(int n)
   }
 
   int fds[2];
+#ifdef _WIN32
+  r = notify_socketpair(fds);
+  if (r < 0) {
+    lderr(cct) << __func__ << " can't create notify socket pair: "
+               << cpp_strerror(r) << dendl;
+    return -1;
+  }
+#else
   if (pipe(fds) < 0) {
     lderr(cct) << __func__ << " can't create notify pipe" << dendl;
     return -1;
   }
+#endif
 
   notify_receive_fd = fds[0];
   notify_send_fd = fds[1];
+  // neither end may block: the handler reads until empty, and a full
+  // pipe already guarantees a pending wakeup
+  ceph::NetHandler net(cct);
+  net.set_nonblock(notify_receive_fd);
+  net.set_nonblock(notify_send_fd);
   file_events = static_cast<FileEvent *>(malloc(sizeof(FileEvent)*n));
   memset(file_events, 0, sizeof(FileEvent)*n);
 
@@ -87,18 +162,18 @@ EventCenter::~EventCenter()
   if (driver)
     delete driver;
 
-  if (notify_receive_fd > 0)
-    ::close(notify_receive_fd);
-  if (notify_send_fd > 0)
-    ::close(notify_send_fd);
+  if (notify_receive_fd >= 0)
+    ceph::net_close(notify_receive_fd);
+  if (notify_send_fd >= 0)
+    ceph::net_close(notify_send_fd);
 }
 
 int EventCenter::create_file_event(int fd, int mask, EventCallbackRef ctxt)
 {
   int r;
-  if (fd > nevent) {
+  if (fd >= nevent) {
     int new_size = nevent << 2;
-    while (fd > new_size)
+    while (fd >= new_size)
       new_size <<= 2;
     ldout(cct, 10) << __func__ << " event count exceed " << nevent << ", expand to " << new_size << dendl;
     r = driver->resize_events(new_size);
@@ -111,6 +186,7 @@ int EventCenter::create_file_event(int fd, int mask, EventCallbackRef ctxt)
       lderr(cct) << __func__ << " failed to realloc file_events" << cpp_strerror(errno) << dendl;
       return -errno;
     }
+    memset(new_events + nevent, 0, sizeof(FileEvent)*(new_size - nevent));
     file_events = new_events;
     nevent = new_size;
   }
@@ -186,9 +262,16 @@ void EventCenter::wakeup()
   char buf[1];
   buf[0] = 'c';
   // wake up "event_wait"
+#ifdef _WIN32
+  int n = ::send(notify_send_fd, buf, 1, 0);
+#else
   int n = write(notify_send_fd, buf, 1);
-  // FIXME ?
-  assert(n == 1);
+#endif
+  // a full pipe means a wakeup is already pending
+  if (n < 0) {
+    int r = ceph::net_errno();
+    assert(r == EAGAIN || r == EWOULDBLOCK);
+  }
 }
 
 int EventCenter::process_time_events()
@@ -259,7 +342,7 @@ int EventCenter::process_events(int timeout_microseconds)
       shortest = it->first;
       trigger_time = true;
       if (shortest > now) {
-        period = now - shortest;
+        period = shortest - now;
         period.copy_to_timeval(&tv);
       } else {
         tv.tv_sec = 0;
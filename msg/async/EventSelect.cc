@@ -0,0 +1,175 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*- 
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "common/errno.h"
+#include "EventSelect.h"
+#include "net_handler.h"
+
+#define dout_subsys ceph_subsys_ms
+
+#undef dout_prefix
+#define dout_prefix *_dout << "SelectDriver."
+
+int SelectDriver::init(int nevent)
+{
+#ifdef _WIN32
+  return ensure_sets(64);
+#else
+  return 0;
+#endif
+}
+
+#ifdef _WIN32
+int SelectDriver::ensure_sets(unsigned n)
+{
+  if (n <= set_size)
+    return 0;
+  unsigned new_size = set_size ? set_size : 64;
+  while (new_size < n)
+    new_size <<= 1;
+  size_t bytes = offsetof(win_fd_set, fd_array) + sizeof(SOCKET) * new_size;
+  win_fd_set *r = static_cast<win_fd_set*>(realloc(rset, bytes));
+  if (!r)
+    return -ENOMEM;
+  rset = r;
+  win_fd_set *w = static_cast<win_fd_set*>(realloc(wset, bytes));
+  if (!w)
+    return -ENOMEM;
+  wset = w;
+  win_fd_set *e = static_cast<win_fd_set*>(realloc(eset, bytes));
+  if (!e)
+    return -ENOMEM;
+  eset = e;
+  set_size = new_size;
+  return 0;
+}
+#endif
+
+int SelectDriver::add_event(int fd, int cur_mask, int add_mask)
+{
+#ifndef _WIN32
+  if (fd >= FD_SETSIZE) {
+    lderr(cct) << __func__ << " fd=" << fd << " exceeds FD_SETSIZE "
+	       << FD_SETSIZE << dendl;
+    return -ERANGE;
+  }
+#endif
+  fds[fd] = cur_mask | add_mask;
+#ifdef _WIN32
+  int r = ensure_sets(fds.size());
+  if (r < 0) {
+    fds[fd] = cur_mask;
+    if (!cur_mask)
+      fds.erase(fd);
+    return r;
+  }
+#endif
+  ldout(cct, 10) << __func__ << " add event to fd=" << fd << " mask="
+		 << (cur_mask | add_mask) << dendl;
+  return 0;
+}
+
+void SelectDriver::del_event(int fd, int cur_mask, int delmask)
+{
+  int mask = cur_mask & (~delmask);
+  if (mask == EVENT_NONE)
+    fds.erase(fd);
+  else
+    fds[fd] = mask;
+  ldout(cct, 10) << __func__ << " del event fd=" << fd << " cur mask=" << mask
+		 << dendl;
+}
+
+int SelectDriver::resize_events(int newsize)
+{
+  return 0;
+}
+
+int SelectDriver::event_wait(vector<FiredFileEvent> &fired_events, struct timeval *tvp)
+{
+  int retval;
+
+#ifdef _WIN32
+  rset->fd_count = 0;
+  wset->fd_count = 0;
+  eset->fd_count = 0;
+  for (map<int, int>::iterator p = fds.begin(); p != fds.end(); ++p) {
+    if (p->second & EVENT_READABLE)
+      rset->fd_array[rset->fd_count++] = p->first;
+    if (p->second & EVENT_WRITABLE) {
+      wset->fd_array[wset->fd_count++] = p->first;
+      eset->fd_array[eset->fd_count++] = p->first;
+    }
+  }
+  if (!rset->fd_count && !wset->fd_count) {
+    // winsock refuses to select on empty sets
+    if (tvp)
+      Sleep(tvp->tv_sec * 1000 + tvp->tv_usec / 1000);
+    return 0;
+  }
+  retval = ::select(0, reinterpret_cast<fd_set*>(rset),
+		    reinterpret_cast<fd_set*>(wset),
+		    reinterpret_cast<fd_set*>(eset), tvp);
+#else
+  fd_set rfds, wfds;
+  int maxfd = -1;
+  FD_ZERO(&rfds);
+  FD_ZERO(&wfds);
+  for (map<int, int>::iterator p = fds.begin(); p != fds.end(); ++p) {
+    if (p->second & EVENT_READABLE)
+      FD_SET(p->first, &rfds);
+    if (p->second & EVENT_WRITABLE)
+      FD_SET(p->first, &wfds);
+    maxfd = p->first;
+  }
+  retval = ::select(maxfd + 1, &rfds, &wfds, NULL, tvp);
+#endif
+  if (retval < 0) {
+    int r = ceph::net_errno();
+    if (r != EINTR)
+      lderr(cct) << __func__ << " select failed: " << cpp_strerror(r) << dendl;
+    return 0;
+  }
+  if (retval == 0)
+    return 0;
+
+  fired_events.clear();
+  for (map<int, int>::iterator p = fds.begin(); p != fds.end(); ++p) {
+    int mask = 0;
+#ifdef _WIN32
+    if ((p->second & EVENT_READABLE) &&
+	FD_ISSET(p->first, reinterpret_cast<fd_set*>(rset)))
+      mask |= EVENT_READABLE;
+    // winsock reports a failed non-blocking connect in exceptfds only;
+    // hand it to the write handler, whose send then fails and faults
+    if ((p->second & EVENT_WRITABLE) &&
+	(FD_ISSET(p->first, reinterpret_cast<fd_set*>(wset)) ||
+	 FD_ISSET(p->first, reinterpret_cast<fd_set*>(eset))))
+      mask |= EVENT_WRITABLE;
+#else
+    if ((p->second & EVENT_READABLE) && FD_ISSET(p->first, &rfds))
+      mask |= EVENT_READABLE;
+    if ((p->second & EVENT_WRITABLE) && FD_ISSET(p->first, &wfds))
+      mask |= EVENT_WRITABLE;
+#endif
+    if (mask) {
+      FiredFileEvent fe;
+      fe.fd = p->first;
+      fe.mask = mask;
+      fired_events.push_back(fe);
+    }
+  }
+  return fired_events.size();
+}
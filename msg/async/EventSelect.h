@@ -0,0 +1,71 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*- 
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_EVENTSELECT_H
+#define CEPH_MSG_EVENTSELECT_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#ifndef _WIN32
+#include <sys/select.h>
+#endif
+
+#include "Event.h"
+
+/*
+ * select(2) driver, for platforms with neither epoll nor kqueue (i.e.
+ * windows).  select is level triggered, which the connection handlers
+ * cope with since they only ask for writable while they have output
+ * queued.
+ *
+ * winsock's fd_set is a counted array of sockets rather than a bitmap,
+ * and FD_SETSIZE is only 64 there, so on windows we build our own sets
+ * sized to the number of registered sockets.  winsock also signals a
+ * failed connect through exceptfds rather than writefds, so sockets
+ * waiting for writable go in an except set too.
+ */
+class SelectDriver : public EventDriver {
+  CephContext *cct;
+  map<int, int> fds;   // fd -> EVENT_* mask
+
+#ifdef _WIN32
+  struct win_fd_set {
+    u_int fd_count;
+    SOCKET fd_array[1];
+  };
+  win_fd_set *rset, *wset, *eset;
+  unsigned set_size;
+  int ensure_sets(unsigned n);
+#endif
+
+ public:
+  SelectDriver(CephContext *c): cct(c)
+#ifdef _WIN32
+    , rset(NULL), wset(NULL), eset(NULL), set_size(0)
+#endif
+  {}
+  virtual ~SelectDriver() {
+#ifdef _WIN32
+    free(rset);
+    free(wset);
+    free(eset);
+#endif
+  }
+
+  int init(int nevent);
+  int add_event(int fd, int cur_mask, int add_mask);
+  void del_event(int fd, int cur_mask, int del_mask);
+  int resize_events(int newsize);
+  int event_wait(vector<FiredFileEvent> &fired_events, struct timeval *tp);
+};
+
+#endif
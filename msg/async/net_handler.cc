@@ -34,17 +34,20 @@ int NetHandler::create_socket(int domain, bool reuse_addr)
   int s, on = 1;
 
   if ((s = ::socket(domain, SOCK_STREAM, 0)) == -1) {
-    lderr(cct) << __func__ << " couldn't created socket " << cpp_strerror(errno) << dendl;
-    return -errno;
+    int r = net_errno();
+    lderr(cct) << __func__ << " couldn't created socket " << cpp_strerror(r) << dendl;
+    return -r;
   }
 
   /* Make sure connection-intensive things like the benckmark
    * will be able to close/open sockets a zillion of times */
   if (reuse_addr) {
-    if (::setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1) {
+    if (::setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (char*)&on, sizeof(on)) == -1) {
+      int r = net_errno();
       lderr(cct) << __func__ << " setsockopt SO_REUSEADDR failed: %s"
-                 << strerror(errno) << dendl;
-      return -errno;
+                 << strerror(r) << dendl;
+      net_close(s);
+      return -r;
     }
   }
 
@@ -53,6 +56,15 @@ int NetHandler::create_socket(int domain, bool reuse_addr)
 
 int NetHandler::set_nonblock(int sd)
 {
+#ifdef _WIN32
+  u_long mode = 1;
+  if (::ioctlsocket(sd, FIONBIO, &mode) != 0) {
+    int r = net_errno();
+    lderr(cct) << __func__ << " ioctlsocket(FIONBIO) failed: " << cpp_strerror(r) << dendl;
+    return -r;
+  }
+  return 0;
+#else
   int flags;
 
   /* Set the socket nonblocking.
@@ -68,6 +80,7 @@ int NetHandler::set_nonblock(int sd)
   }
 
   return 0;
+#endif
 }
 
 void NetHandler::set_socket_options(int sd)
@@ -77,15 +90,15 @@ void NetHandler::set_socket_options(int sd)
     int flag = 1;
     int r = ::setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, (char*)&flag, sizeof(flag));
     if (r < 0) {
-      r = -errno;
+      r = -net_errno();
       ldout(cct, 0) << "couldn't set TCP_NODELAY: " << cpp_strerror(r) << dendl;
     }
   }
   if (cct->_conf->ms_tcp_rcvbuf) {
     int size = cct->_conf->ms_tcp_rcvbuf;
-    int r = ::setsockopt(sd, SOL_SOCKET, SO_RCVBUF, (void*)&size, sizeof(size));
+    int r = ::setsockopt(sd, SOL_SOCKET, SO_RCVBUF, (char*)&size, sizeof(size));
     if (r < 0)  {
-      r = -errno;
+      r = -net_errno();
       ldout(cct, 0) << "couldn't set SO_RCVBUF to " << size << ": " << cpp_strerror(r) << dendl;
     }
   }
@@ -110,17 +123,21 @@ int NetHandler::generic_connect(const entity_addr_t& addr, bool nonblock)
 
   if (nonblock) {
     ret = set_nonblock(s);
-    if (ret < 0)
+    if (ret < 0) {
+      net_close(s);
       return ret;
+    }
   }
   ret = ::connect(s, (sockaddr*)&addr.addr, addr.addr_size());
   if (ret < 0) {
-    if (errno == EINPROGRESS && nonblock)
+    int r = net_errno();
+    // winsock says EWOULDBLOCK where posix says EINPROGRESS
+    if ((r == EINPROGRESS || r == EAGAIN) && nonblock)
       return s;
 
-    lderr(cct) << __func__ << " connect: %s " << strerror(errno) << dendl;
-    close(s);
-    return -errno;
+    lderr(cct) << __func__ << " connect: %s " << strerror(r) << dendl;
+    net_close(s);
+    return -r;
   }
 
   set_socket_options(s);
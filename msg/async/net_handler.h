@@ -16,9 +16,46 @@
 
 #ifndef CEPH_COMMON_NET_UTILS_H
 #define CEPH_COMMON_NET_UTILS_H
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
 #include "common/config.h"
 
 namespace ceph {
+  /*
+   * winsock reports socket errors through WSAGetLastError() rather than
+   * errno, and a socket is not a file descriptor, so go through these
+   * instead of errno and ::close().
+   */
+#ifdef _WIN32
+  inline int net_errno() {
+    switch (WSAGetLastError()) {
+    case WSAEWOULDBLOCK: return EAGAIN;
+    case WSAEINTR: return EINTR;
+    case WSAEINPROGRESS: return EINPROGRESS;
+    case WSAECONNRESET: return ECONNRESET;
+    case WSAECONNREFUSED: return ECONNREFUSED;
+    case WSAECONNABORTED: return ECONNABORTED;
+    case WSAETIMEDOUT: return ETIMEDOUT;
+    case WSAENOTCONN: return ENOTCONN;
+    case WSAEADDRINUSE: return EADDRINUSE;
+    case WSAENOBUFS: return ENOBUFS;
+    default: return EIO;
+    }
+  }
+  inline int net_close(int sd) {
+    return ::closesocket(sd);
+  }
+#else
+  inline int net_errno() {
+    return errno;
+  }
+  inline int net_close(int sd) {
+    return ::close(sd);
+  }
+#endif
+
   class NetHandler {
    private:
     int create_socket(int domain, bool reuse_addr=false);
@@ -25,6 +25,7 @@
 
 #include "common/debug.h"
 #include "common/errno.h"
+#include "msg/async/net_handler.h"
 
 // Below included to get encode_encrypt(); That probably should be in Crypto.h, instead
 
@@ -660,7 +661,7 @@ int Pipe::accept()
 
     // drop my Connection, and take a ref to the existing one. do not
     // clear existing->connection_state, since read_message and
-    // write_message both dereference it without pipe_lock.
+    // write_messages both dereference it without pipe_lock.
     connection_state = existing->connection_state;
 
     // make existing Connection reference us
@@ -1774,9 +1775,20 @@ void Pipe::writer()
 	in_seq_acked = send_seq;
       }
 
-      // grab outgoing message
-      Message *m = _get_next_outgoing();
-      if (m) {
+      // grab outgoing messages.  whatever is already queued goes out in
+      // one gathered write, up to the batch budget, so a burst of small
+      // ops does not cost a send per message.
+      unsigned max_msgs = MAX(msgr->cct->_conf->ms_writer_batch_max_messages, 1);
+      uint64_t max_bytes = msgr->cct->_conf->ms_writer_batch_max_bytes;
+      vector<OutgoingMsg> batch;
+      batch.reserve(max_msgs);
+      uint64_t batch_bytes = 0;
+      unsigned batch_iov = 0;
+      while (batch.size() < max_msgs && batch_bytes < max_bytes &&
+	     batch_iov < IOV_MAX / 2) {
+	Message *m = _get_next_outgoing();
+	if (!m)
+	  break;
 	m->set_seq(++out_seq);
 	if (!policy.lossy) {
 	  // put on sent list
@@ -1820,22 +1832,36 @@ void Pipe::writer()
 	  }
 	}
 
-	bufferlist blist = m->get_payload();
-	blist.append(m->get_middle());
-	blist.append(m->get_data());
+	batch.push_back(OutgoingMsg());
+	OutgoingMsg& o = batch.back();
+	o.m = m;
+	o.body = m->get_payload();
+	o.body.append(m->get_middle());
+	o.body.append(m->get_data());
+	batch_bytes += 1 + sizeof(header) + o.body.length() + sizeof(footer);
+	batch_iov += 3 + o.body.buffers().size();
+      }
 
+      if (!batch.empty()) {
         pipe_lock.Unlock();
 
-        ldout(msgr->cct,20) << "writer sending " << m->get_seq() << " " << m << dendl;
-	int rc = write_message(header, footer, blist);
+        ldout(msgr->cct,20) << "writer sending " << batch.size() << " messages, "
+			    << batch_bytes << " bytes, seq " << batch.front().m->get_seq()
+			    << ".." << batch.back().m->get_seq() << dendl;
+	int rc = write_messages(batch);
 
 	pipe_lock.Lock();
 	if (rc < 0) {
-          ldout(msgr->cct,1) << "writer error sending " << m << ", "
+          ldout(msgr->cct,1) << "writer error sending " << batch.size() << " messages, "
 		  << cpp_strerror(errno) << dendl;
 	  fault();
-        }
-	m->put();
+        } else {
+	  msgr->logger->inc(l_msgr_send_batch);
+	  msgr->logger->inc(l_msgr_send_batch_msgs, batch.size());
+	  msgr->logger->inc(l_msgr_send_batch_bytes, batch_bytes);
+	}
+	for (vector<OutgoingMsg>::iterator p = batch.begin(); p != batch.end(); ++p)
+	  p->m->put();
       }
       continue;
     }
@@ -2130,97 +2156,66 @@ int Pipe::read_message(Message **pm, AuthSessionHandler* auth_handler)
 
 int Pipe::do_sendmsg(struct msghdr *msg, int len, bool more)
 {
-  char buf[80];
-
-//  while (len > 0) {
-//    if (0) { // sanity
-//      int l = 0;
-//      for (unsigned i=0; i<msg->msg_iovlen; i++)
-//        l += msg->msg_iov[i].iov_len;
-//      assert(l == len);
-//    }
-    ldout(msgr->cct,0) << "..............do_sendmsg NOW" << dendl;
-    char* msg_buf = (char*)malloc(len);
-    if(msg_buf==NULL)
-    {
-            ldout(msgr->cct,0) << "do_sendmsg malloc ERROR" << dendl;
-            return -1;
+  while (len > 0) {
+    if (0) { // sanity
+      int l = 0;
+      for (unsigned i=0; i<msg->msg_iovlen; i++)
+	l += msg->msg_iov[i].iov_len;
+      assert(l == len);
+    }
+
+#ifdef _WIN32
+    // winsock has no sendmsg; WSASend takes the same gather list
+    assert(msg->msg_iovlen <= IOV_MAX);
+    for (unsigned i=0; i<msg->msg_iovlen; i++) {
+      wsabufs[i].buf = (char *)msg->msg_iov[i].iov_base;
+      wsabufs[i].len = msg->msg_iov[i].iov_len;
+    }
+    DWORD sent = 0;
+    int r = ::WSASend(sd, wsabufs, msg->msg_iovlen, &sent, 0, NULL, NULL);
+    if (r == 0)
+      r = sent;
+    else
+      errno = ceph::net_errno();
+#else
+    int r = ::sendmsg(sd, msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+#endif
+    msgr->logger->inc(l_msgr_sendmsg);
+    if (r == 0) 
+      ldout(msgr->cct,10) << "do_sendmsg hmm do_sendmsg got r==0!" << dendl;
+    if (r < 0) { 
+      ldout(msgr->cct,1) << "do_sendmsg error " << cpp_strerror(errno) << dendl;
+      return -1;
     }
+    if (state == STATE_CLOSED) {
+      ldout(msgr->cct,10) << "do_sendmsg oh look, state == CLOSED, giving up" << dendl;
+      errno = EINTR;
+      return -1; // close enough
+    }
+
+    len -= r;
+    if (len == 0) break;
     
-    int l = 0;
-    char* msg_buf_off = msg_buf;
-    for (unsigned i=0; i<msg->msg_iovlen; i++)
-        {
-                memcpy(msg_buf_off, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
-                msg_buf_off+=msg->msg_iov[i].iov_len;
-                assert(msg_buf_off<=msg_buf+len);
-        }
-        
-        #define MSG_BLOCK_SIZE 256*1024*1024
-        
-        msg_buf_off = msg_buf;
-        while (len > 0) {
-                int send_len_this_time = MIN(len, MSG_BLOCK_SIZE);
-                //int send_len_this_time = len;
-                while(send_len_this_time > 0)
-                {
-                        int r = ::send( sd, msg_buf_off, send_len_this_time, 0 );
-                        //ldout(msgr->cct,0) << "do_sendmsg NOW in while (send_len_this_time > 0) send_len_this_time = " << send_len_this_time << " r=" << r << dendl;
-                        if (r < 0) {
-                                ldout(msgr->cct,0) << "do_sendmsg ERROR " << strerror_r(errno, buf, sizeof(buf)) << dendl;
-                                free(msg_buf);
-                                return r;
-                        }
-                        if (state == STATE_CLOSED) {
-                                ldout(msgr->cct,0) << "do_sendmsg oh look, state == CLOSED, giving up" << dendl;
-                                errno = EINTR;
-                                free(msg_buf);
-                                return -1; // close enough
-                        }
-                        send_len_this_time -= r;
-                        msg_buf_off += r;
-                }
-                
-                len -= MIN(len, MSG_BLOCK_SIZE);
-        }
-        free(msg_buf);
-        msg_buf=NULL;
-    ldout(msgr->cct,0) << "do_sendmsg OK " << dendl;
-    
-    //int r = ::sendmsg(sd, msg, MSG_NOSIGNAL);
-    //ldout(msgr->cct,0) << ",,,,,,,,,,,,,,,,,do_sendmsg size=" << r << dendl;
-    //if (r == 0) 
-    //  ldout(msgr->cct,0) << "????????????????do_sendmsg hmm do_sendmsg got r==0!" << dendl;
-    //if (r < 0) { 
-    //  ldout(msgr->cct,0) << "!!!!!!!!!!!!!!!!do_sendmsg error " << strerror_r(errno, buf, sizeof(buf)) << dendl;
-    //  return -1;
-    //}
-
-
-//    len -= r;
-//    if (len == 0) break;
-    
-//    // hrmph.  trim r bytes off the front of our message.
-//    ldout(msgr->cct,20) << "do_sendmsg short write did " << r << ", still have " << len << dendl;
-//    while (r > 0) {
-//      if (msg->msg_iov[0].iov_len <= (size_t)r) {
-//        // lose this whole item
-//        //ldout(msgr->cct,30) << "skipping " << msg->msg_iov[0].iov_len << ", " << (msg->msg_iovlen-1) << " v, " << r << " left" << dendl;
-//        r -= msg->msg_iov[0].iov_len;
-//        msg->msg_iov++;
-//        msg->msg_iovlen--;
-//      } else {
-//        // partial!
-//        //ldout(msgr->cct,30) << "adjusting " << msg->msg_iov[0].iov_len << ", " << msg->msg_iovlen << " v, " << r << " left" << dendl;
-//        msg->msg_iov[0].iov_base = (char *)msg->msg_iov[0].iov_base + r;
-//        msg->msg_iov[0].iov_len -= r;
-//        break;
-//      }
-//    }
-//  }
+    // hrmph.  trim r bytes off the front of our message.
+    ldout(msgr->cct,20) << "do_sendmsg short write did " << r << ", still have " << len << dendl;
+    while (r > 0) {
+      if (msg->msg_iov[0].iov_len <= (size_t)r) {
+	// lose this whole item
+	r -= msg->msg_iov[0].iov_len;
+	msg->msg_iov++;
+	msg->msg_iovlen--;
+      } else {
+	// partial!
+	msg->msg_iov[0].iov_base = (char *)msg->msg_iov[0].iov_base + r;
+	msg->msg_iov[0].iov_len -= r;
+	break;
+      }
+    }
+  }
   return 0;
 }
 
+
 int Pipe::write_ack(uint64_t seq)
 {
   ldout(msgr->cct,10) << "write_ack " << seq << dendl;
@@ -2284,130 +2279,113 @@ int Pipe::write_keepalive2(char tag, const utime_t& t)
 }
 
 
-int Pipe::write_message(ceph_msg_header& header, ceph_msg_footer& footer, bufferlist& blist)
+int Pipe::write_messages(vector<OutgoingMsg>& batch)
 {
-  int ret;
-
   // set up msghdr and iovecs
   struct msghdr msg;
   memset(&msg, 0, sizeof(msg));
   msg.msg_iov = msgvec;
   int msglen = 0;
-  
-  // send tag
-  char tag = CEPH_MSGR_TAG_MSG;
-  msgvec[msg.msg_iovlen].iov_base = &tag;
-  msgvec[msg.msg_iovlen].iov_len = 1;
-  msglen++;
-  msg.msg_iovlen++;
-
-  // send envelope
-  ceph_msg_header_old oldheader;
-  if (connection_state->has_feature(CEPH_FEATURE_NOSRCADDR)) {
-    msgvec[msg.msg_iovlen].iov_base = (char*)&header;
-    msgvec[msg.msg_iovlen].iov_len = sizeof(header);
-    msglen += sizeof(header);
-    msg.msg_iovlen++;
-  } else {
-    memcpy(&oldheader, &header, sizeof(header));
-    oldheader.src.name = header.src;
-    oldheader.src.addr = connection_state->get_peer_addr();
-    oldheader.orig_src = oldheader.src;
-    oldheader.reserved = header.reserved;
-    if (msgr->crcflags & MSG_CRC_HEADER) {
-	oldheader.crc = ceph_crc32c(0, (unsigned char*)&oldheader,
-				    sizeof(oldheader) - sizeof(oldheader.crc));
-    } else {
-	oldheader.crc = 0;
-    }
-    msgvec[msg.msg_iovlen].iov_base = (char*)&oldheader;
-    msgvec[msg.msg_iovlen].iov_len = sizeof(oldheader);
-    msglen += sizeof(oldheader);
-    msg.msg_iovlen++;
-  }
-
-  // payload (front+data)
-  list<bufferptr>::const_iterator pb = blist.buffers().begin();
-  int b_off = 0;  // carry-over buffer offset, if any
-  int bl_pos = 0; // blist pos
-  int left = blist.length();
 
-  while (left > 0) {
-    int donow = MIN(left, (int)pb->length()-b_off);
-    if (donow == 0) {
-      ldout(msgr->cct,0) << "donow = " << donow << " left " << left << " pb->length " << pb->length()
-	      << " b_off " << b_off << dendl;
-    }
-    assert(donow > 0);
-    ldout(msgr->cct,30) << " bl_pos " << bl_pos << " b_off " << b_off
-	     << " leftinchunk " << left
-	     << " buffer len " << pb->length()
-	     << " writing " << donow 
-	     << dendl;
-    
-    if (msg.msg_iovlen >= IOV_MAX-2) {
+  char tag = CEPH_MSGR_TAG_MSG;
+  bool new_header = connection_state->has_feature(CEPH_FEATURE_NOSRCADDR);
+  bool new_footer = connection_state->has_feature(CEPH_FEATURE_MSG_AUTH);
+  // old-format envelopes are built here and must outlive the sendmsg
+  vector<ceph_msg_header_old> oldheaders(new_header ? 0 : batch.size());
+  vector<ceph_msg_footer_old> oldfooters(new_footer ? 0 : batch.size());
+
+  for (unsigned i = 0; i < batch.size(); i++) {
+    ceph_msg_header& header = batch[i].m->get_header();
+    ceph_msg_footer& footer = batch[i].m->get_footer();
+    bufferlist& blist = batch[i].body;
+
+    // tag, envelope and footer need three slots
+    if (msg.msg_iovlen >= IOV_MAX-3) {
       if (do_sendmsg(&msg, msglen, true))
-	goto fail;
-      
-      // and restart the iov
+	return -1;
       msg.msg_iov = msgvec;
       msg.msg_iovlen = 0;
       msglen = 0;
     }
-    
-    msgvec[msg.msg_iovlen].iov_base = (void*)(pb->c_str()+b_off);
-    msgvec[msg.msg_iovlen].iov_len = donow;
-    msglen += donow;
+
+    // send tag
+    msgvec[msg.msg_iovlen].iov_base = &tag;
+    msgvec[msg.msg_iovlen].iov_len = 1;
+    msglen++;
     msg.msg_iovlen++;
-    
-    left -= donow;
-    assert(left >= 0);
-    b_off += donow;
-    bl_pos += donow;
-    if (left == 0)
-      break;
-    while (b_off == (int)pb->length()) {
-      ++pb;
-      b_off = 0;
+
+    // send envelope
+    if (new_header) {
+      msgvec[msg.msg_iovlen].iov_base = (char*)&header;
+      msgvec[msg.msg_iovlen].iov_len = sizeof(header);
+      msglen += sizeof(header);
+      msg.msg_iovlen++;
+    } else {
+      ceph_msg_header_old& oldheader = oldheaders[i];
+      memcpy(&oldheader, &header, sizeof(header));
+      oldheader.src.name = header.src;
+      oldheader.src.addr = connection_state->get_peer_addr();
+      oldheader.orig_src = oldheader.src;
+      oldheader.reserved = header.reserved;
+      if (msgr->crcflags & MSG_CRC_HEADER) {
+	oldheader.crc = ceph_crc32c(0, (unsigned char*)&oldheader,
+				    sizeof(oldheader) - sizeof(oldheader.crc));
+      } else {
+	oldheader.crc = 0;
+      }
+      msgvec[msg.msg_iovlen].iov_base = (char*)&oldheader;
+      msgvec[msg.msg_iovlen].iov_len = sizeof(oldheader);
+      msglen += sizeof(oldheader);
+      msg.msg_iovlen++;
     }
-  }
-  assert(left == 0);
 
-  // send footer; if receiver doesn't support signatures, use the old footer format
+    // payload (front+middle+data)
+    for (list<bufferptr>::const_iterator pb = blist.buffers().begin();
+	 pb != blist.buffers().end();
+	 ++pb) {
+      if (pb->length() == 0)
+	continue;
+      // keep a slot free for the footer
+      if (msg.msg_iovlen >= IOV_MAX-2) {
+	if (do_sendmsg(&msg, msglen, true))
+	  return -1;
+	msg.msg_iov = msgvec;
+	msg.msg_iovlen = 0;
+	msglen = 0;
+      }
+      msgvec[msg.msg_iovlen].iov_base = (void*)pb->c_str();
+      msgvec[msg.msg_iovlen].iov_len = pb->length();
+      msglen += pb->length();
+      msg.msg_iovlen++;
+    }
 
-  ceph_msg_footer_old old_footer;
-  if (connection_state->has_feature(CEPH_FEATURE_MSG_AUTH)) {
-    msgvec[msg.msg_iovlen].iov_base = (void*)&footer;
-    msgvec[msg.msg_iovlen].iov_len = sizeof(footer);
-    msglen += sizeof(footer);
-    msg.msg_iovlen++;
-  } else {
-    if (msgr->crcflags & MSG_CRC_HEADER) {
-      old_footer.front_crc = footer.front_crc;
-      old_footer.middle_crc = footer.middle_crc;
+    // send footer; if receiver doesn't support signatures, use the old footer format
+    if (new_footer) {
+      msgvec[msg.msg_iovlen].iov_base = (void*)&footer;
+      msgvec[msg.msg_iovlen].iov_len = sizeof(footer);
+      msglen += sizeof(footer);
+      msg.msg_iovlen++;
     } else {
+      ceph_msg_footer_old& old_footer = oldfooters[i];
+      if (msgr->crcflags & MSG_CRC_HEADER) {
+	old_footer.front_crc = footer.front_crc;
+	old_footer.middle_crc = footer.middle_crc;
+      } else {
 	old_footer.front_crc = old_footer.middle_crc = 0;
+      }
+      old_footer.data_crc = msgr->crcflags & MSG_CRC_DATA ? footer.data_crc : 0;
+      old_footer.flags = footer.flags;   
+      msgvec[msg.msg_iovlen].iov_base = (char*)&old_footer;
+      msgvec[msg.msg_iovlen].iov_len = sizeof(old_footer);
+      msglen += sizeof(old_footer);
+      msg.msg_iovlen++;
     }
-    old_footer.data_crc = msgr->crcflags & MSG_CRC_DATA ? footer.data_crc : 0;
-    old_footer.flags = footer.flags;   
-    msgvec[msg.msg_iovlen].iov_base = (char*)&old_footer;
-    msgvec[msg.msg_iovlen].iov_len = sizeof(old_footer);
-    msglen += sizeof(old_footer);
-    msg.msg_iovlen++;
   }
 
   // send
   if (do_sendmsg(&msg, msglen))
-    goto fail;
-
-  ret = 0;
-
- out:
-  return ret;
-
- fail:
-  ret = -1;
-  goto out;
+    return -1;
+  return 0;
 }
 
 
@@ -22,24 +22,7 @@
 #include "msg/Messenger.h"
 #include "PipeConnection.h"
 
-/* Structure describing messages sent by
-   `sendmsg' and received by `recvmsg'.  */
-struct msghdr
-  {
-    void *msg_name;             /* Address to send to/receive from.  */
-    socklen_t msg_namelen;      /* Length of address data.  */
-
-    struct iovec *msg_iov;	/* Vector of data to send/receive into.  */
-    size_t msg_iovlen;          /* Number of elements in the vector.  */
-
-    void *msg_control;          /* Ancillary data (eg BSD filedesc passing). */
-    size_t msg_controllen;	/* Ancillary data buffer length.
-                                   !! The type should be socklen_t but the
-                                   definition of the kernel is incompatible
-                                   with this.  */
-
-    int msg_flags;              /* Flags on received message.  */
-  };
+#include <sys/socket.h>
 
 class SimpleMessenger;
 class IncomingQueue;
@@ -197,6 +180,9 @@ class DispatchQueue;
   private:
     SOCKET sd;
     struct iovec msgvec[IOV_MAX];
+#ifdef _WIN32
+    WSABUF wsabufs[IOV_MAX];  // do_sendmsg's WSASend copy of msg_iov
+#endif
 
   public:
     int port;
@@ -248,7 +234,19 @@ class DispatchQueue;
 
     int read_message(Message **pm,
 		     AuthSessionHandler *session_security_copy);
-    int write_message(ceph_msg_header& h, ceph_msg_footer& f, bufferlist& body);
+    /// a message encoded and signed by the writer, ready for the wire
+    struct OutgoingMsg {
+      Message *m;
+      bufferlist body;  // front+middle+data
+      OutgoingMsg() : m(NULL) {}
+    };
+    /**
+     * Write out a batch of messages (tag, envelope, body and footer for
+     * each) with as few gathered writes as the iovec limit allows.
+     *
+     * @return 0, or -1 on failure (unrecoverable -- close the socket).
+     */
+    int write_messages(vector<OutgoingMsg>& batch);
     /**
      * Write the given data (of length len) to the Pipe's socket. This function
      * will loop until all passed data has been written out.
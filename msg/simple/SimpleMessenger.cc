@@ -49,12 +49,22 @@ SimpleMessenger::SimpleMessenger(CephContext *cct, entity_name_t name,
     cluster_protocol(0),
     dispatch_throttler(cct, string("msgr_dispatch_throttler-") + mname,
 		       cct->_conf->ms_dispatch_throttle_bytes),
+    logger(NULL),
     reaper_started(false), reaper_stop(false),
     timeout(0),
     local_connection(new PipeConnection(cct, this))
 {
   ceph_spin_init(&global_seq_lock);
   init_local_connection();
+
+  PerfCountersBuilder b(cct, string("msgr-") + mname,
+			l_msgr_first, l_msgr_last);
+  b.add_u64_counter(l_msgr_send_batch, "send_batch");
+  b.add_u64_avg(l_msgr_send_batch_msgs, "send_batch_msgs");
+  b.add_u64_avg(l_msgr_send_batch_bytes, "send_batch_bytes");
+  b.add_u64_counter(l_msgr_sendmsg, "sendmsg");
+  logger = b.create_perf_counters();
+  cct->get_perfcounters_collection()->add(logger);
 }
 
 /**
@@ -66,6 +76,8 @@ SimpleMessenger::~SimpleMessenger()
   assert(!did_bind); // either we didn't bind or we shut down the Accepter
   assert(rank_pipe.empty()); // we don't have any running Pipes.
   assert(!reaper_started); // the reaper thread is stopped
+  cct->get_perfcounters_collection()->remove(logger);
+  delete logger;
 }
 
 void SimpleMessenger::ready()
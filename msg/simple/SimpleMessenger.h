@@ -30,6 +30,7 @@ using namespace std;
 #include "common/Cond.h"
 #include "common/Thread.h"
 #include "common/Throttle.h"
+#include "common/perf_counters.h"
 
 #include "msg/SimplePolicyMessenger.h"
 #include "msg/Message.h"
@@ -69,6 +70,15 @@ using namespace std;
  *               IncomingQueue::lock
  */
 
+enum {
+  l_msgr_first = 94000,
+  l_msgr_send_batch,        // gathered writes issued by Pipe writers
+  l_msgr_send_batch_msgs,   // messages per gathered write
+  l_msgr_send_batch_bytes,  // bytes per gathered write
+  l_msgr_sendmsg,           // socket send calls
+  l_msgr_last,
+};
+
 class SimpleMessenger : public SimplePolicyMessenger {
   // First we have the public Messenger interface implementation...
 public:
@@ -307,6 +317,9 @@ private:
   /// Throttle preventing us from building up a big backlog waiting for dispatch
   Throttle dispatch_throttler;
 
+  /// writer batching stats, updated by the Pipes
+  PerfCounters *logger;
+
   bool reaper_started, reaper_stop;
   Cond reaper_cond;
 
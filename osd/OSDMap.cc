@@ -928,6 +928,7 @@ void OSDMap::set_max_osd(int m)
     osd_primary_affinity->resize(m, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
 
   calc_num_osds();
+  _invalidate_pg_mappings();
 }
 
 int OSDMap::calc_num_osds()
@@ -1265,6 +1266,7 @@ int OSDMap::apply_incremental(const Incremental &inc)
 
   epoch++;
   modified = inc.modified;
+  _invalidate_pg_mappings();
 
   // full map?
   if (inc.fullmap.length()) {
@@ -1693,6 +1695,8 @@ void OSDMap::_pg_to_up_acting_osds(const pg_t& pg, vector<int> *up, int *up_prim
       *acting_primary = -1;
     return;
   }
+  if (_get_cached_pg_mapping(*pool, pg, up, up_primary, acting, acting_primary))
+    return;
   vector<int> raw;
   vector<int> _up;
   vector<int> _acting;
@@ -1709,6 +1713,7 @@ void OSDMap::_pg_to_up_acting_osds(const pg_t& pg, vector<int> *up, int *up_prim
       _acting_primary = _up_primary;
     }
   }
+  _cache_pg_mapping(*pool, pg, _up, _up_primary, _acting, _acting_primary);
   if (up)
     up->swap(_up);
   if (up_primary)
@@ -1719,6 +1724,51 @@ void OSDMap::_pg_to_up_acting_osds(const pg_t& pg, vector<int> *up, int *up_prim
     *acting_primary = _acting_primary;
 }
 
+bool OSDMap::_get_cached_pg_mapping(const pg_pool_t& pool, const pg_t& pg,
+				    vector<int> *up, int *up_primary,
+				    vector<int> *acting, int *acting_primary) const
+{
+  // objecter passes raw pgs (the full object hash); they map exactly as
+  // the pg they fold to, so that is the slot.
+  ps_t ps = pool.raw_pg_to_pg(pg).ps();
+  pg_mapping_cache_t *c = pg_mapping_cache.get();
+  Spinlock::Locker l(c->lock);
+  map<int64_t, vector<pg_mapping_t> >::const_iterator p = c->pools.find(pg.pool());
+  if (p == c->pools.end() || !p->second[ps].valid) {
+    c->misses++;
+    return false;
+  }
+  const pg_mapping_t& m = p->second[ps];
+  c->hits++;
+  if (up)
+    *up = m.up;
+  if (up_primary)
+    *up_primary = m.up_primary;
+  if (acting)
+    *acting = m.acting;
+  if (acting_primary)
+    *acting_primary = m.acting_primary;
+  return true;
+}
+
+void OSDMap::_cache_pg_mapping(const pg_pool_t& pool, const pg_t& pg,
+			       const vector<int>& up, int up_primary,
+			       const vector<int>& acting, int acting_primary) const
+{
+  ps_t ps = pool.raw_pg_to_pg(pg).ps();
+  pg_mapping_cache_t *c = pg_mapping_cache.get();
+  Spinlock::Locker l(c->lock);
+  vector<pg_mapping_t>& table = c->pools[pg.pool()];
+  if (table.empty())
+    table.resize(pool.get_pg_num());
+  pg_mapping_t& m = table[ps];
+  m.up = up;
+  m.up_primary = up_primary;
+  m.acting = acting;
+  m.acting_primary = acting_primary;
+  m.valid = true;
+}
+
 int OSDMap::calc_pg_rank(int osd, const vector<int>& acting, int nrep)
 {
   if (!nrep)
@@ -2203,6 +2253,7 @@ void OSDMap::post_decode()
 
   calc_num_osds();
   _calc_up_osd_features();
+  _invalidate_pg_mappings();
 }
 
 void OSDMap::dump_erasure_code_profiles(const map<string,map<string,string> > &profiles,
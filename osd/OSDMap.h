@@ -42,6 +42,7 @@
 #include <set>
 #include <map>
 #include "include/memory.h"
+#include "include/Spinlock.h"
 using namespace std;
 
 #include "include/unordered_set.h"
@@ -250,6 +251,37 @@ private:
   mutable bool crc_defined;
   mutable uint32_t crc;
 
+  /**
+   * memoized pg -> up/acting mappings.  they depend on nothing but this
+   * map, so _pg_to_up_acting_osds fills a table per pool as pgs are
+   * looked up.  any change to the map swaps in a fresh, empty cache
+   * (rather than clearing it in place, since copies of the map may
+   * still share the old one).
+   */
+  struct pg_mapping_t {
+    vector<int> up, acting;
+    int up_primary, acting_primary;
+    bool valid;
+    pg_mapping_t() : up_primary(-1), acting_primary(-1), valid(false) {}
+  };
+  struct pg_mapping_cache_t {
+    Spinlock lock;
+    map<int64_t, vector<pg_mapping_t> > pools;  // indexed by raw_pg_to_pg(pg).ps()
+    uint64_t hits, misses;
+    pg_mapping_cache_t() : hits(0), misses(0) {}
+  };
+  mutable ceph::shared_ptr<pg_mapping_cache_t> pg_mapping_cache;
+
+  void _invalidate_pg_mappings() {
+    pg_mapping_cache.reset(new pg_mapping_cache_t);
+  }
+  bool _get_cached_pg_mapping(const pg_pool_t& pool, const pg_t& pg,
+			      vector<int> *up, int *up_primary,
+			      vector<int> *acting, int *acting_primary) const;
+  void _cache_pg_mapping(const pg_pool_t& pool, const pg_t& pg,
+			 const vector<int>& up, int up_primary,
+			 const vector<int>& acting, int acting_primary) const;
+
   void _calc_up_osd_features();
 
  public:
@@ -275,6 +307,7 @@ private:
 	     new_blacklist_entries(false),
 	     cached_up_osd_features(0),
 	     crc_defined(false), crc(0),
+	     pg_mapping_cache(new pg_mapping_cache_t),
 	     crush(new CrushWrapper) {
     memset(&fsid, 0, sizeof(fsid));
   }
@@ -292,6 +325,7 @@ public:
     primary_temp.reset(new map<pg_t,int32_t>(*o.primary_temp));
     pg_temp.reset(new map<pg_t,vector<int32_t> >(*o.pg_temp));
     osd_uuid.reset(new vector<uuid_d>(*o.osd_uuid));
+    _invalidate_pg_mappings();
 
     // NOTE: this still references shared entity_addr_t's.
     osd_addrs.reset(new addrs_s(*o.osd_addrs));
@@ -360,6 +394,7 @@ public:
   void set_state(int o, unsigned s) {
     assert(o < max_osd);
     osd_state[o] = s;
+    _invalidate_pg_mappings();
   }
   void set_weightf(int o, float w) {
     set_weight(o, (int)((float)CEPH_OSD_IN * w));
@@ -369,6 +404,7 @@ public:
     osd_weight[o] = w;
     if (w)
       osd_state[o] |= CEPH_OSD_EXISTS;
+    _invalidate_pg_mappings();
   }
   unsigned get_weight(int o) const {
     assert(o < max_osd);
@@ -385,6 +421,7 @@ public:
       osd_primary_affinity.reset(new vector<__u32>(max_osd,
 						   CEPH_OSD_DEFAULT_PRIMARY_AFFINITY));
     (*osd_primary_affinity)[o] = w;
+    _invalidate_pg_mappings();
   }
   unsigned get_primary_affinity(int o) const {
     assert(o < max_osd);
@@ -680,6 +717,13 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+  /// lookups answered from (and not from) the pg mapping cache of this epoch
+  void get_pg_mapping_cache_stats(uint64_t *hits, uint64_t *misses) const {
+    pg_mapping_cache_t *c = pg_mapping_cache.get();
+    Spinlock::Locker l(c->lock);
+    *hits = c->hits;
+    *misses = c->misses;
+  }
   bool pg_is_ec(pg_t pg) const {
     map<int64_t, pg_pool_t>::const_iterator i = pools.find(pg.pool());
     assert(i != pools.end());
@@ -1544,19 +1544,35 @@ void ObjectCacher::flusher_entry()
 		     << ", flushing some dirty bhs" << dendl;
       flush(actual - target_dirty);
     } else {
-      // check tail of lru for old dirty items
+      // check tail of lru for old dirty items.  those of temporary files
+      // go back to the top, and only leave under dirty pressure or an
+      // explicit flush; stop when we come around to the first of them.
+      // skipping one counts against max like writing one does, so a long
+      // run of temporary bhs cannot hold the lock either.
       utime_t cutoff = ceph_clock_now(cct);
       cutoff -= max_dirty_age;
-      BufferHead *bh = 0;
+      BufferHead *bh = 0, *first_kept = 0;
       int max = MAX_FLUSH_UNDER_LOCK;
+      bool wrote = false;
       while ((bh = static_cast<BufferHead*>(bh_lru_dirty.lru_get_next_expire())) != 0 &&
-	     bh->last_write < cutoff &&
-	     --max > 0) {
-	ldout(cct, 10) << "flusher flushing aged dirty bh " << *bh << dendl;
-	bh_write(bh);
+	     bh != first_kept &&
+	     bh->last_write < cutoff) {
+	if (bh->ob->oset->temporary) {
+	  if (!first_kept)
+	    first_kept = bh;
+	  bh_lru_dirty.lru_touch(bh);
+	} else {
+	  ldout(cct, 10) << "flusher flushing aged dirty bh " << *bh << dendl;
+	  bh_write(bh);
+	  wrote = true;
+	}
+	if (--max == 0)
+	  break;
       }
-      if (!max) {
-	// back off the lock to avoid starving other threads
+      if (!max && wrote) {
+	// back off the lock to avoid starving other threads.  a pass that
+	// only moved temporary bhs waits for the next tick instead of
+	// spinning on them.
 	lock.Unlock();
 	lock.Lock();
 	continue;
@@ -329,11 +329,12 @@ class ObjectCacher {
 
     int dirty_or_tx;
     bool return_enoent;
+    int temporary;  // users asking that dirty data not be flushed for age
 
     ObjectSet(void *p, int64_t _poolid, inodeno_t i)
       : parent(p), ino(i), truncate_seq(0),
 	truncate_size(0), poolid(_poolid), dirty_or_tx(0),
-	return_enoent(false) {}
+	return_enoent(false), temporary(0) {}
 
   };
 
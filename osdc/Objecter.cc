@@ -2537,7 +2537,7 @@ void Objecter::_session_op_assign(OSDSession *to, Op *op)
 
   get_session(to);
   op->session = to;
-  to->ops[op->tid] = op;
+  to->op_insert(op);
 
   if (to->is_homeless()) {
     num_homeless_ops.inc();
@@ -2555,7 +2555,7 @@ void Objecter::_session_op_remove(OSDSession *from, Op *op)
     num_homeless_ops.dec();
   }
 
-  from->ops.erase(op->tid);
+  from->op_erase(op->tid);
   put_session(from);
   op->session = NULL;
 
@@ -2830,7 +2830,7 @@ void Objecter::_throttle_op(Op *op, int op_budget)
 void Objecter::unregister_op(Op *op)
 {
   op->session->lock.get_write();
-  op->session->ops.erase(op->tid);
+  op->session->op_erase(op->tid);
   op->session->lock.unlock();
   put_session(op->session);
   op->session = NULL;
@@ -2870,8 +2870,8 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
 
   s->lock.get_write();
 
-  map<ceph_tid_t, Op *>::iterator iter = s->ops.find(tid);
-  if (iter == s->ops.end()) {
+  Op *op = s->op_index.find(tid);
+  if (!op) {
     ldout(cct, 7) << "handle_osd_op_reply " << tid
 	    << (m->is_ondisk() ? " ondisk":(m->is_onnvram() ? " onnvram":" ack"))
 	    << " ... stray" << dendl;
@@ -2887,7 +2887,6 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
 		<< " in " << m->get_pg()
 		<< " attempt " << m->get_retry_attempt()
 		<< dendl;
-  Op *op = iter->second;
 
   if (m->get_retry_attempt() >= 0) {
     if (m->get_retry_attempt() != (op->attempts - 1)) {
@@ -2936,7 +2935,7 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
     ldout(cct, 7) << " got -EAGAIN, resubmitting" << dendl;
 
     // new tid
-    s->ops.erase(op->tid);
+    s->op_erase(op->tid);
     op->tid = last_tid.inc();
 
     _send_op(op);
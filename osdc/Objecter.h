@@ -1659,6 +1659,84 @@ public:
 
     // pending ops
     map<ceph_tid_t,Op*>            ops;
+
+    /*
+     * open-addressed hash of ops by tid, for the reply path: a lookup is
+     * one or two probes instead of a walk down the ops tree.  it is kept
+     * in step with ops by op_insert/op_erase, so like ops it only changes
+     * under the session write lock.  ops stays the ordered index that
+     * resends and dumps iterate.
+     */
+    class TidIndex {
+      struct slot {
+	ceph_tid_t tid;  // 0 is an empty slot; tids start at 1
+	Op *op;
+	slot() : tid(0), op(NULL) {}
+      };
+      vector<slot> slots;  // power-of-two size, at most half full
+      unsigned count;
+
+      unsigned home(ceph_tid_t tid) const {
+	// tids are sequential; spread them over the table
+	return (unsigned)((tid * 0x9e3779b97f4a7c15ull) >> 32) & (slots.size() - 1);
+      }
+      void grow() {
+	vector<slot> old(slots.size() * 2);
+	old.swap(slots);
+	count = 0;
+	for (unsigned i = 0; i < old.size(); i++)
+	  if (old[i].tid)
+	    insert(old[i].tid, old[i].op);
+      }
+
+    public:
+      TidIndex() : slots(16), count(0) {}
+
+      unsigned size() const { return count; }
+
+      Op *find(ceph_tid_t tid) const {
+	unsigned mask = slots.size() - 1;
+	for (unsigned i = home(tid); slots[i].tid; i = (i + 1) & mask)
+	  if (slots[i].tid == tid)
+	    return slots[i].op;
+	return NULL;
+      }
+      void insert(ceph_tid_t tid, Op *op) {
+	assert(tid);
+	if ((count + 1) * 2 > slots.size())
+	  grow();
+	unsigned mask = slots.size() - 1;
+	unsigned i = home(tid);
+	for (; slots[i].tid; i = (i + 1) & mask) {
+	  if (slots[i].tid == tid) {
+	    slots[i].op = op;
+	    return;
+	  }
+	}
+	slots[i].tid = tid;
+	slots[i].op = op;
+	count++;
+      }
+      void erase(ceph_tid_t tid) {
+	unsigned mask = slots.size() - 1;
+	unsigned i = home(tid);
+	for (; slots[i].tid != tid; i = (i + 1) & mask)
+	  if (!slots[i].tid)
+	    return;
+	// shift later members of the probe run back over the hole, so
+	// find never needs tombstones
+	for (unsigned j = (i + 1) & mask; slots[j].tid; j = (j + 1) & mask) {
+	  unsigned h = home(slots[j].tid);
+	  if (((j - h) & mask) >= ((j - i) & mask)) {
+	    slots[i] = slots[j];
+	    i = j;
+	  }
+	}
+	slots[i] = slot();
+	count--;
+      }
+    };
+    TidIndex op_index;
     map<uint64_t, LingerOp*>  linger_ops;
     map<ceph_tid_t,CommandOp*>     command_ops;
 
@@ -1685,6 +1763,15 @@ public:
     bool is_homeless() { return (osd == -1); }
 
     Mutex *get_lock(object_t& oid);
+
+    void op_insert(Op *op) {
+      ops[op->tid] = op;
+      op_index.insert(op->tid, op);
+    }
+    void op_erase(ceph_tid_t tid) {
+      ops.erase(tid);
+      op_index.erase(tid);
+    }
   };
   map<int,OSDSession*> osd_sessions;
 
@@ -2518,6 +2605,15 @@ public:
       vector<bufferlist> resultbl(extents.size());
       int i=0;
       for (vector<ObjectExtent>::iterator p = extents.begin(); p != extents.end(); ++p) {
+	// if the caller sized bl, give each object its slices of it so the
+	// data is received in place
+	for (vector<pair<uint64_t,uint64_t> >::iterator bit = p->buffer_extents.begin();
+	     bit != p->buffer_extents.end() && bit->first + bit->second <= bl->length();
+	     ++bit) {
+	  bufferlist sub;
+	  sub.substr_of(*bl, bit->first, bit->second);
+	  resultbl[i].claim_append(sub);
+	}
 	read_trunc(p->oid, p->oloc, p->offset, p->length,
 	     snap, &resultbl[i++], flags, p->truncate_size, trunc_seq, gather.new_sub());
       }
@@ -128,6 +128,117 @@ void Striper::file_to_extents(CephContext *cct, const char *object_format,
   }
 }
 
+/*
+ * a contiguous file range lands in each object it touches as a single
+ * contiguous extent, so instead of keying a map by object name we work
+ * out up front which objects are touched and where each one sits in the
+ * sorted result, then walk the stripe units with running counters.
+ * names, locators and truncate sizes are computed once per object.
+ *
+ * the generic path orders extents by object name, which for
+ * "<ino>.%08llx" is objectno order as long as objectno < 2^32.
+ */
+void Striper::file_to_extents(CephContext *cct, inodeno_t ino,
+			      const ceph_file_layout *layout,
+			      uint64_t offset, uint64_t len, uint64_t trunc_size,
+			      vector<ObjectExtent>& extents,
+			      uint64_t buffer_offset)
+{
+  ldout(cct, 10) << "file_to_extents " << offset << "~" << len
+		 << " ino " << ino << dendl;
+  assert(len > 0);
+
+  __u32 object_size = layout->fl_object_size;
+  __u32 su = layout->fl_stripe_unit;
+  __u32 stripe_count = layout->fl_stripe_count;
+  assert(object_size >= su);
+  uint64_t stripes_per_object = object_size / su;
+  uint64_t blocks_per_set = stripes_per_object * stripe_count;
+
+  uint64_t first_block = offset / su;
+  uint64_t last_block = (offset + len - 1) / su;
+  uint64_t first_set = first_block / blocks_per_set;
+  uint64_t last_set = last_block / blocks_per_set;
+
+  if ((last_set + 1) * stripe_count > (1ull << 32)) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llx.%%08llx", (long long unsigned)ino);
+    vector<ObjectExtent> slow;
+    file_to_extents(cct, buf, layout, offset, len, trunc_size, slow, buffer_offset);
+    extents.insert(extents.end(), slow.begin(), slow.end());
+    return;
+  }
+
+  /*
+   * objects touched in the first set: first_count positions from
+   * first_pos on, wrapping at stripe_count.  sets after it are touched
+   * from position 0, so their rank is just the position.
+   */
+  uint64_t first_pos = first_block % stripe_count;
+  uint64_t first_end = MIN(last_block, (first_set + 1) * blocks_per_set - 1);
+  uint64_t first_count = MIN(first_end - first_block + 1, (uint64_t)stripe_count);
+  uint64_t wrap_pos = first_pos + first_count > stripe_count ?
+    first_pos + first_count - stripe_count : 0;  // positions [0, wrap_pos) come first
+  uint64_t nobjects = first_count;
+  if (last_set > first_set)
+    nobjects += (last_set - first_set - 1) * stripe_count +
+      MIN(last_block - last_set * blocks_per_set + 1, (uint64_t)stripe_count);
+  uint64_t pieces_per_object = (last_block - first_block) / nobjects + 1;
+
+  size_t base = extents.size();
+  extents.resize(base + nobjects);
+  object_locator_t oloc = OSDMap::file_to_object_locator(*layout);
+
+  uint64_t objectsetno = first_set;
+  uint64_t stripe_in_set = (first_block / stripe_count) % stripes_per_object;
+  uint64_t stripepos = first_pos;
+  uint64_t block_off = offset % su;
+  uint64_t cur = offset;
+  uint64_t left = len;
+  while (left > 0) {
+    uint64_t x_len = MIN(su - block_off, left);
+
+    uint64_t slot;
+    if (objectsetno > first_set)
+      slot = first_count + (objectsetno - first_set - 1) * stripe_count + stripepos;
+    else if (first_count == stripe_count)
+      slot = stripepos;
+    else if (stripepos < wrap_pos)
+      slot = stripepos;
+    else
+      slot = wrap_pos + stripepos - first_pos;
+
+    ObjectExtent& ex = extents[base + slot];
+    if (ex.length == 0) {
+      ex.objectno = objectsetno * stripe_count + stripepos;
+      char buf[48];
+      snprintf(buf, sizeof(buf), "%llx.%08llx", (long long unsigned)ino,
+	       (long long unsigned)ex.objectno);
+      ex.oid = object_t(buf);
+      ex.oloc = oloc;
+      ex.offset = stripe_in_set * su + block_off;
+      ex.truncate_size = object_truncate_size(cct, layout, ex.objectno, trunc_size);
+      ex.buffer_extents.reserve(pieces_per_object);
+    }
+    ex.length += x_len;
+    ex.buffer_extents.push_back(make_pair(cur - offset + buffer_offset, x_len));
+
+    cur += x_len;
+    left -= x_len;
+    block_off = 0;
+    if (++stripepos == stripe_count) {
+      stripepos = 0;
+      if (++stripe_in_set == stripes_per_object) {
+	stripe_in_set = 0;
+	objectsetno++;
+      }
+    }
+  }
+
+  for (size_t i = base; i < extents.size(); ++i)
+    ldout(cct, 15) << "file_to_extents  " << extents[i] << " in " << extents[i].oloc << dendl;
+}
+
 void Striper::assimilate_extents(map<object_t,vector<ObjectExtent> >& object_extents,
 				 vector<ObjectExtent>& extents)
 {
@@ -40,16 +40,15 @@ class CephContext;
 				vector<ObjectExtent>& extents,
 				uint64_t buffer_offset=0);
 
+    /*
+     * same result for objects named <ino>.<objectno>, without the
+     * per-stripe-unit name formatting and map lookups
+     */
     static void file_to_extents(CephContext *cct, inodeno_t ino,
 				const ceph_file_layout *layout,
 				uint64_t offset, uint64_t len, uint64_t trunc_size,
-				vector<ObjectExtent>& extents) {
-      // generate prefix/format
-      char buf[32];
-      snprintf(buf, sizeof(buf), "%llx.%%08llx", (long long unsigned)ino);
-
-      file_to_extents(cct, buf, layout, offset, len, trunc_size, extents);
-    }
+				vector<ObjectExtent>& extents,
+				uint64_t buffer_offset=0);
 
     static void assimilate_extents(map<object_t,vector<ObjectExtent> >& object_extents,
 				   vector<ObjectExtent>& extents);
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "common/ceph_argparse.h"
+#include "common/ceph_context.h"
+#include "common/common_init.h"
+#include "common/config.h"
+#include "osd/OSDMap.h"
+
+/*
+ * OSDMap pg mapping micro-benchmark: the cost of an uncached crush
+ * descent (pg_to_raw_up) against the cached pg_to_up_acting_osds, both
+ * from the raw pgs Objecter maps object names to.  test-internals.exe
+ * checks the cache.
+ *
+ *   osdmap-bench.exe [iterations]
+ */
+
+static const int NUM_OSDS = 12;
+static const int64_t POOL = 1;
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static pg_pool_t make_pool(int pg_num)
+{
+  pg_pool_t p;
+  p.type = pg_pool_t::TYPE_REPLICATED;
+  p.size = 3;
+  p.min_size = 2;
+  p.crush_ruleset = 0;
+  p.object_hash = CEPH_STR_HASH_RJENKINS;
+  p.flags |= pg_pool_t::FLAG_HASHPSPOOL;
+  p.set_pg_num(pg_num);
+  p.set_pgp_num(pg_num);
+  return p;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned iters = argc > 1 ? atoi(argv[1]) : 200000;
+  CephInitParameters iparams(CEPH_ENTITY_TYPE_CLIENT);
+  CephContext *cct = common_preinit(iparams, CODE_ENVIRONMENT_UTILITY, 0);
+  cct->_conf->set_val("osd_crush_chooseleaf_type", "0");  // all on one host
+  cct->_conf->apply_changes(NULL);
+  const unsigned nobjs = 4096;
+
+  OSDMap m;
+  {
+    OSDMap::Incremental inc(1);
+    inc.fsid.generate_random();
+    inc.new_max_osd = NUM_OSDS;
+    inc.new_pool_max = POOL;
+    inc.new_pools[POOL] = make_pool(256);
+    inc.new_pool_names[POOL] = "data";
+    for (int o = 0; o < NUM_OSDS; o++) {
+      inc.new_up_client[o] = entity_addr_t();
+      inc.new_weight[o] = CEPH_OSD_IN;
+    }
+    CrushWrapper crush;
+    OSDMap::build_simple_crush_map(cct, crush, NUM_OSDS, NULL);
+    crush.encode(inc.crush);
+    m.apply_incremental(inc);
+  }
+
+  vector<pg_t> pgs(nobjs);
+  for (unsigned i = 0; i < nobjs; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "10000001234.%08x", i);
+    pgs[i] = m.object_locator_to_pg(object_t(name), object_locator_t(POOL));
+  }
+
+  double start = now();
+  for (unsigned i = 0; i < iters; i++) {
+    vector<int> up;
+    int primary;
+    m.pg_to_raw_up(pgs[i % nobjs], &up, &primary);
+  }
+  double slow = now() - start;
+
+  start = now();
+  for (unsigned i = 0; i < iters; i++) {
+    vector<int> up, acting;
+    int up_primary, acting_primary;
+    m.pg_to_up_acting_osds(pgs[i % nobjs], &up, &up_primary, &acting, &acting_primary);
+  }
+  double fast = now() - start;
+
+  uint64_t hits, misses;
+  m.get_pg_mapping_cache_stats(&hits, &misses);
+  printf("%-24s %10.1f ns/lookup\n", "pg_to_raw_up (crush)", slow * 1000000000.0 / iters);
+  printf("%-24s %10.1f ns/lookup (%llu hits, %llu misses)\n", "pg_to_up_acting (cache)",
+	 fast * 1000000000.0 / iters, (unsigned long long)hits,
+	 (unsigned long long)misses);
+
+  cct->put();
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "common/ceph_argparse.h"
+#include "common/ceph_context.h"
+#include "common/common_init.h"
+#include "osdc/Striper.h"
+
+/*
+ * Striper::file_to_extents micro-benchmark: the cost of the generic
+ * object_format path and of the ino fast path, per layout, for some
+ * common request sizes.  test-internals.exe checks that they agree.
+ *
+ *   striper-bench.exe [iterations]
+ */
+
+struct layout_shape {
+  const char *name;
+  unsigned su, sc, os;
+};
+
+static const layout_shape layouts[] = {
+  { "4M objects", 4 << 20, 1, 4 << 20 },
+  { "64K x 1", 64 << 10, 1, 4 << 20 },
+  { "64K x 4", 64 << 10, 4, 4 << 20 },
+  { "64K x 8, 1M objects", 64 << 10, 8, 1 << 20 },
+  { "1M x 16", 1 << 20, 16, 4 << 20 },
+  { "4K x 3, 12K objects", 4 << 10, 3, 12 << 10 },
+};
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void make_layout(const layout_shape& s, ceph_file_layout *l)
+{
+  memset(l, 0, sizeof(*l));
+  l->fl_stripe_unit = s.su;
+  l->fl_stripe_count = s.sc;
+  l->fl_object_size = s.os;
+  l->fl_pg_pool = 1;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned iters = argc > 1 ? atoi(argv[1]) : 20000;
+  CephInitParameters iparams(CEPH_ENTITY_TYPE_CLIENT);
+  CephContext *cct = common_preinit(iparams, CODE_ENVIRONMENT_UTILITY, 0);
+  const int nlayouts = sizeof(layouts) / sizeof(layouts[0]);
+  inodeno_t ino(0x10000001234ull);
+  char format[32];
+  snprintf(format, sizeof(format), "%llx.%%08llx", (long long unsigned)ino.val);
+
+  const unsigned sizes[] = { 4 << 10, 64 << 10, 1 << 20, 4 << 20 };
+  const int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+  printf("%-22s %10s %14s %14s %10s\n", "layout", "size", "format ns",
+	 "ino ns", "extents");
+  for (int j = 0; j < nlayouts; j++) {
+    ceph_file_layout layout;
+    make_layout(layouts[j], &layout);
+    for (int s = 0; s < nsizes; s++) {
+      uint64_t len = sizes[s];
+      unsigned n = iters;
+      size_t nextents = 0;
+
+      double start = now();
+      for (unsigned i = 0; i < n; i++) {
+	vector<ObjectExtent> extents;
+	Striper::file_to_extents(cct, format, &layout, (uint64_t)i * len, len, 0, extents);
+	nextents += extents.size();
+      }
+      double slow = now() - start;
+
+      start = now();
+      for (unsigned i = 0; i < n; i++) {
+	vector<ObjectExtent> extents;
+	Striper::file_to_extents(cct, ino, &layout, (uint64_t)i * len, len, 0, extents);
+	nextents += extents.size();
+      }
+      double fast = now() - start;
+
+      printf("%-22s %10u %14.1f %14.1f %10.1f\n", layouts[j].name, sizes[s],
+	     slow * 1000000000.0 / n, fast * 1000000000.0 / n,
+	     (double)nextents / (2 * n));
+    }
+  }
+
+  cct->put();
+  return 0;
+}
@@ -0,0 +1,742 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "client/Inode.h"
+#include "include/crc32c.h"
+#include "common/sctp_crc32.h"
+#include "common/crc32c_intel.h"
+#include "common/ceph_argparse.h"
+#include "common/ceph_context.h"
+#include "common/common_init.h"
+#include "common/config.h"
+#include "osd/OSDMap.h"
+#include "osdc/Striper.h"
+#include "auth/AES128.h"
+#include "auth/Crypto.h"
+#include "auth/cephx/CephxProtocol.h"
+#include "auth/cephx/CephxSessionHandler.h"
+extern "C" {
+#include "crush/crush.h"
+#include "crush/hash.h"
+#include "crush/mapper.h"
+#include "crush/builder.h"
+}
+
+/*
+ * unit checks for code the *-bench programs time.  each test returns
+ * its number of failures and prints what went wrong; the program exits
+ * non-zero if any failed.  needs no cluster, unlike test-cephfs.exe.
+ *
+ *   test-internals.exe [test name]
+ */
+
+// -- crc32c kernels --
+
+/*
+ * every crc32c kernel this cpu can run must match the sctp tables,
+ * including odd lengths, an unaligned start, and the NULL (zeros) case.
+ */
+static int test_crc32c()
+{
+  struct {
+    const char *name;
+    ceph_crc32c_func_t func;
+    int usable;
+  } impls[] = {
+    { "intel_baseline", ceph_crc32c_intel_baseline, ceph_have_crc32c_intel() },
+    { "intel_fast", ceph_crc32c_intel_fast, ceph_have_crc32c_intel() },
+    { "intel_fast_pclmul", ceph_crc32c_intel_fast_pclmul,
+      ceph_have_crc32c_intel() && ceph_have_pclmul_intel() },
+  };
+  const unsigned maxlen = 3 * 8192 * 2 + 100;
+  vector<unsigned char> buf(maxlen + 1);
+  int bad = 0;
+
+  srand(0);
+  for (unsigned i = 0; i < buf.size(); i++)
+    buf[i] = rand();
+  for (unsigned len = 0; len < maxlen; len += (len < 1024 ? 1 : 997)) {
+    uint32_t want = ceph_crc32c_sctp(0xffffffff, &buf[1], len);
+    uint32_t want_zero = ceph_crc32c_sctp(0xffffffff, NULL, len);
+    for (unsigned j = 0; j < sizeof(impls) / sizeof(impls[0]); j++) {
+      if (!impls[j].usable)
+	continue;
+      if (impls[j].func(0xffffffff, &buf[1], len) != want ||
+	  impls[j].func(0xffffffff, NULL, len) != want_zero) {
+	printf("%s: MISMATCH len %u\n", impls[j].name, len);
+	bad++;
+      }
+    }
+  }
+  return bad;
+}
+
+// -- WriteGather::add --
+
+static const unsigned WG_FILE_SIZE = 1 << 16;
+
+struct wg_model {
+  WriteGather g;
+  vector<char> data;     // what the file should read back as
+  vector<bool> written;  // which bytes some write covered
+  unsigned seq;
+
+  wg_model() : data(WG_FILE_SIZE), written(WG_FILE_SIZE), seq(0) {}
+
+  void write(uint64_t off, unsigned len) {
+    // a fresh fill byte per write, so a stale byte from an older write shows
+    char c = 'A' + (seq++ % 26);
+    bufferptr bp(len);
+    memset(bp.c_str(), c, len);
+    bufferlist bl;
+    bl.append(bp);
+    g.add(off, bl);
+    for (unsigned i = 0; i < len; i++) {
+      data[off + i] = c;
+      written[off + i] = true;
+    }
+  }
+
+  // returns the number of failures
+  int check(const char *what) {
+    int bad = 0;
+    uint64_t bytes = 0, last_end = 0;
+    vector<bool> covered(WG_FILE_SIZE);
+    for (map<uint64_t, bufferlist>::iterator p = g.extents.begin();
+	 p != g.extents.end();
+	 ++p) {
+      uint64_t len = p->second.length();
+      if (p != g.extents.begin() && p->first <= last_end) {
+	printf("%s: extent %llu~%llu overlaps or touches the one before\n", what,
+	       (unsigned long long)p->first, (unsigned long long)len);
+	bad++;
+      }
+      const char *buf = p->second.c_str();
+      for (uint64_t i = 0; i < len; i++) {
+	covered[p->first + i] = true;
+	if (buf[i] != data[p->first + i]) {
+	  printf("%s: byte %llu is '%c', wanted '%c'\n", what,
+		 (unsigned long long)(p->first + i), buf[i], data[p->first + i]);
+	  return bad + 1;
+	}
+      }
+      bytes += len;
+      last_end = p->first + len;
+    }
+    if (covered != written) {
+      printf("%s: extents do not cover exactly the bytes written\n", what);
+      bad++;
+    }
+    if (bytes != g.bytes) {
+      printf("%s: bytes %llu, extents hold %llu\n", what,
+	     (unsigned long long)g.bytes, (unsigned long long)bytes);
+      bad++;
+    }
+    return bad;
+  }
+};
+
+struct wg_write {
+  uint64_t off;
+  unsigned len;
+  unsigned extents;  // wanted after this write
+};
+
+struct wg_case {
+  const char *name;
+  wg_write w[6];   // terminated by len 0
+};
+
+static const wg_case wg_cases[] = {
+  { "disjoint", { { 0, 100, 1 }, { 200, 100, 2 }, { 400, 100, 3 }, { 0, 0, 0 } } },
+  { "adjacent after", { { 0, 100, 1 }, { 100, 100, 1 }, { 0, 0, 0 } } },
+  { "adjacent before", { { 100, 100, 1 }, { 0, 100, 1 }, { 0, 0, 0 } } },
+  { "bridges a gap", { { 0, 100, 1 }, { 200, 100, 2 }, { 100, 100, 1 }, { 0, 0, 0 } } },
+  { "overlaps tail", { { 0, 100, 1 }, { 50, 100, 1 }, { 0, 0, 0 } } },
+  { "overlaps head", { { 50, 100, 1 }, { 0, 100, 1 }, { 0, 0, 0 } } },
+  { "contained", { { 0, 300, 1 }, { 100, 50, 1 }, { 0, 0, 0 } } },
+  { "contains", { { 100, 50, 1 }, { 0, 300, 1 }, { 0, 0, 0 } } },
+  { "same range", { { 100, 50, 1 }, { 100, 50, 1 }, { 0, 0, 0 } } },
+  { "spans several", { { 100, 50, 1 }, { 200, 50, 2 }, { 300, 50, 3 }, { 400, 50, 4 },
+		       { 120, 250, 2 }, { 0, 0, 0 } } },
+  { "spans all, touching", { { 100, 50, 1 }, { 200, 50, 2 }, { 300, 50, 3 },
+			     { 150, 150, 1 }, { 0, 0, 0 } } },
+};
+
+/*
+ * merges writes into a gather and checks the extents against a flat copy
+ * of the file after every add: disjoint and never adjacent, bytes their
+ * sum, and the later write winning wherever two overlap.
+ */
+static int test_writegather()
+{
+  int bad = 0;
+
+  for (unsigned i = 0; i < sizeof(wg_cases) / sizeof(wg_cases[0]); i++) {
+    wg_model m;
+    for (const wg_write *w = wg_cases[i].w; w->len; w++) {
+      m.write(w->off, w->len);
+      bad += m.check(wg_cases[i].name);
+      if (m.g.extents.size() != w->extents) {
+	printf("%s: %u extents after %llu~%u, wanted %u\n", wg_cases[i].name,
+	       (unsigned)m.g.extents.size(), (unsigned long long)w->off, w->len,
+	       w->extents);
+	bad++;
+      }
+    }
+  }
+
+  srand(1);
+  for (unsigned round = 0; round < 200; round++) {
+    wg_model m;
+    unsigned nwrites = 1 + rand() % 40;
+    for (unsigned i = 0; i < nwrites; i++) {
+      unsigned len = 1 + rand() % 4096;
+      m.write(rand() % (WG_FILE_SIZE - len), len);
+      int b = m.check("random");
+      if (b) {
+	printf("random: round %u write %u failed\n", round, i);
+	bad += b;
+	break;
+      }
+    }
+  }
+
+  return bad;
+}
+
+// -- OSDMap pg mapping cache --
+
+static const int OM_NUM_OSDS = 12;
+static const int64_t OM_POOL = 1;
+
+static pg_pool_t om_make_pool(int pg_num)
+{
+  pg_pool_t p;
+  p.type = pg_pool_t::TYPE_REPLICATED;
+  p.size = 3;
+  p.min_size = 2;
+  p.crush_ruleset = 0;
+  p.object_hash = CEPH_STR_HASH_RJENKINS;
+  p.flags |= pg_pool_t::FLAG_HASHPSPOOL;
+  p.set_pg_num(pg_num);
+  p.set_pgp_num(pg_num);
+  return p;
+}
+
+static pg_t om_object_pg(const OSDMap& m, unsigned i)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "10000001234.%08x", i);
+  return m.object_locator_to_pg(object_t(name), object_locator_t(OM_POOL));
+}
+
+/*
+ * map nobjs objects twice each; every answer must match the uncached
+ * up set, and the second pass must be all hits.  returns the number of
+ * failures.
+ */
+static int om_check_map(const char *what, const OSDMap& m, unsigned nobjs,
+			vector<vector<int> > *ups)
+{
+  int bad = 0;
+  unsigned raw_outside = 0;
+  uint64_t hits, misses;
+  m.get_pg_mapping_cache_stats(&hits, &misses);
+  if (hits || misses) {
+    printf("%s: cache not empty at epoch %u\n", what, m.get_epoch());
+    bad++;
+  }
+  ups->resize(nobjs);
+  for (int pass = 0; pass < 2; pass++) {
+    for (unsigned i = 0; i < nobjs; i++) {
+      pg_t pg = om_object_pg(m, i);
+      if (pg.ps() >= m.get_pg_pool(OM_POOL)->get_pg_num())
+	raw_outside++;
+      vector<int> up, acting, want;
+      int up_primary, acting_primary, want_primary;
+      m.pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
+      m.pg_to_raw_up(pg, &want, &want_primary);
+      if (up != want || up_primary != want_primary || acting != want) {
+	printf("%s: MISMATCH object %u pg %u.%x\n", what, i,
+	       (unsigned)pg.pool(), pg.ps());
+	bad++;
+      }
+      (*ups)[i] = up;
+    }
+    if (pass == 0)
+      m.get_pg_mapping_cache_stats(&hits, &misses);
+  }
+  uint64_t hits2, misses2;
+  m.get_pg_mapping_cache_stats(&hits2, &misses2);
+  unsigned pg_num = m.get_pg_pool(OM_POOL)->get_pg_num();
+  if (misses > pg_num || misses2 != misses || hits2 != hits + nobjs ||
+      raw_outside == 0) {
+    printf("%s: cache did not hit for raw pgs (epoch %u pg_num %u: %u/%u "
+	   "raw pgs past pg_num, %llu misses, %llu hits)\n", what,
+	   m.get_epoch(), pg_num, raw_outside / 2, nobjs,
+	   (unsigned long long)misses2, (unsigned long long)hits2);
+    bad++;
+  }
+  return bad;
+}
+
+/*
+ * maps real object names (raw pgs, as Objecter does) through
+ * pg_to_up_acting_osds and checks the answers against the uncached
+ * pg_to_raw_up, that repeat lookups hit the cache, and that a new epoch
+ * or a pg_num change does not serve stale mappings.
+ */
+static int test_osdmap()
+{
+  CephInitParameters iparams(CEPH_ENTITY_TYPE_CLIENT);
+  CephContext *cct = common_preinit(iparams, CODE_ENVIRONMENT_UTILITY, 0);
+  cct->_conf->set_val("osd_crush_chooseleaf_type", "0");  // all on one host
+  cct->_conf->apply_changes(NULL);
+  const unsigned nobjs = 4096;
+  int bad = 0;
+
+  OSDMap m;
+  {
+    OSDMap::Incremental inc(1);
+    inc.fsid.generate_random();
+    inc.new_max_osd = OM_NUM_OSDS;
+    inc.new_pool_max = OM_POOL;
+    inc.new_pools[OM_POOL] = om_make_pool(64);
+    inc.new_pool_names[OM_POOL] = "data";
+    for (int o = 0; o < OM_NUM_OSDS; o++) {
+      inc.new_up_client[o] = entity_addr_t();
+      inc.new_weight[o] = CEPH_OSD_IN;
+    }
+    CrushWrapper crush;
+    OSDMap::build_simple_crush_map(cct, crush, OM_NUM_OSDS, NULL);
+    crush.encode(inc.crush);
+    m.apply_incremental(inc);
+  }
+  vector<vector<int> > before, after;
+  bad += om_check_map("initial", m, nobjs, &before);
+
+  // a new epoch that moves data: osd.0 goes down
+  {
+    OSDMap::Incremental inc(m.get_epoch() + 1);
+    inc.fsid = m.get_fsid();
+    inc.new_state[0] = CEPH_OSD_UP;
+    m.apply_incremental(inc);
+  }
+  bad += om_check_map("osd.0 down", m, nobjs, &after);
+  unsigned moved = 0;
+  for (unsigned i = 0; i < nobjs; i++) {
+    if (before[i] != after[i])
+      moved++;
+    for (unsigned j = 0; j < after[i].size(); j++)
+      if (after[i][j] == 0) {
+	printf("osd.0 down: object %u still maps to osd.0\n", i);
+	bad++;
+      }
+  }
+  if (!moved) {
+    printf("osd.0 down: nothing moved\n");
+    bad++;
+  }
+
+  // split the pool
+  {
+    OSDMap::Incremental inc(m.get_epoch() + 1);
+    inc.fsid = m.get_fsid();
+    inc.new_pools[OM_POOL] = om_make_pool(256);
+    m.apply_incremental(inc);
+  }
+  bad += om_check_map("pg_num 256", m, nobjs, &after);
+
+  cct->put();
+  return bad;
+}
+
+// -- Striper::file_to_extents --
+
+struct st_layout {
+  const char *name;
+  unsigned su, sc, os;
+};
+
+static const st_layout st_layouts[] = {
+  { "4M objects", 4 << 20, 1, 4 << 20 },
+  { "64K x 1", 64 << 10, 1, 4 << 20 },
+  { "64K x 4", 64 << 10, 4, 4 << 20 },
+  { "64K x 8, 1M objects", 64 << 10, 8, 1 << 20 },
+  { "1M x 16", 1 << 20, 16, 4 << 20 },
+  { "4K x 3, 12K objects", 4 << 10, 3, 12 << 10 },
+};
+
+static bool st_same_extents(const vector<ObjectExtent>& a,
+			    const vector<ObjectExtent>& b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (unsigned i = 0; i < a.size(); i++) {
+    if (a[i].oid != b[i].oid ||
+	a[i].objectno != b[i].objectno ||
+	a[i].offset != b[i].offset ||
+	a[i].length != b[i].length ||
+	a[i].truncate_size != b[i].truncate_size ||
+	!(a[i].oloc == b[i].oloc) ||
+	a[i].buffer_extents != b[i].buffer_extents)
+      return false;
+  }
+  return true;
+}
+
+/*
+ * the ino fast path must give exactly the extents of the generic
+ * object_format path, over random ranges of each layout, with and
+ * without truncation.
+ */
+static int test_striper()
+{
+  CephInitParameters iparams(CEPH_ENTITY_TYPE_CLIENT);
+  CephContext *cct = common_preinit(iparams, CODE_ENVIRONMENT_UTILITY, 0);
+  inodeno_t ino(0x10000001234ull);
+  char format[32];
+  snprintf(format, sizeof(format), "%llx.%%08llx", (long long unsigned)ino.val);
+  int bad = 0;
+
+  srand(0);
+  for (unsigned j = 0; j < sizeof(st_layouts) / sizeof(st_layouts[0]); j++) {
+    const st_layout& s = st_layouts[j];
+    ceph_file_layout layout;
+    memset(&layout, 0, sizeof(layout));
+    layout.fl_stripe_unit = s.su;
+    layout.fl_stripe_count = s.sc;
+    layout.fl_object_size = s.os;
+    layout.fl_pg_pool = 1;
+    uint64_t set_bytes = (uint64_t)s.os * s.sc;
+    for (unsigned i = 0; i < 20000; i++) {
+      uint64_t off = (uint64_t)rand() * rand() % (4 * set_bytes);
+      uint64_t len = 1 + (uint64_t)rand() * rand() % (i % 4 == 0 ? 3 * set_bytes : s.su * 3);
+      uint64_t trunc = i % 3 == 0 ? 0 : (uint64_t)rand() * rand() % (5 * set_bytes);
+      uint64_t boff = i % 5;
+      vector<ObjectExtent> want, got;
+      Striper::file_to_extents(cct, format, &layout, off, len, trunc, want, boff);
+      Striper::file_to_extents(cct, ino, &layout, off, len, trunc, got, boff);
+      if (!st_same_extents(want, got)) {
+	printf("%s: MISMATCH %llu~%llu trunc %llu\n", s.name,
+	       (unsigned long long)off, (unsigned long long)len,
+	       (unsigned long long)trunc);
+	bad++;
+	break;
+      }
+    }
+  }
+
+  cct->put();
+  return bad;
+}
+
+// -- crush straw2 hash kernels --
+
+struct cr_impl {
+  const char *name;
+  crush_hash32_3_batch_func_t func;
+  int usable;
+};
+
+struct cr_shape {
+  int hosts;
+  int osds_per_host;
+};
+
+/* root (straw2) -> hosts (straw2) -> osds; some osds get zero weight */
+static struct crush_map *cr_build_map(const cr_shape& s, int *ndevices)
+{
+  struct crush_map *map = crush_create();
+  map->choose_local_tries = 0;
+  map->choose_local_fallback_tries = 0;
+  map->choose_total_tries = 50;
+  map->chooseleaf_descend_once = 1;
+  map->chooseleaf_vary_r = 1;
+
+  std::vector<int> hosts(s.hosts), host_weights(s.hosts);
+  int osd = 0;
+  for (int h = 0; h < s.hosts; h++) {
+    std::vector<int> items(s.osds_per_host), weights(s.osds_per_host);
+    int total = 0;
+    for (int i = 0; i < s.osds_per_host; i++) {
+      items[i] = osd++;
+      weights[i] = rand() % 8 == 0 ? 0 : 0x10000 + rand() % 0x30000;
+      total += weights[i];
+    }
+    struct crush_bucket *b = crush_make_bucket(map, CRUSH_BUCKET_STRAW2,
+					       CRUSH_HASH_DEFAULT, 1,
+					       s.osds_per_host, &items[0],
+					       &weights[0]);
+    crush_add_bucket(map, 0, b, &hosts[h]);
+    host_weights[h] = total;
+  }
+  struct crush_bucket *root = crush_make_bucket(map, CRUSH_BUCKET_STRAW2,
+						CRUSH_HASH_DEFAULT, 2,
+						s.hosts, &hosts[0],
+						&host_weights[0]);
+  int rootno;
+  crush_add_bucket(map, 0, root, &rootno);
+
+  struct crush_rule *rule = crush_make_rule(3, 0, 1, 1, 10);
+  crush_rule_set_step(rule, 0, CRUSH_RULE_TAKE, rootno, 0);
+  crush_rule_set_step(rule, 1, CRUSH_RULE_CHOOSELEAF_FIRSTN, 0, 1);
+  crush_rule_set_step(rule, 2, CRUSH_RULE_EMIT, 0, 0);
+  crush_add_rule(map, rule, 0);
+  crush_finalize(map);
+  *ndevices = osd;
+  return map;
+}
+
+/*
+ * every crush_hash32_3_batch kernel this cpu can run must match the
+ * scalar hash at every length up to a few vectors, and crush_do_rule
+ * must give the same mappings with each over a set of generated maps.
+ */
+static int test_crush()
+{
+  cr_impl impls[] = {
+    { "scalar", crush_hash32_rjenkins1_3_batch, 1 },
+    { "sse2", crush_hash32_rjenkins1_3_batch_sse2, crush_have_sse2() },
+    { "avx2", crush_hash32_rjenkins1_3_batch_avx2, crush_have_avx2() },
+  };
+  const int nimpls = sizeof(impls) / sizeof(impls[0]);
+  crush_hash32_3_batch_func_t saved = crush_hash32_3_batch_func;
+  int bad = 0;
+
+  srand(0);
+  __s32 items[130];
+  __u32 out[130];
+  for (int round = 0; round < 2000; round++) {
+    __u32 a = rand() ^ (rand() << 16);
+    __u32 c = rand() % 64;
+    for (unsigned i = 0; i < 130; i++)
+      items[i] = rand() % 2 ? (rand() % 10000) : -1 - (rand() % 1000);
+    for (unsigned n = 0; n <= 130; n++) {
+      for (int j = 0; j < nimpls; j++) {
+	if (!impls[j].usable)
+	  continue;
+	impls[j].func(a, items, c, out, n);
+	for (unsigned i = 0; i < n; i++) {
+	  if (out[i] != crush_hash32_3(CRUSH_HASH_RJENKINS1, a, items[i], c)) {
+	    printf("%s: hash MISMATCH n %u i %u\n", impls[j].name, n, i);
+	    bad++;
+	    break;
+	  }
+	}
+      }
+    }
+  }
+
+  const cr_shape shapes[] = {
+    { 4, 4 }, { 12, 12 }, { 10, 24 }, { 40, 24 }, { 3, 61 }, { 100, 8 },
+  };
+  const int result_max = 3;
+  int result[result_max], expect[result_max];
+  int scratch[result_max * 3];
+  for (unsigned s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+    int ndevices;
+    struct crush_map *map = cr_build_map(shapes[s], &ndevices);
+    std::vector<__u32> weights(ndevices, 0x10000);
+    for (unsigned x = 0; x < 100000; x++) {
+      crush_hash32_3_batch_func = crush_hash32_rjenkins1_3_batch;
+      int n = crush_do_rule(map, 0, x, expect, result_max,
+			    &weights[0], ndevices, scratch);
+      for (int j = 1; j < nimpls; j++) {
+	if (!impls[j].usable)
+	  continue;
+	crush_hash32_3_batch_func = impls[j].func;
+	int m = crush_do_rule(map, 0, x, result, result_max,
+			      &weights[0], ndevices, scratch);
+	if (m != n || memcmp(result, expect, n * sizeof(int))) {
+	  printf("%s: mapping MISMATCH map %dx%d x %u\n", impls[j].name,
+		 shapes[s].hosts, shapes[s].osds_per_host, x);
+	  bad++;
+	}
+      }
+      if (bad)
+	break;
+    }
+    crush_destroy(map);
+  }
+
+  crush_hash32_3_batch_func = saved;
+  return bad;
+}
+
+// -- AES-128 and cephx signing --
+
+static bool ax_same(const char *what, const unsigned char *got,
+		    const unsigned char *want, unsigned len)
+{
+  if (!memcmp(got, want, len))
+    return true;
+  printf("%s: MISMATCH\n", what);
+  return false;
+}
+
+/*
+ * both AES kernels and the inverse cipher against FIPS-197 C.1,
+ * CryptoAES against AES-128-CBC/pkcs7 output from openssl, CryptoAES
+ * round trips, and the one-block signature against the encode_encrypt
+ * path sign_message falls back to.
+ */
+static int test_cephx()
+{
+  int bad = 0;
+  int have_aes = ceph_have_aes_intel();
+
+  static const unsigned char fips_key[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+  static const unsigned char fips_in[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+  static const unsigned char fips_out[16] = {
+    0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+    0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+  AES128Key fk(fips_key);
+  unsigned char out[16];
+  ceph_aes128_portable(&fk, fips_in, out);
+  bad += !ax_same("portable FIPS-197", out, fips_out, 16);
+  if (have_aes) {
+    ceph_aes128_intel(&fk, fips_in, out);
+    bad += !ax_same("intel FIPS-197", out, fips_out, 16);
+  }
+  fk.decrypt_block(fips_out, out);
+  bad += !ax_same("inverse FIPS-197", out, fips_in, 16);
+
+  srand(0);
+  for (unsigned i = 0; i < 10000 && !bad; i++) {
+    unsigned char key[16], in[16], a[16], b[16];
+    for (int j = 0; j < 16; j++) {
+      key[j] = rand();
+      in[j] = rand();
+    }
+    AES128Key k(key);
+    ceph_aes128_portable(&k, in, a);
+    if (have_aes) {
+      ceph_aes128_intel(&k, in, b);
+      bad += !ax_same("intel vs portable", b, a, 16);
+    }
+    k.decrypt_block(a, b);
+    bad += !ax_same("decrypt_block round trip", b, in, 16);
+  }
+
+  CephInitParameters iparams(CEPH_ENTITY_TYPE_CLIENT);
+  CephContext *cct = common_preinit(iparams, CODE_ENVIRONMENT_UTILITY, 0);
+  CryptoHandler *aes = cct->get_crypto_handler(CEPH_CRYPTO_AES);
+
+  // openssl enc -aes-128-cbc -K 2b2c..3a -iv <CEPH_AES_IV in hex>
+  static const unsigned char kat_out[32] = {
+    0xfb, 0x64, 0xae, 0x50, 0x92, 0xe4, 0x47, 0x15,
+    0x8a, 0x70, 0x31, 0x81, 0x22, 0x5b, 0x6e, 0x5e,
+    0x27, 0x5e, 0x5d, 0xba, 0xe5, 0x7d, 0xd6, 0x26,
+    0x5e, 0xc4, 0x8b, 0x24, 0x4a, 0x1b, 0xaa, 0xc7 };
+  bufferptr secret(16);
+  for (int j = 0; j < 16; j++)
+    secret.c_str()[j] = 0x2b + j;
+  bufferlist pt, ct, back;
+  std::string error;
+  pt.append("cephx signing test");
+  aes->encrypt(secret, pt, ct, error);
+  if (!error.empty() || ct.length() != 32) {
+    printf("CryptoAES encrypt: %u bytes, error '%s'\n", ct.length(),
+	   error.c_str());
+    bad++;
+  } else {
+    bad += !ax_same("CryptoAES vs openssl", (const unsigned char *)ct.c_str(),
+		    kat_out, 32);
+  }
+
+  for (unsigned len = 0; len <= 40; len++) {
+    pt.clear();
+    ct.clear();
+    back.clear();
+    for (unsigned j = 0; j < len; j++)
+      pt.append((char)rand());
+    aes->encrypt(secret, pt, ct, error);
+    aes->decrypt(secret, ct, back, error);
+    if (!error.empty() || !(back == pt)) {
+      printf("CryptoAES round trip of %u bytes: error '%s'\n", len,
+	     error.c_str());
+      bad++;
+      error.clear();
+    }
+  }
+  ct.clear();
+  ct.append(std::string(32, 'x'));
+  aes->decrypt(secret, ct, back, error);
+  if (error.empty()) {
+    printf("CryptoAES decrypt accepted bad padding\n");
+    bad++;
+  }
+
+  for (unsigned i = 0; i < 1000 && !bad; i++) {
+    bufferptr s(16);
+    for (int j = 0; j < 16; j++)
+      s.c_str()[j] = rand();
+    CryptoKey key(CEPH_CRYPTO_AES, utime_t(), s);
+    uint32_t crcs[4];
+    bufferlist bl_plaintext, bl_encrypted;
+    for (int j = 0; j < 4; j++) {
+      crcs[j] = rand() * 65599u + rand();
+      ::encode(crcs[j], bl_plaintext);
+    }
+    error.clear();
+    if (encode_encrypt(cct, bl_plaintext, key, bl_encrypted, error)) {
+      printf("encode_encrypt: %s\n", error.c_str());
+      bad++;
+      break;
+    }
+    bufferlist::iterator ci = bl_encrypted.begin();
+    ci.advance(4);
+    uint64_t want;
+    ::decode(want, ci);
+    AES128Key k((const unsigned char *)s.c_str());
+    if (CephxSessionHandler::calc_signature(k, crcs[0]) != want) {
+      printf("signature MISMATCH, header crc %u\n", crcs[0]);
+      bad++;
+    }
+  }
+
+  cct->put();
+  return bad;
+}
+
+struct unit_test {
+  const char *name;
+  int (*fn)();
+};
+
+static const unit_test tests[] = {
+  { "crc32c", test_crc32c },
+  { "writegather", test_writegather },
+  { "osdmap", test_osdmap },
+  { "striper", test_striper },
+  { "crush", test_crush },
+  { "cephx", test_cephx },
+};
+
+int main(int argc, char **argv)
+{
+  int failed = 0, ran = 0;
+  for (unsigned i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    if (argc > 1 && strcmp(argv[1], tests[i].name))
+      continue;
+    int bad = tests[i].fn();
+    ran++;
+    if (bad) {
+      printf("%-16s %d failures\n", tests[i].name, bad);
+      failed++;
+    } else {
+      printf("%-16s ok\n", tests[i].name);
+    }
+  }
+  if (!ran) {
+    printf("no test named %s\n", argv[1]);
+    return 1;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "client/Inode.h"
+
+/*
+ * WriteGather::add micro-benchmark: the cost of folding concurrent 4K
+ * appends into one extent.  test-internals.exe checks the merging.
+ *
+ *   writegather-bench.exe [iterations]
+ */
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned iters = argc > 1 ? atoi(argv[1]) : 100000;
+
+  bufferptr bp(4096);
+  memset(bp.c_str(), 'x', bp.length());
+  const unsigned per_gather = 64;
+  uint64_t extents = 0;
+  double start = now();
+  for (unsigned i = 0; i < iters; i += per_gather) {
+    WriteGather g;
+    for (unsigned j = 0; j < per_gather; j++) {
+      bufferlist bl;
+      bl.append(bp);
+      g.add((uint64_t)j * bp.length(), bl);
+    }
+    extents += g.extents.size();
+  }
+  double t = now() - start;
+  printf("%-24s %10.1f ns/add (%llu extents)\n", "4K appends",
+	 t * 1000000000.0 / iters, (unsigned long long)extents);
+  return 0;
+}